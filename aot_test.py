@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+
+# Compiles every test script to C++ with --emit-cpp, builds it with the system g++ and checks that the executable
+# prints exactly what the interpreter prints, to stdout and stderr, and exits with the same code.
+
+from os import listdir, makedirs
+from os.path import dirname, getmtime, isdir, isfile, join, realpath, relpath, splitext
+from subprocess import PIPE, run
+import sys
+
+REPO_DIR = dirname(realpath(__file__))
+TEST_DIR = join(REPO_DIR, 'test')
+SOURCE_DIR = join(REPO_DIR, 'jlox', 'src')
+INCLUDE_DIR = join(REPO_DIR, 'jlox', 'include')
+BUILD_DIR = join(REPO_DIR, 'out', 'aot')
+JLOX = 'out/bin/x64/Release/jlox'
+CXX = ['g++', '-std=c++20', '-O2', '-I' + INCLUDE_DIR]
+
+# the same scripts test.py skips for jlox, and the benchmarks, which print timings
+SKIP = [
+  'benchmark',
+  'expressions',
+  'scanning',
+  'limit/loop_too_large.lox',
+  'limit/no_reuse_constants.lox',
+  'limit/too_many_constants.lox',
+  'limit/too_many_locals.lox',
+  'limit/too_many_upvalues.lox',
+  'limit/stack_overflow.lox',
+  'import/modules',
+  'snapshot/restore',
+  # threads and the async functions need the tree-walking interpreter
+  'async',
+  'threads',
+]
+
+
+# the runtime the generated code links against: everything but main.cpp, built once
+def build_runtime():
+  makedirs(BUILD_DIR, exist_ok=True)
+  headers = max(getmtime(join(INCLUDE_DIR, name)) for name in listdir(INCLUDE_DIR))
+  objects = []
+  for name in sorted(listdir(SOURCE_DIR)):
+    if splitext(name)[1] != '.cpp' or name == 'main.cpp':
+      continue
+    source = join(SOURCE_DIR, name)
+    target = join(BUILD_DIR, splitext(name)[0] + '.o')
+    if not isfile(target) or getmtime(target) < max(getmtime(source), headers):
+      print('compiling ' + name)
+      run(CXX + ['-c', source, '-o', target], check=True)
+    objects.append(target)
+  return objects
+
+
+def scripts(path):
+  for name in sorted(listdir(path)):
+    child = join(path, name)
+    if relpath(child, TEST_DIR) in SKIP:
+      continue
+    if isdir(child):
+      yield from scripts(child)
+    elif splitext(name)[1] == '.lox':
+      yield child
+
+
+def check(path, objects):
+  expected = run([JLOX, path], stdout=PIPE, stderr=PIPE)
+
+  source = join(BUILD_DIR, 'program.cpp')
+  executable = join(BUILD_DIR, 'program')
+  actual = run([JLOX, '--emit-cpp=' + source, path], stdout=PIPE, stderr=PIPE)
+
+  # scripts that don't compile never get to the transpiler and report their errors the same way
+  if actual.returncode == 0:
+    build = run(CXX + [source] + objects + ['-o', executable], stdout=PIPE, stderr=PIPE)
+    if build.returncode != 0:
+      return 'g++ failed:\n' + build.stderr.decode()
+    actual = run([executable], stdout=PIPE, stderr=PIPE)
+
+  for stream in ['returncode', 'stdout', 'stderr']:
+    if getattr(expected, stream) != getattr(actual, stream):
+      return '{} differs:\n  interpreter: {!r}\n  compiled:    {!r}'.format(stream, getattr(expected, stream), getattr(actual, stream))
+  return None
+
+
+def main(argv):
+  filter_path = argv[1] if len(argv) > 1 else None
+  objects = build_runtime()
+
+  passed = 0
+  failed = 0
+  for path in scripts(TEST_DIR):
+    name = relpath(path, REPO_DIR)
+    if filter_path and not name.startswith(filter_path):
+      continue
+    error = check(path, objects)
+    if error is None:
+      passed += 1
+    else:
+      failed += 1
+      print('FAIL: {}\n{}'.format(name, error))
+    sys.stdout.flush()
+
+  print('{} passed, {} failed'.format(passed, failed))
+  sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+  main(sys.argv)
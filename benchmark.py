@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+# Times every script in test/benchmark with each of the engines.
+
+from os import listdir
+from os.path import dirname, join, realpath, splitext
+from subprocess import DEVNULL, TimeoutExpired, run
+import sys
+import time
+
+REPO_DIR = dirname(realpath(__file__))
+BENCHMARK_DIR = join(REPO_DIR, 'test', 'benchmark')
+JLOX = 'out/bin/x64/Release/jlox'
+
+ENGINES = {
+  'interpreter': ['--engine=interpreter'],
+  'closure': ['--engine=closure'],
+  'flat': ['--engine=flat'],
+  'jit': ['--jit'],
+}
+
+
+def time_script(flags, path, timeout):
+  start = time.perf_counter()
+  try:
+    result = run([JLOX] + flags + [path], stdout=DEVNULL, stderr=DEVNULL, timeout=timeout)
+  except TimeoutExpired:
+    return None
+  if result.returncode != 0:
+    return None
+  return time.perf_counter() - start
+
+
+def main(argv):
+  timeout = None
+  filter_name = None
+
+  for arg in argv[1:]:
+    if arg.startswith('--timeout='):
+      timeout = float(arg[len('--timeout='):])
+    elif filter_name is None:
+      filter_name = arg
+    else:
+      print('Usage: benchmark.py [--timeout=seconds] [filter]')
+      sys.exit(1)
+
+  scripts = sorted(name for name in listdir(BENCHMARK_DIR) if splitext(name)[1] == '.lox')
+  if filter_name:
+    scripts = [name for name in scripts if name.startswith(filter_name)]
+
+  print('{:<24}'.format('benchmark') + ''.join('{:>14}'.format(engine) for engine in ENGINES))
+  for name in scripts:
+    row = '{:<24}'.format(splitext(name)[0])
+    for flags in ENGINES.values():
+      elapsed = time_script(flags, join(BENCHMARK_DIR, name), timeout)
+      row += '{:>14}'.format('-' if elapsed is None else '{:.2f}s'.format(elapsed))
+      sys.stdout.flush()
+    print(row)
+
+
+if __name__ == '__main__':
+  main(sys.argv)
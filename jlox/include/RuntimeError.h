@@ -13,4 +13,11 @@ public:
 	Token token;
 };
 
+// thrown by built-in functions, which have no token to report, the call rethrows it as a RuntimeError at its paren
+class NativeError final : public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
+
 
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <bit>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "environment.h"
+#include "expr.h"
+#include "interpreter.h"
+#include "loxClass.h"
+#include "loxFunction.h"
+#include "RuntimeError.h"
+
+
+// Runtime support for the C++ that --emit-cpp writes, see transpiler.h. The generated code keeps the interpreter's
+// environments, classes and instances, so every helper here does exactly what the matching visit method does.
+namespace aot
+{
+	// the body of a function, called with the environment that holds its parameters
+	using Body = object_t (*)(const std::shared_ptr<Environment>& environment);
+
+	// a function whose body was compiled ahead of time, the declaration only carries its name and parameters
+	class Function final : public LoxFunction
+	{
+	public:
+		Function(std::shared_ptr<Stmt::Function> declaration, Body body, std::shared_ptr<Environment> closure, bool isInitializer);
+
+		std::shared_ptr<LoxFunction> bind(const LoxInstance& instance) const override;
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override;
+
+	private:
+		Body m_body;
+	};
+
+	struct Method
+	{
+		std::shared_ptr<Stmt::Function> declaration;
+		Body body;
+	};
+
+	// left to right, braced initializers guarantee the order
+	struct Operands
+	{
+		object_t left;
+		object_t right;
+	};
+
+	std::shared_ptr<Environment> CreateGlobals();
+	std::shared_ptr<Stmt::Function> Declare(Token name, std::vector<Token> params);
+
+	// runs the program and reports a runtime error like the interpreter, returns the exit code
+	int Run(void (*program)());
+
+	// statements
+	void DefineFunction(const std::shared_ptr<Environment>& environment, const std::shared_ptr<Stmt::Function>& declaration, Body body);
+	void DefineClass(const std::shared_ptr<Environment>& environment, const Token& name, std::shared_ptr<LoxClass> superclass, const std::vector<Method>& methods);
+	std::shared_ptr<LoxClass> Superclass(const Token& name, const object_t& value);
+	void Print(const object_t& value);
+
+	// expressions
+	object_t Binary(const Token& op, const Operands& operands);
+	object_t Call(const Token& paren, const std::vector<object_t>& calleeAndArguments);
+	object_t Get(const Token& name, const object_t& object);
+	object_t Super(const std::shared_ptr<Environment>& environment, size_t distance, const Token& method);
+	void CheckInstance(const Token& name, const object_t& object);
+	void SetField(const Token& name, const object_t& object, const object_t& value);
+
+	template <typename Value>
+	object_t Set(const Token& name, const object_t& object, Value&& value)
+	{
+		CheckInstance(name, object);
+		object_t result = value();
+		SetField(name, object, result);
+		return result;
+	}
+
+	template <typename Right>
+	object_t And(object_t left, Right&& right)
+	{
+		if (!IsTruthy(left)) { return left; }
+		return right();
+	}
+
+	template <typename Right>
+	object_t Or(object_t left, Right&& right)
+	{
+		if (IsTruthy(left)) { return left; }
+		return right();
+	}
+
+	inline object_t Unary(const Token& op, const object_t& right)
+	{
+		return EvaluateUnary(op, right);
+	}
+
+	inline bool Truthy(const object_t& value)
+	{
+		return IsTruthy(value);
+	}
+
+	inline object_t Assign(const std::shared_ptr<Environment>& environment, const Token& name, object_t value)
+	{
+		environment->assign(name, value);
+		return value;
+	}
+
+	inline object_t AssignAt(const std::shared_ptr<Environment>& environment, const size_t distance, const Token& name, object_t value)
+	{
+		environment->assignAt(distance, name, value);
+		return value;
+	}
+}
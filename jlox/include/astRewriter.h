@@ -0,0 +1,30 @@
+#pragma once
+
+#include "expr.h"
+
+
+// Base for passes that transform the syntax tree after it has been resolved.
+// The tree is rewritten bottom up: the children of a node are rewritten first,
+// after which transform() may return a node that takes the place of the visited one.
+class AstRewriter : public Stmt::Visitor, public Expr::Visitor
+{
+public:
+	~AstRewriter() override = default;
+
+	// every statement list in the tree (the program, blocks and function bodies) is rewritten through this overload
+	virtual void rewrite(std::vector<std::shared_ptr<Stmt>>& stmts);
+	void rewrite(std::shared_ptr<Stmt>& stmt);
+	void rewrite(std::shared_ptr<Expr>& expr);
+
+#define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
+	STMT_TYPES;
+#undef TYPE
+#define TYPE(name, ...) object_t visit ## name ## Expr(Expr::name& expr) override;
+	EXPR_TYPES;
+#undef TYPE
+
+protected:
+	// return nullptr to keep the node
+	virtual std::shared_ptr<Stmt> transform(const std::shared_ptr<Stmt>&) { return nullptr; }
+	virtual std::shared_ptr<Expr> transform(const std::shared_ptr<Expr>&) { return nullptr; }
+};
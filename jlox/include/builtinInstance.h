@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "RuntimeError.h"
+#include "loxCallable.h"
+#include "loxInstance.h"
+
+
+// The base of the objects built-in types are made of, like arrays and maps. A type names itself in NAME, and its
+// objects in PLURAL for errors, and lists its methods in a static table, methods, that get looks properties up in.
+// Methods are bound to their object like LoxFunction::bind binds the ones declared in Lox. Every object of a type has
+// the same class, which has no methods and only names the type, and no object of one has fields.
+template <typename Self>
+class BuiltinInstance : public LoxInstance
+{
+public:
+	struct Method
+	{
+		std::string_view name;
+		size_t arity;
+		object_t (*body)(Self& self, const std::vector<object_t>& arguments);
+	};
+
+	object_t get(const Token& name) override
+	{
+		for (const Method& method : Self::methods)
+		{
+			if (method.name == name.lexeme)
+			{
+				return std::shared_ptr<LoxCallable>(newShared<BoundMethod>(std::static_pointer_cast<Self>(getShared()), method));
+			}
+		}
+
+		throw RuntimeError(name, "Undefined property '" + std::string(name.lexeme) + "'.");
+	}
+
+	void set(const Token& name, const object_t&) override
+	{
+		throw RuntimeError(name, "Can't add properties to " + std::string(Self::PLURAL) + ".");
+	}
+
+protected:
+	BuiltinInstance() : LoxInstance(Class())
+	{}
+
+	// what print writes for the object, or nested when it is being printed on this thread already, which stops an
+	// object inside itself from being printed forever
+	template <typename Print>
+	std::string printOnce(const std::string_view nested, const Print& print) const
+	{
+		if (std::find(t_printing.begin(), t_printing.end(), this) != t_printing.end()) { return std::string(nested); }
+
+		t_printing.push_back(this);
+		std::string text = print();
+		t_printing.pop_back();
+		return text;
+	}
+
+private:
+	class BoundMethod final : public LoxCallable
+	{
+	public:
+		BoundMethod(std::shared_ptr<Self> self, const Method& method) : m_self(std::move(self)), m_method(method)
+		{}
+
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			return m_method.body(*m_self, arguments);
+		}
+		size_t arity() const override { return m_method.arity; }
+
+	private:
+		std::shared_ptr<Self> m_self;
+		const Method& m_method;
+	};
+
+	static const std::shared_ptr<LoxClass>& Class()
+	{
+		static const std::shared_ptr<LoxClass> klass = newShared<LoxClass>(std::string(Self::NAME), nullptr, StringMap<std::shared_ptr<LoxFunction>>());
+		return klass;
+	}
+
+	// the objects of the type being printed on this thread
+	static inline thread_local std::vector<const BuiltinInstance*> t_printing;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+
+// The scanner's inner loops: each function consumes a run of characters starting at `p` and returns the first character
+// after it, or `end`. On x86-64 they look at 16 (SSE2) or 32 (AVX2) characters at a time, picked once from what the
+// processor supports, and finish the last few characters one at a time like every other processor does.
+struct CharRuns
+{
+	// letters, digits and underscores
+	const char* (*skipIdentifier)(const char* p, const char* end);
+	const char* (*skipDigits)(const char* p, const char* end);
+
+	// spaces, tabs, carriage returns and newlines, adds the newlines to lines
+	const char* (*skipWhitespace)(const char* p, const char* end, uint32_t& lines);
+
+	// returns the next '"' instead of the character after the run, adds the newlines before it to lines
+	const char* (*findQuote)(const char* p, const char* end, uint32_t& lines);
+
+	// returns the next '\n', the end of a comment
+	const char* (*findNewline)(const char* p, const char* end);
+
+	const char* name; // "avx2", "sse2" or "scalar"
+};
+
+const CharRuns& GetCharRuns();
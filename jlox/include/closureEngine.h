@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+#include "globalTable.h"
+#include "outputSink.h"
+
+
+// Runs resolved programs by compiling the syntax tree once into a tree of small closures:
+// every node holds a direct function pointer and its pre-resolved operands (local slot, global index or constant),
+// so execution is a chain of plain calls without visitor dispatch or lookups in the resolver's locals map.
+class ClosureEngine
+{
+public:
+	explicit ClosureEngine(OutputSink& output);
+
+	// a runtime error ends the program, and is left to the caller to report
+	void interpret(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+
+	GlobalTable globals;
+
+	OutputSink& out; // where print writes
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "astRewriter.h"
+
+
+// Replaces the desugared form of for (var i = a; i < n; i = i + c) with a CountedLoop, which the interpreter runs with an
+// unboxed counter. Only loops whose body can't change the counter qualify: the body doesn't assign the induction
+// variable and no function declared in it captures the variable. The bound has to be a literal or a variable the body
+// doesn't assign; the interpreter still checks its type on every iteration and falls back to the generic loop when it
+// stops being a number.
+class CountedLoopPass final : public AstRewriter
+{
+public:
+	explicit CountedLoopPass(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+
+private:
+	std::shared_ptr<Stmt> transform(const std::shared_ptr<Stmt>& stmt) override;
+
+	bool refersTo(const std::shared_ptr<Expr>& expr, std::string_view name, size_t depth) const;
+
+	const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+};
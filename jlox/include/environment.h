@@ -1,9 +1,10 @@
 #pragma once
 #include <string>
-#include <unordered_map>
+#include <string_view>
 
 #include "garbageCollector.h"
 #include "object.h"
+#include "stringMap.h"
 
 
 class Token;
@@ -16,12 +17,20 @@ public:
 	const std::shared_ptr<Environment>& getEnclosing() const;
 
 	object_t get(const Token& name);
-	object_t getAt(size_t distance, const std::string& name);
+	object_t getAt(size_t distance, std::string_view name);
 
 	void assign(const Token& name, object_t value);
 	void assignAt(size_t distance, const Token& name, object_t value);
 
-	void define(const std::string& name, object_t value);
+	void define(std::string_view name, object_t value);
+
+	// the storage of a variable defined in this environment itself, valid until the next definition in it
+	object_t& slot(std::string_view name);
+
+	const StringMap<object_t>& getValues() const { return m_values; }
+
+	// drops every variable, which breaks the cycles between closures and the environments they are defined in
+	void clear();
 
 
 	void debugPrint() const;
@@ -30,7 +39,7 @@ private:
 	Environment& ancestor(size_t distance);
 
 	std::shared_ptr<Environment> m_enclosing = nullptr;
-	std::unordered_map<std::string, object_t> m_values;
+	StringMap<object_t> m_values;
 };
 
 
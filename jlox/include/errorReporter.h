@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+class Token;
+
+
+// Where the scanner, parser and resolver report compile errors. Every isolate has one of its own, and every module it
+// imports one that names the module in its errors and counts them both for the module and for the isolate, since the
+// front end of modules runs on several threads at once.
+class ErrorReporter
+{
+public:
+	explicit ErrorReporter(std::ostream& out);
+
+	// reports through parent, which must outlive it
+	ErrorReporter(ErrorReporter& parent, std::string module);
+
+	ErrorReporter(const ErrorReporter&) = delete;
+	ErrorReporter& operator=(const ErrorReporter&) = delete;
+
+	void error(const Token& token, const std::string& message);
+	void error(size_t line, const std::string& message);
+
+	bool hadError() const { return m_hadError; }
+
+	// the prompt carries on after a line with errors
+	void reset() { m_hadError = false; }
+
+private:
+	ErrorReporter* m_parent = nullptr;
+	std::ostream& m_out;
+	std::string m_module;
+	std::mutex m_mutex; // serializes the reports of every thread, only the parent's is used
+	std::atomic<bool> m_hadError = false;
+
+	void report(size_t line, const std::string& where, const std::string& message);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "loxCallable.h"
+
+
+// The callbacks a script is waiting on, run one at a time on the thread that runs the script once it has finished, or
+// after every line of the prompt. sleep(ms, fn), readFileAsync(path, fn) and readLineAsync(fn) return at once and call
+// fn when the timer expires or the file or line was read, so one interpreter interleaves any number of waits without
+// threads. The loop ends when nothing is left to wait for.
+//
+// On Linux the loop waits in epoll for standard input or the next timer. Regular files cannot be watched, so they are
+// read when their turn comes, as is standard input when it is one; elsewhere reading a line holds up the timers until
+// it is typed.
+class EventLoop
+{
+public:
+	using Task = std::function<void()>;
+	using Clock = std::chrono::steady_clock;
+
+	EventLoop();
+	~EventLoop();
+
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	// in the next turn of the loop, in the order posted
+	void post(Task task);
+
+	// once the delay passed, tasks due at the same time in the order they were added, one past the clock's end never runs
+	void after(Clock::duration delay, Task task);
+
+	// with the next line of standard input, without the line break, or nothing at its end
+	void readLine(std::function<void(std::optional<std::string>)> task);
+
+	// until nothing is left, or a task throws
+	void run();
+
+	// drops every task, after a runtime error ended the script
+	void clear();
+
+private:
+	std::deque<Task> m_ready;
+	std::map<std::pair<Clock::time_point, uint64_t>, Task> m_timers;
+	uint64_t m_timersAdded = 0;
+
+	std::deque<std::function<void(std::optional<std::string>)>> m_lineReaders;
+	std::string m_input; // read but not yet given to a reader
+	bool m_inputEnded = false;
+
+#if defined(__linux__)
+	int m_epoll = -1;
+	bool m_inputWatched = false;
+	bool m_inputPollable = true; // false for regular files, which epoll refuses
+#endif
+
+	// the ready tasks, expired timers and complete lines, true if any ran
+	bool runDue();
+
+	// reads more input, giving up once the deadline passed
+	void waitForInput(std::optional<Clock::time_point> deadline);
+};
+
+
+// sleep, readFileAsync and readLineAsync
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateAsyncNatives();
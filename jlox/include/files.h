@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "builtinInstance.h"
+#include "loxCallable.h"
+
+
+// Files a script reads and writes. openFile(path) returns a file that readLine(file) and readChunk(file, size) read
+// from in order, both return nil at its end, readLine without the line break. readFile(path) returns the whole file,
+// which is mapped into memory and copied once where possible (see source.h). writeFile(path, value) and
+// appendFile(path, value) write the value as print does without the line break, in one write. Paths are relative to the
+// working directory, and the functions return nil or false when a file cannot be opened or written.
+//
+// An open file is read in large blocks into a buffer of its own that lines are cut out of, so reading a file line by
+// line needs memory for one block and one line however large the file is. The buffer only grows for a line longer than
+// it. Files are shared with the threads they are sent to, each read takes the next lines of a file. A file is an object
+// of the built-in class File without methods, it is only passed to the functions.
+class InputFile final : public BuiltinInstance<InputFile>
+{
+public:
+	explicit InputFile(const std::string& path);
+
+	// false when the file could not be opened
+	bool isOpen() const { return m_stream.is_open(); }
+
+	// without the line break, nothing at the end of the file
+	std::optional<std::string> readLine();
+
+	// at most size characters, nothing at the end of the file
+	std::optional<std::string> readChunk(size_t size);
+
+private:
+	friend BuiltinInstance;
+
+	static constexpr std::string_view NAME = "File";
+	static constexpr std::string_view PLURAL = "files";
+	static const std::array<Method, 0> methods;
+
+	std::mutex m_lock;
+	std::ifstream m_stream;
+	std::vector<char> m_buffer;
+	size_t m_begin = 0; // the first character not yet read
+	size_t m_end = 0;
+	bool m_ended = false;
+
+	// moves what is left to the front of the buffer and reads more after it, false at the end of the file
+	bool fill();
+};
+
+
+// openFile, readLine, readChunk, readFile, writeFile and appendFile
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateFileNatives();
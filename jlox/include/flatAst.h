@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+
+
+// A resolved program as one array of fixed size nodes. Children are referenced by their index in the array and are stored
+// before their parent, in the order they are evaluated, so evaluation walks the array mostly forwards. Tokens, constants,
+// functions and classes live in their own arrays and are referenced by index as well. Variables are already resolved to
+// a slot in a scope (or an index into the engine's globals) like in the closure engine.
+enum class FlatKind : uint8_t
+{
+	// expressions                  a               b               c
+	CONSTANT,                    // constant
+	LOCAL,                       // hops            slot
+	GLOBAL,                      // global          name token
+	ASSIGN_LOCAL,                // hops            slot            value
+	ASSIGN_GLOBAL,               // global          name token      value
+	ADD,                         // left            right           operator token, for all binary operators
+	SUBTRACT,
+	MULTIPLY,
+	DIVIDE,
+	GREATER,
+	GREATER_EQUAL,
+	LESS,
+	LESS_EQUAL,
+	EQUAL,
+	NOT_EQUAL,
+	AND,                         // left            right
+	OR,                          // left            right
+	NEGATE,                      // operand                         operator token
+	NOT,                         // operand
+	CALL,                        // callee          argument list   paren token
+	GET,                         // object                          name token
+	SET,                         // object          value           name token
+	SUPER,                       // hops                            method token
+
+	// statements
+	EXPRESSION,                  // expression
+	PRINT,                       // expression
+	VAR,                         // target          initializer or NONE
+	BLOCK,                       // statement list  scope size, 0 when the block declares nothing
+	IF,                          // condition       then            else or NONE
+	WHILE,                       // condition       body
+	RETURN,                      // value or NONE
+	FUNCTION,                    // target          function
+	CLASS,                       // target          class
+};
+
+struct FlatNode
+{
+	FlatKind kind;
+	bool global = false; // whether the target of a declaration is a global
+	uint32_t a = 0;
+	uint32_t b = 0;
+	uint32_t c = 0;
+};
+
+struct FlatFunction
+{
+	std::shared_ptr<Stmt::Function> declaration; // for the name and arity
+	uint32_t scopeSize = 0; // zero when the function scope is never created
+	uint32_t body = 0; // statement list
+};
+
+struct FlatClass
+{
+	uint32_t name = 0; // token
+	uint32_t superclass = 0; // expression or NONE
+	uint32_t superclassName = 0; // token
+	uint32_t methods = 0; // function list
+};
+
+struct FlatTree
+{
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	std::vector<FlatNode> nodes;
+	std::vector<Token> tokens;
+	std::vector<object_t> constants;
+	std::vector<FlatFunction> functions;
+	std::vector<FlatClass> classes;
+
+	// every list is its length followed by its elements
+	std::vector<uint32_t> lists;
+	uint32_t program = 0; // statement list
+
+	const uint32_t* list(const uint32_t index) const { return &lists[index + 1]; }
+	uint32_t length(const uint32_t index) const { return lists[index]; }
+};
+
+// converts a resolved syntax tree, globalIndex returns the index of a global variable in the engine that runs the tree
+std::shared_ptr<const FlatTree> Flatten(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, const std::function<uint32_t(std::string_view)>& globalIndex);
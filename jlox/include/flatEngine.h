@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+#include "globalTable.h"
+#include "outputSink.h"
+
+
+// Runs resolved programs by converting the syntax tree into a flat array of nodes (see flatAst.h) and evaluating it with
+// a switch over the node kind, so there are no virtual calls and the nodes of a function sit next to each other in memory.
+class FlatEngine
+{
+public:
+	explicit FlatEngine(OutputSink& output);
+
+	// a runtime error ends the program, and is left to the caller to report
+	void interpret(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+
+	GlobalTable globals;
+
+	OutputSink& out; // where print writes
+};
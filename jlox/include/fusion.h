@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <unordered_map>
+
+#include "astRewriter.h"
+
+
+// Replaces common shapes in the resolved syntax tree with fused nodes that evaluate the whole shape in one visit,
+// with the resolved depths of their variables stored in the node instead of the interpreter's locals map.
+class FusionPass final : public AstRewriter
+{
+public:
+	enum PatternId
+	{
+		INCREMENT,
+		COMPARE_CONSTANT,
+		SET_THIS,
+		GET_CHAIN,
+		NIL_CHECK,
+
+		PATTERN_COUNT
+	};
+
+	struct Pattern
+	{
+		const char* shape;
+		std::shared_ptr<Expr> (*fuse)(const FusionPass& pass, const std::shared_ptr<Expr>& expr);
+	};
+
+	// the registry of patterns, tried in order on every expression
+	static const std::array<Pattern, PATTERN_COUNT> patterns;
+
+	// by pattern, each interpreter keeps its own
+	struct Statistics
+	{
+		std::array<size_t, PATTERN_COUNT> fused{}; // nodes rewritten
+		std::array<size_t, PATTERN_COUNT> hits{};  // evaluations of the fused nodes, counted by the interpreter
+	};
+
+	FusionPass(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, Statistics& statistics);
+
+	static void PrintStatistics(std::ostream& out, const Statistics& statistics);
+
+	std::optional<size_t> depthOf(const std::shared_ptr<Expr>& expr) const;
+
+private:
+	std::shared_ptr<Expr> transform(const std::shared_ptr<Expr>& expr) override;
+
+	const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+	Statistics& m_statistics;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include <cassert>
+#include <stdexcept>
 
 template<typename T>
 class GarbageCollectable
@@ -13,7 +14,7 @@ public:
 		auto ptr = m_ptr.lock();
 		if (!ptr)
 		{
-			throw std::exception("called getShared() on an object that was never initialized with setShared().");
+			throw std::runtime_error("called getShared() on an object that was never initialized with setShared().");
 		}
 		return ptr;
 	}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+
+// The globals of the engines that compile variable names away: a global is referenced by its index, which the compiler
+// asks for once per name. The natives are defined from the start, the names are only needed to report undefined
+// variables.
+class GlobalTable
+{
+public:
+	struct Global
+	{
+		std::string_view name;
+		object_t value;
+		bool defined = false;
+	};
+
+	GlobalTable();
+
+	// the name is added, undefined, the first time
+	uint32_t index(std::string_view name);
+
+	Global& operator[](const size_t index) { return m_globals[index]; }
+
+private:
+	std::vector<Global> m_globals;
+	std::unordered_map<std::string_view, uint32_t> m_indices;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "expr.h"
+
+class Environment;
+class Interpreter;
+class LoxClass;
+class LoxFunction;
+class LoxInstance;
+
+
+// Copies values out of one interpreter's heap into new objects that share nothing mutable with it, so that another
+// thread can own them. Instances, classes, functions and the environments functions close over are copied once each
+// however often they are reached, so shared objects and cycles keep their shape in the copy. The declarations of
+// functions are copied too, with the depths the resolver found for their expressions, since the interpreter writes
+// type feedback into the nodes it runs (see specialization.h). Strings are copied by value, built-in functions,
+// channels and files hold nothing of a heap and are shared.
+//
+// The interpreter looks global variables up in its own globals, never through the closure of a function, so the
+// environment closures end in is only there to be ended in: the globals of the heap being copied map to the one given.
+class HeapCopy
+{
+public:
+	HeapCopy(const Interpreter& from, std::shared_ptr<Environment> globals);
+
+	object_t value(const object_t& value);
+
+	// defines a copy of every global variable of the heap being copied in the globals given
+	void globals();
+
+	// the depths of the copied expressions, for the interpreter that runs them
+	std::unordered_map<std::shared_ptr<Expr>, size_t> locals;
+
+private:
+	const Interpreter& m_from;
+	std::shared_ptr<Environment> m_globals;
+
+	std::unordered_map<const Environment*, std::shared_ptr<Environment>> m_environments;
+	std::unordered_map<const LoxFunction*, std::shared_ptr<LoxFunction>> m_functions;
+	std::unordered_map<const LoxClass*, std::shared_ptr<LoxClass>> m_classes;
+	std::unordered_map<const LoxInstance*, std::shared_ptr<LoxInstance>> m_instances;
+	std::unordered_map<const Stmt::Function*, std::shared_ptr<Stmt::Function>> m_declarations;
+
+	std::shared_ptr<Environment> environment(const std::shared_ptr<Environment>& environment);
+	std::shared_ptr<LoxFunction> function(const LoxFunction& function);
+	std::shared_ptr<LoxClass> klass(const LoxClass& klass);
+	std::shared_ptr<LoxInstance> instance(const LoxInstance& instance);
+
+	// the syntax tree of a function, its nested functions are copied along with it
+	std::shared_ptr<Stmt::Function> declaration(const std::shared_ptr<Stmt::Function>& declaration);
+};
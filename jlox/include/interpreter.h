@@ -2,15 +2,36 @@
 
 #include "environment.h"
 #include "expr.h"
+#include "fusion.h"
+#include "jit.h"
 #include "loxCallable.h"
+#include "outputSink.h"
+
+
+class Interpreter;
+class EventLoop;
+class Threads;
+
+// runtime type checks shared by the engines
+void CheckNumberOperand(const Token& op, const object_t& operand);
+void CheckNumberOperands(const Token& op, const object_t& left, const object_t& right);
+
+// the unspecialized operators and calls, with all their type checks
+object_t EvaluateBinary(const Token& op, const object_t& left, const object_t& right);
+object_t EvaluateUnary(const Token& op, const object_t& right);
+object_t CallValue(Interpreter* interpreter, const Token& paren, const object_t& callee, const std::vector<object_t>& arguments);
 
 
 class Interpreter final : public Expr::Visitor, public Stmt::Visitor
 {
 public:
-	Interpreter();
+	explicit Interpreter(OutputSink& output);
+
+	// runs in the globals given instead of fresh ones with the built-in functions defined, see threads.h
+	Interpreter(OutputSink& output, std::shared_ptr<Environment> globalScope);
 	~Interpreter() override = default;
 
+	// a runtime error ends the program, and is left to the caller to report
 	void interpret(const std::vector<std::shared_ptr<Stmt>>& statements);
 
 #define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
@@ -23,13 +44,31 @@ public:
 	void resolve(std::shared_ptr<Expr> expr, size_t depth);
 	object_t lookUpVariable(const Token& name, const std::shared_ptr<Expr>& expr);
 
+	// access to variables whose depth is already known, as in fused nodes
+	object_t getVariable(const Token& name, std::optional<size_t> depth);
+	void assignVariable(const Token& name, std::optional<size_t> depth, object_t value);
+
 	void executeBlock(const std::vector<std::shared_ptr<Stmt>>& stmts, std::shared_ptr<Environment> environment);
 
 	std::shared_ptr<Environment> globals = nullptr;
 	std::unordered_map<std::shared_ptr<Expr>, size_t> locals;
+
+	// compiles hot functions when enabled, see jit.h
+	std::unique_ptr<Jit> jit = nullptr;
+
+	OutputSink& out; // where print writes
+
+	// the threads of the isolate, null when spawn is not available. print holds its output lock
+	Threads* threads = nullptr;
+
+	// where sleep and the other async functions leave their callbacks, null on the threads spawn starts
+	EventLoop* events = nullptr;
+	FusionPass::Statistics fusionStatistics;
 private:
 	std::shared_ptr<Environment> m_environment = nullptr;
-	std::shared_ptr<LoxCallable> m_clockFunction = nullptr;
+	size_t m_nextCleanUp = 0; // the size of locals at which resolve() drops the unreferenced entries
+
+	void countedLoop(const Stmt::CountedLoop& stmt);
 
 	template <typename Ptr>
 	void execute(Ptr stmt) { stmt->accept(this); }
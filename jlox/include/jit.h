@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+
+class Environment;
+
+
+// Baseline x86-64 compiler for hot functions (Linux only, elsewhere every function stays interpreted).
+// A function qualifies when it only uses numbers: its parameters and own locals, number literals, arithmetic, comparisons,
+// if/while and calls to global functions that qualify themselves. Compiled code never has side effects, so when one of its
+// guards fails (an argument or a returned value that isn't a number, a callee that can't be compiled) it bails: it
+// unwinds to the call the interpreter made and the interpreter runs that whole call instead.
+class Jit
+{
+public:
+	static const bool supported;
+
+	Jit(std::shared_ptr<Environment> globals, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, size_t threshold);
+	~Jit();
+
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	// runs the call with compiled code if the function is hot enough, returns nothing when the interpreter has to run it
+	std::optional<object_t> call(const std::shared_ptr<Stmt::Function>& declaration, const std::vector<object_t>& arguments);
+
+	// the compile time and code size of every compiled function, and why the others weren't compiled
+	void printStatistics(std::ostream& out) const;
+
+	// shared with the generated code, which only looks at bailed
+	struct State
+	{
+		bool bailed = false;
+		uint64_t epoch = 0; // bumped on every call from the interpreter, globals can only change in between
+		Jit* jit = nullptr;
+	};
+
+	using NativeCode = double (*)(const double* arguments, State* state);
+
+	// a call to a global function, resolved once per epoch
+	struct CallSite
+	{
+		Token name;
+		size_t arity;
+		uint64_t epoch = 0;
+		NativeCode code = nullptr;
+	};
+
+	NativeCode resolve(CallSite& site);
+
+private:
+	struct Function
+	{
+		std::shared_ptr<Stmt::Function> declaration;
+		enum { INTERPRETED, COMPILED, REJECTED } status = INTERPRETED;
+		const char* reason = nullptr; // why it was rejected
+
+		size_t calls = 0;
+		size_t bails = 0;
+
+		NativeCode code = nullptr;
+		void* memory = nullptr;
+		size_t size = 0;
+		double compileMilliseconds = 0.0;
+		std::vector<std::unique_ptr<CallSite>> sites;
+	};
+
+	Function& entry(const std::shared_ptr<Stmt::Function>& declaration);
+	void compile(Function& function);
+
+	std::shared_ptr<Environment> m_globals;
+	const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+	size_t m_threshold;
+
+	State m_state;
+	std::unordered_map<const Stmt::Function*, Function> m_functions;
+	std::vector<const Function*> m_order; // in the order they were first called, for the statistics
+};
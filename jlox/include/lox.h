@@ -1,30 +1,120 @@
 #pragma once
 
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "closureEngine.h"
+#include "errorReporter.h"
+#include "eventLoop.h"
+#include "flatEngine.h"
 #include "interpreter.h"
+#include "modules.h"
+#include "outputSink.h"
+#include "snapshot.h"
+#include "source.h"
+#include "threads.h"
 
+class Parser;
 class RuntimeError;
-class Token;
 
+
+// An isolate: everything one program needs to run, its engines, globals, sources, modules and error state, with print
+// and errors going to streams of its own. Isolates share nothing, so a process can run several of them at once on
+// threads of their own, while one isolate must only be used by one thread at a time.
 class Lox
 {
 public:
-	static void RunFile(const char* path);
+	enum class Engine
+	{
+		INTERPRETER,
+		CLOSURE,
+		FLAT
+	};
+
+	struct Options
+	{
+		Engine engine = Engine::INTERPRETER;
+		int optimizationLevel = 1; // 0 runs the syntax tree exactly as it was parsed
+		bool fusionStatistics = false;
+		bool dumpSpecializations = false;
+		bool jit = false;
+		bool jitStatistics = false;
+		size_t jitThreshold = 100; // calls before a function is compiled
+		std::string emitCpp; // writes the program as C++ to this file instead of running it
+		bool stream = false; // runs every top-level declaration as soon as it is parsed
+		std::string cacheDirectory; // keeps the resolved programs of scripts here, see programCache.h
+		std::string snapshotOut; // writes the heap to this file after the script ran, see snapshot.h
+		std::string snapshotIn; // starts from the heap in this file
+		std::optional<OutputSink::Flush> flush; // how print is flushed, by default every line on a terminal
+	};
+
+	// the streams must outlive the isolate
+	explicit Lox(Options isolateOptions, std::ostream& out = std::cout, std::ostream& err = std::cerr);
 
-	static void RunPrompt(bool qualityOfLife = true);
+	Lox(const Lox&) = delete;
+	Lox& operator=(const Lox&) = delete;
 
-	static void Error(const Token& token, const std::string& message);
+	const Options options;
 
-	static void Error(size_t line, const std::string& message);
+	// the following return the exit code: 0, 65 after a compile error or with an invalid snapshot, 70 after a runtime
+	// error and 74 when a file could not be read or written
 
-	static void runtimeError(const RuntimeError& error);
+	int runFile(const char* path);
+
+	int runPrompt(bool qualityOfLife = true);
+
+	// defines the globals of a snapshot before a script or the prompt runs
+	int loadSnapshot(const char* path);
+
+	void printFusionStatistics(std::ostream& out) const;
+	void printJitStatistics(std::ostream& out) const;
 
 private:
-	static Interpreter m_interpreter;
+	// where print writes, flushed before errors are reported and when a script or the prompt ended
+	OutputSink m_out;
+	std::ostream& m_err;
+
+	ErrorReporter m_errors;
+	bool m_hadRuntimeError = false;
+	bool m_hadFileError = false; // the file --emit-cpp names could not be written
+
+	// every source that was run, tokens and the syntax tree point into them and functions defined by a prompt line
+	// outlive it, so they are kept as long as the isolate, and declared before the engines so they are destroyed after
+	std::vector<std::unique_ptr<Source>> m_sources;
+	Modules m_modules;
+	Snapshot m_snapshot;
+
+	Interpreter m_interpreter;
+	ClosureEngine m_closureEngine;
+	FlatEngine m_flatEngine;
+
+	// the callbacks of the interpreter, see eventLoop.h
+	EventLoop m_events;
+
+	// declared last, so the workers are waited for before anything they use is destroyed
+	Threads m_threads;
+
+	// the source must be one of m_sources, only scripts are looked up in the program cache
+	void run(std::string_view source, bool cacheable = false);
+
+	// fills the interpreter's locals, false after a resolution error
+	bool resolve(std::vector<std::shared_ptr<Stmt>>& statements);
+
+	// optimizes and runs resolved statements, or writes them as C++
+	void execute(std::vector<std::shared_ptr<Stmt>>& statements);
+
+	// specializes counted loops and fuses common shapes into single nodes, which only the interpreter runs
+	void fuse(std::vector<std::shared_ptr<Stmt>>& statements);
 
-	static bool m_hadError;
-	static bool m_hadRuntimeError;
+	// runs one declaration at a time, so only the tokens and syntax tree of the current one are kept
+	void stream(Parser& parser);
 
-	static void Run(const std::string& source);
+	// runs the callbacks the program left, unless it failed
+	void runEvents();
 
-	static void Report(size_t line, const std::string& where, const std::string& message);
+	void runtimeError(const RuntimeError& error);
 };
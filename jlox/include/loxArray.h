@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "builtinInstance.h"
+
+
+// A list of values stored one after the other, made by the built-in function Array(). Its only properties are its
+// methods: get(index), set(index, value), push(value), pop() and length(). Indices are whole numbers counted from zero,
+// and checked against the length. Arrays are compared by identity like other instances.
+class LoxArray final : public BuiltinInstance<LoxArray>
+{
+public:
+	// the elements between brackets, an array inside itself is printed as [...]
+	std::string toString() const;
+
+	std::vector<object_t> elements;
+
+private:
+	friend BuiltinInstance;
+
+	static constexpr std::string_view NAME = "Array";
+	static constexpr std::string_view PLURAL = "arrays";
+	static const std::array<Method, 5> methods;
+};
@@ -2,27 +2,30 @@
 
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 
 #include "loxCallable.h"
+#include "stringMap.h"
 
 class LoxFunction;
 
 class LoxClass final : public LoxCallable
 {
 public:
-	LoxClass(std::string name, std::shared_ptr<LoxClass> superclass, std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods);
+	LoxClass(std::string name, std::shared_ptr<LoxClass> superclass, StringMap<std::shared_ptr<LoxFunction>> methods);
 	
 	bool operator==(const LoxClass& klass) const;
 
-	std::shared_ptr<LoxFunction> findMethod(const std::string& methodName) const;
+	std::shared_ptr<LoxFunction> findMethod(std::string_view methodName) const;
 
 	object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override;
 	size_t arity() const override;
 
+	const StringMap<std::shared_ptr<LoxFunction>>& getMethods() const { return m_methods; }
+
 	std::string name;
 	std::shared_ptr<LoxClass> superclass = nullptr;
 private:
-	std::unordered_map<std::string, std::shared_ptr<LoxFunction>> m_methods;
+	StringMap<std::shared_ptr<LoxFunction>> m_methods;
 };
 
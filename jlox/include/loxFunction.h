@@ -7,7 +7,7 @@
 class LoxInstance;
 class Environment;
 
-class LoxFunction final : public LoxCallable
+class LoxFunction : public LoxCallable
 {
 public:
 	LoxFunction(std::shared_ptr<Stmt::Function> declaration, std::shared_ptr<Environment> closure, bool isInitializer);
@@ -15,13 +15,15 @@ public:
 
 	bool operator==(const LoxFunction& other) const;
 
-	std::shared_ptr<LoxFunction> bind(const LoxInstance& instance) const;
+	// other engines derive from this to run their own representation of the declaration
+	virtual std::shared_ptr<LoxFunction> bind(const LoxInstance& instance) const;
 
 	object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override;
 	size_t arity() const override;
 
 	auto getDeclaration() const { return m_declaration; }
 	auto getClosure() const { return m_closure; }
+	bool isInitializer() const { return m_isInitializer; }
 
 private:
 	std::shared_ptr<Stmt::Function> m_declaration = nullptr;
@@ -9,11 +9,13 @@ class LoxInstance: public GarbageCollectable<LoxInstance>
 public:
 	LoxInstance(std::shared_ptr<LoxClass> klass);
 
-	object_t get(const Token& name);
-	void set(const Token& name, const object_t& value);
+	// built-in types derive from this to have properties of their own, see loxArray.h
+	virtual object_t get(const Token& name);
+	virtual void set(const Token& name, const object_t& value);
 
 	const LoxClass& getClass() const { return *m_class; }
+	const StringMap<object_t>& getFields() const { return m_fields; }
 private:
 	std::shared_ptr<LoxClass> m_class;
-	std::unordered_map<std::string, object_t> m_fields;
+	StringMap<object_t> m_fields;
 };
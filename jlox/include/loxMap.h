@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "builtinInstance.h"
+
+
+// A hash map from values to values, made by the built-in function Map(). Its only properties are its methods:
+// get(key), set(key, value), has(key), delete(key), size() and keys(). Keys are compared with == like everywhere else,
+// so numbers, strings, booleans and nil by value and other objects by identity.
+//
+// The entries live in one array with a control byte each, either empty, deleted or seven bits of the key's hash.
+// Lookups compare the control bytes of sixteen entries at once and only look at entries whose bits match (a swiss
+// table), so there is no allocation per entry and a missing key is usually found missing in one step.
+class LoxMap final : public BuiltinInstance<LoxMap>
+{
+public:
+	// the entries between braces, a map inside itself is printed as {...}
+	std::string toString() const;
+
+	// null when the key is not in the map
+	const object_t* find(const object_t& key) const;
+
+	void insert(const object_t& key, object_t value);
+
+	// false when the key was not in the map
+	bool erase(const object_t& key);
+
+	size_t size() const { return m_size; }
+
+	// in no particular order, the map must not change meanwhile
+	template <typename Visit>
+	void forEach(const Visit& visit) const
+	{
+		for (size_t i = 0; i < m_capacity; i++)
+		{
+			if (m_control[i] >= 0) { visit(m_entries[i].key, m_entries[i].value); }
+		}
+	}
+
+private:
+	friend BuiltinInstance;
+
+	static constexpr std::string_view NAME = "Map";
+	static constexpr std::string_view PLURAL = "maps";
+	static const std::array<Method, 6> methods;
+
+	struct Entry
+	{
+		object_t key;
+		object_t value;
+	};
+
+	std::unique_ptr<int8_t[]> m_control;
+	std::unique_ptr<Entry[]> m_entries;
+	size_t m_capacity = 0; // a power of two, and zero or at least one group
+	size_t m_size = 0;
+	size_t m_deleted = 0; // entries marked deleted, which lookups probe past like full ones
+
+	// the index of the key's entry, or the capacity when it is missing
+	size_t index(const object_t& key, uint64_t hash) const;
+
+	// to the capacity given, which drops the deleted entries
+	void rehash(size_t capacity);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "errorReporter.h"
+#include "expr.h"
+#include "source.h"
+
+class ThreadPool;
+
+
+// `import "path";` runs a script once and defines its top-level declarations in the importing one. Every module has a
+// global namespace of its own: once resolved, its global names are prefixed with its path ("lib/shapes.area"), so they
+// cannot clash with those of other modules, and an import defines the plain names ("area") as copies in the importing
+// script. Paths are relative to the importing file, those of the main script and the prompt to its directory.
+//
+// Before anything runs, every module a program imports, directly or not, is loaded, scanned, parsed and resolved on a
+// thread pool, each only once however often it is imported. The front end shares nothing but the error reporter of the
+// isolate, through one of each module's that names it in its errors. Linking then replaces each import by the statements of the module, the first time it
+// is imported, followed by the definitions of its declarations, so the engines never see an import.
+class Modules
+{
+public:
+	// errors are reported to errors, and the trees of modules cached in cacheDirectory unless it is empty
+	Modules(ErrorReporter& errors, std::string cacheDirectory);
+
+	// the directory of the main script, the working directory until set
+	void setRoot(const std::filesystem::path& directory);
+
+	// links the imports among top-level statements and adds the resolved locals of the modules, false after an error
+	bool link(std::vector<std::shared_ptr<Stmt>>& statements, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+
+private:
+	struct Module
+	{
+		std::filesystem::path path; // canonical
+		std::string name;           // relative to the root, errors in the module name it
+		std::string prefix;         // of its global names
+		bool loaded = false;        // read, parsed and resolved without errors
+		bool linking = false;       // its statements are being linked, importing it again is circular
+		bool linked = false;
+
+		std::unique_ptr<ErrorReporter> errors; // names the module
+		std::unique_ptr<Source> source;
+		std::unique_ptr<Source> cached; // the program cache entry its tree was read from
+		std::vector<std::shared_ptr<Stmt>> statements;
+		std::unordered_map<std::shared_ptr<Expr>, size_t> locals;
+
+		std::vector<std::string_view> declarations; // its top-level names, as written
+		std::vector<std::string_view> natives;      // the built-in functions it refers to
+
+		// its global names with the prefix, the tokens of the syntax tree point into them
+		std::unordered_map<std::string_view, std::string_view> globals;
+		std::deque<std::string> names;
+
+		std::string_view global(std::string_view name);
+	};
+
+	ErrorReporter& m_errors;
+	const std::string m_cacheDirectory;
+	std::filesystem::path m_root;
+	std::unordered_map<std::string, std::unique_ptr<Module>> m_modules; // by canonical path, kept until exit
+	std::mutex m_mutex; // guards m_modules while loading
+
+	// the module an import refers to, created if it is new
+	std::pair<Module*, bool> find(const std::filesystem::path& directory, const Stmt::Import& import);
+
+	// queues the modules imported by statements that are not loaded yet
+	// errors in imports are reported to the importer's reporter
+	void load(const std::vector<std::shared_ptr<Stmt>>& statements, const std::filesystem::path& directory, ErrorReporter& importer, ThreadPool& pool);
+	void load(Module& module, const Token& path, ErrorReporter& importer, ThreadPool& pool);
+
+	// appends statements to linked with every import replaced, importer is nullptr for the main script
+	void expand(const std::vector<std::shared_ptr<Stmt>>& statements, Module* importer, std::vector<std::shared_ptr<Stmt>>& linked, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "loxCallable.h"
+
+// the built-in functions every engine defines in its global scope, the names are string literals
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateNatives();
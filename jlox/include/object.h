@@ -45,6 +45,12 @@ T as(const object_t& o);
 
 std::string toString(const object_t& o);
 
+// the most characters a number is printed with, a sign and 0.000000 before seventeen digits, with room to spare
+constexpr size_t NUMBER_LENGTH = 32;
+
+// writes the number as toString does to the buffer, which has room for NUMBER_LENGTH characters, returns its end
+char* FormatNumber(double number, char* first);
+
 bool IsNull(const object_t& o);
 
 bool IsEqual(const object_t& a, const object_t& b);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "astRewriter.h"
+
+
+// Folds constant expressions and removes code that can never run. Expressions are only folded when evaluating them
+// can't fail, so runtime errors like the one in 1 + "a" are still raised when (and if) the expression is reached.
+class Optimizer final : public AstRewriter
+{
+public:
+	using AstRewriter::rewrite;
+	void rewrite(std::vector<std::shared_ptr<Stmt>>& stmts) override;
+
+private:
+	std::shared_ptr<Stmt> transform(const std::shared_ptr<Stmt>& stmt) override;
+	std::shared_ptr<Expr> transform(const std::shared_ptr<Expr>& expr) override;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+#include "object.h"
+
+
+// Where print writes. Lines are formatted straight into a buffer of its own and handed on when it is full, when the
+// program ended or failed, or after every line when flushing lines, so printing a line is a copy instead of a string
+// built and then written through a stream synchronized with stdio. Runtime errors flush it before they are reported.
+//
+// Standard output is written to its file descriptor, with writev for a buffer and a long string at once, and flushes
+// lines when it is a terminal, so every line shows up as it is printed. Other streams, like the ones a program embedding
+// the interpreter passes, are written to with the stream itself. Threads printing to the same sink hold the isolate's
+// output lock, see threads.h.
+class OutputSink
+{
+public:
+	enum class Flush
+	{
+		WHEN_FULL,
+		EACH_LINE
+	};
+
+	// the stream must outlive the sink
+	explicit OutputSink(std::ostream& stream);
+	~OutputSink();
+
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+
+	// lines on a terminal, otherwise whole buffers
+	Flush policy;
+
+	// the value as toString writes it, and a line break
+	void print(const object_t& value);
+
+	// as is, flushed with the next line
+	void write(std::string_view text);
+
+	// hands on everything written so far
+	void flush();
+
+private:
+	static constexpr size_t CAPACITY = 64 * 1024;
+
+	std::ostream& m_stream;
+	int m_descriptor = -1; // of standard output, or -1 to write to the stream
+	std::unique_ptr<char[]> m_buffer;
+	size_t m_size = 0;
+
+	// room for this many more characters, which must fit into an empty buffer
+	char* reserve(size_t length);
+
+	// the buffer and then the text, which is not copied into it
+	void flush(std::string_view text);
+
+	void endLine();
+};
@@ -1,25 +1,48 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <vector>
 
+#include "errorReporter.h"
 #include "expr.h"
+#include "scanner.h"
 #include "token.h"
 
 
 class ParseError final : public std::exception {};
 
+// how tightly an infix operator binds, operators that bind tighter are applied first
+enum class Precedence : uint8_t
+{
+	NONE, // not an infix operator, ends the expression
+	ASSIGNMENT,
+	OR,
+	AND,
+	EQUALITY,
+	COMPARISON,
+	TERM,
+	FACTOR,
+	UNARY
+};
+
 
 class Parser
 {
 public:
-	explicit Parser(const std::vector<Token>& tokens);
+	Parser(Scanner& scanner, ErrorReporter& errors);
 
 	std::vector<std::shared_ptr<Stmt>> parse();
 
+	// parses one top-level declaration, nullptr after a syntax error, and releases the tokens of the previous one
+	std::shared_ptr<Stmt> parseDeclaration();
+	bool isAtEnd() const;
+
 private:
 	std::shared_ptr<Stmt> declaration();
 	std::shared_ptr<Stmt> classDeclaration();
+	std::shared_ptr<Stmt> importDeclaration();
 	std::shared_ptr<Stmt::Function> function(const std::string& kind);
 	std::vector<std::shared_ptr<Stmt>> block();
 	std::shared_ptr<Stmt> varDeclaration();
@@ -32,33 +55,48 @@ private:
 	std::shared_ptr<Stmt> expressionStatement();
 
 	std::shared_ptr<Expr> expression();
-	std::shared_ptr<Expr> assignment();
-	std::shared_ptr<Expr> logicOr();
-	std::shared_ptr<Expr> logicAnd();
-	std::shared_ptr<Expr> equality();
-	std::shared_ptr<Expr> comparison();
-	std::shared_ptr<Expr> term();
-	std::shared_ptr<Expr> factor();
-	std::shared_ptr<Expr> unary();
-	std::shared_ptr<Expr> call();
-	std::shared_ptr<Expr> finishCall(std::shared_ptr<Expr> callee);
+	void reduce();
 	std::shared_ptr<Expr> primary();
 
 	template <typename ... Ts>
 	bool match(Ts ... args);
 
-	Token consume(TokenType type, const std::string& message);
+	const Token& consume(TokenType type, const std::string& message);
 	bool check(TokenType type) const;
-	Token advance();
-	bool isAtEnd() const;
-	Token peek() const;
-	Token previous() const;
+	const Token& advance();
+	const Token& peek() const;
+	const Token& previous() const;
 
 	ParseError error(const Token& token, const std::string& message) const;
 	void synchronize();
 
-	const std::vector<Token>& m_tokens;
+	// tokens are pulled from the scanner as the parser advances, and only those of the current declaration are kept,
+	// a deque keeps references to them valid while it grows
+	Scanner& m_scanner;
+	ErrorReporter& m_errors;
+	std::deque<Token> m_tokens;
 	size_t m_current = 0;
+
+	// the state of expression(), kept between calls to reuse the storage
+	struct Frame
+	{
+		enum class Kind : uint8_t { EXPRESSION, GROUPING, ARGUMENTS };
+
+		Kind kind;
+		size_t operatorBase; // the operators below belong to enclosing frames
+		std::shared_ptr<Expr> callee;
+		std::vector<std::shared_ptr<Expr>> arguments;
+	};
+
+	struct Operator
+	{
+		const Token* token;
+		Precedence precedence;
+	};
+
+	std::vector<Frame> m_frames;
+	std::vector<std::shared_ptr<Expr>> m_operands;
+	std::vector<Operator> m_operators;
 };
 
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+
+
+// Resolved programs stored on disk, so an unchanged script skips scanning, parsing and resolving. An entry is named
+// after a hash of the source and holds the syntax tree as the parser built it together with the resolver's depths. The
+// header repeats the hash and size of the source, the format version and a checksum of the rest, so stale, foreign or
+// damaged files are ignored and simply rewritten. Entries are mapped when read, and the lexemes of the tokens point into
+// the mapping instead of being copied.
+class ProgramCache
+{
+public:
+	ProgramCache(const std::string& directory, std::string_view source);
+
+	// the file of the entry for this source
+	const std::string& path() const { return m_path; }
+
+	// the cached program and its resolved locals, false if the entry is not valid for this source
+	bool read(std::string_view image, std::vector<std::shared_ptr<Stmt>>& statements, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) const;
+
+	// stores a program right after resolving, before any pass rewrites it, failures only mean the next run misses
+	void write(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) const;
+
+private:
+	std::string m_directory;
+	std::string m_path;
+	uint64_t m_sourceHash;
+	uint64_t m_sourceSize;
+};
@@ -1,16 +1,21 @@
 #pragma once
 
+#include "errorReporter.h"
 #include "expr.h"
 
-#include <stack>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 class Interpreter;
 
 class Resolver final : public Stmt::Visitor, public Expr::Visitor
 {
 public:
-	explicit Resolver(Interpreter& interpreter);
+	Resolver(Interpreter& interpreter, ErrorReporter& errors);
+
+	// fills a map of its own instead of the interpreter's, so modules can be resolved on other threads
+	Resolver(std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, ErrorReporter& errors);
 
 	// visit the node
 	template <typename T>
@@ -61,8 +66,10 @@ private:
 	void resolveLocal(std::shared_ptr<Expr> expr, const Token& name) const;
 
 
-	Interpreter& m_interpreter;
-	std::stack<std::unordered_map<std::string, bool>> m_scopes;
+	ErrorReporter& m_errors;
+	Interpreter* m_interpreter = nullptr;
+	std::unordered_map<std::shared_ptr<Expr>, size_t>* m_locals = nullptr;
+	std::vector<std::unordered_map<std::string_view, bool>> m_scopes; // innermost scope last
 	FunctionType m_currentFunction = FunctionType::NONE;
 	ClassType m_currentClass = ClassType::NONE;
 };
@@ -1,22 +1,29 @@
 #pragma once
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-#include <vector>
+#include <optional>
+#include <string_view>
 
+#include "charRuns.h"
+#include "errorReporter.h"
 #include "token.h"
 
 
 class Scanner
 {
 public:
-	Scanner(const std::string& source);
+	Scanner(std::string_view source, ErrorReporter& errors);
 
-	std::vector<Token> scan();
+	// scans the next token on demand, returns END_OF_FILE from then on once the source is exhausted
+	Token next();
 
 private:
 	bool isAtEnd() const;
-	void addToken(TokenType type, object_t literal = {});
+	void addToken(TokenType type, double number = 0.0);
 	void consume();
+	void consumeUntil(const char* p);
+	const char* current() const;
+	const char* end() const;
 	char advance();
 	char peek() const;
 	char peekNext() const;
@@ -30,9 +37,10 @@ private:
 
 	size_t m_start = 0;
 	size_t m_current = 0;
-	size_t m_line = 1;
+	uint32_t m_line = 1;
 
-	const std::string& m_source;
-	std::vector<Token> m_tokens;
-	std::unordered_map<std::string, TokenType> m_keywords;
+	std::string_view m_source;
+	const CharRuns& m_runs;
+	ErrorReporter& m_errors;
+	std::optional<Token> m_token; // the token scanToken() found, if any
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+
+class Environment;
+
+
+// Images of the interpreter's heap after a script ran, so a later run continues from there instead of parsing the
+// script and running its initialization again. An image holds the script as a resolved syntax tree (see treeImage.h),
+// then every object reachable from the globals: environments, functions, classes, instances and built-in functions,
+// with strings and numbers stored inline. Objects refer to each other and to the declarations of their functions by
+// index, never by address, so an image is rebuilt wherever it is mapped. Like program cache entries, images carry a
+// checksum and are checked as they are read, a damaged one is rejected instead of reaching the interpreter.
+class Snapshot
+{
+public:
+	// keeps the script as resolved, before the passes rewrite it into nodes an image cannot hold
+	void record(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+
+	// writes the recorded script and everything reachable from the globals, false if that failed. error then tells
+	// what in the heap an image cannot hold, and is left empty when it was the file that could not be written
+	bool write(const std::string& path, const std::shared_ptr<Environment>& globals, std::string& error) const;
+
+	// defines the globals of an image in globals and adds the depths of its functions to locals, the script's statements
+	// are returned for the passes to rewrite. The lexemes point into the image, which must be kept like a source, and
+	// after a false the globals are left half defined
+	static bool Read(std::string_view image, const std::shared_ptr<Environment>& globals, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, std::vector<std::shared_ptr<Stmt>>& statements);
+
+private:
+	std::string m_tree;
+	std::unordered_map<const Stmt::Function*, uint32_t> m_functions; // the index of each declaration in the tree
+	bool m_recorded = false;
+	bool m_failed = false;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+// The text of a script or prompt line. Files are mapped into memory where possible, so the scanner reads the bytes of the
+// file itself, and read into a string otherwise (pipes, empty files, other platforms). Tokens point into the text, so
+// a source is kept until exit.
+class Source
+{
+public:
+	explicit Source(std::string text);
+	~Source();
+
+	Source(const Source&) = delete;
+	Source& operator=(const Source&) = delete;
+
+	// nullptr when the file cannot be opened
+	static std::unique_ptr<Source> Load(const char* path);
+
+	std::string_view text() const { return m_text; }
+
+private:
+	Source() = default;
+
+	static std::unique_ptr<Source> Map(const char* path);
+
+	std::string_view m_text;
+	std::string m_contents; // when the text was read rather than mapped
+	void* m_mapping = nullptr;
+	size_t m_mappingSize = 0;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <ostream>
+
+#include "astRewriter.h"
+
+
+// Type feedback for the interpreter's binary and unary nodes. A node starts out UNINITIALIZED, specializes to the operand
+// types of its first evaluation and from then on only guards those types. When a guard fails the node is deoptimized
+// and specializes again on its next evaluation, until it has been deoptimized MAX_DEOPTIMIZATIONS times: after that it
+// stays on the generic path, so a polymorphic node doesn't keep flipping between specializations.
+
+constexpr uint32_t MAX_DEOPTIMIZATIONS = 2;
+
+Specialization Specialize(const Token& op, const object_t& left, const object_t& right);
+Specialization Specialize(const Token& op, const object_t& right);
+
+void Deoptimize(Expr& expr);
+
+const char* ToString(Specialization specialization);
+
+
+// Prints the specialization state of every binary and unary node in the tree.
+class SpecializationDump final : public AstRewriter
+{
+public:
+	explicit SpecializationDump(std::ostream& out);
+
+private:
+	std::shared_ptr<Expr> transform(const std::shared_ptr<Expr>& expr) override;
+
+	std::ostream& m_out;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+// hashes std::string and std::string_view alike, so maps keyed by name can be searched with a token's lexeme without
+// building a string first
+struct StringHash
+{
+	using is_transparent = void;
+
+	size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+};
+
+template <typename T>
+using StringMap = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
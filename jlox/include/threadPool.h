@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A set of worker threads running submitted tasks in any order. Tasks may submit more tasks, wait() returns once every
+// task submitted so far, and every task those submitted, has finished.
+//
+// Every thread has a queue of its own: tasks a thread submits go to the back of its queue and it runs them from there,
+// newest first, while the other threads steal the oldest ones from the front when their own queues are empty. Tasks
+// submitted from other threads go to a shared queue, which every thread takes from the same way.
+class ThreadPool
+{
+public:
+	// at least one thread, as many as the processor runs at once by default
+	explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task);
+	void wait();
+
+	// calls wait, which blocks until another task did something. If the calling thread is one of the pool's, another
+	// thread runs the queued tasks in its place meanwhile, so tasks waiting for tasks that are still queued cannot
+	// starve the pool
+	void block(const std::function<void()>& wait);
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void work(size_t queue);
+
+	// from the thread's own queue, or stolen from another
+	bool take(size_t queue, std::function<void()>& task);
+
+	const size_t m_size;
+	std::vector<std::unique_ptr<Queue>> m_queues; // one per thread the pool was sized to, then the shared one
+	std::atomic<size_t> m_queued = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_submitted; // a task was queued or the pool is stopping
+	std::condition_variable m_finished;  // the last pending task finished
+	size_t m_pending = 0; // queued and running tasks
+	size_t m_blocked = 0; // threads in block()
+	bool m_stopping = false;
+	std::vector<std::thread> m_threads; // the spares started by block() are appended, and take from the shared queue
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "builtinInstance.h"
+#include "expr.h"
+#include "loxCallable.h"
+#include "threadPool.h"
+
+class OutputSink;
+class RuntimeError;
+
+
+// Threads with a heap each. spawn(fn, arg) calls fn(arg) on a worker thread, in a copy of the spawning heap's globals
+// and of fn and arg (see heapCopy.h), and returns a channel the worker sends a copy of the result to. Threads share no
+// mutable objects, only channels, so environments, instances and the type feedback in the syntax tree need no locks.
+// send(channel, value) copies the value for whoever receives it, receive(channel) waits for a value.
+//
+// Only the tree-walking interpreter runs threads: the other engines keep state of their own next to the heap.
+
+
+// a value copied out of one heap, with the depths of the functions copied along with it
+struct Message
+{
+	object_t value;
+	std::unordered_map<std::shared_ptr<Expr>, size_t> locals;
+};
+
+
+// An unbounded queue of messages any number of threads send to and receive from, so a send never waits. Messages are
+// kept in segments of slots, linked in the order they fill up. A slot is claimed with a compare and swap on the send or
+// the receive position and its message published by storing the pointer, so neither end takes a lock. Whoever claims
+// the last slot of a segment links the next one for the senders, or moves the receivers on to it. A segment the
+// receivers left is freed once no send or receive is under way, those are all that could still be looking at it.
+// A channel is an object of the built-in class Channel without methods, it is only passed to send and receive.
+class Channel final : public BuiltinInstance<Channel>
+{
+public:
+	Channel();
+	~Channel() override;
+
+	Channel(const Channel&) = delete;
+	Channel& operator=(const Channel&) = delete;
+
+	void send(std::unique_ptr<Message> message);
+
+	// null when the channel is empty
+	std::unique_ptr<Message> tryReceive();
+	bool empty() const;
+
+	// bumped by every send, and by changed
+	uint32_t version() const { return m_version.load(); }
+
+	// until the version is no longer the one given
+	void wait(uint32_t version);
+
+	// wakes the threads waiting, to look at the channel again
+	void changed();
+
+private:
+	friend BuiltinInstance;
+
+	static constexpr std::string_view NAME = "Channel";
+	static constexpr std::string_view PLURAL = "channels";
+	static const std::array<Method, 0> methods;
+
+	static constexpr size_t SEGMENT = 32;
+
+	struct Segment
+	{
+		explicit Segment(const size_t first) : first(first)
+		{}
+
+		const size_t first; // the position of the first slot
+		std::array<std::atomic<Message*>, SEGMENT> slots{}; // null until the message is sent
+		std::atomic<Segment*> next = nullptr;
+		Segment* retired = nullptr; // the next segment to free
+	};
+
+	// counts itself as under way while it lives
+	class Operation;
+
+	std::atomic<size_t> m_sendPosition = 0;
+	std::atomic<size_t> m_receivePosition = 0;
+	std::atomic<Segment*> m_sendSegment;
+	std::atomic<Segment*> m_receiveSegment;
+
+	std::atomic<Segment*> m_retired = nullptr;
+	std::atomic<uint32_t> m_operations = 0;
+
+	std::atomic<uint32_t> m_version = 0;
+	std::atomic<uint32_t> m_waiting = 0; // notifying is skipped while nobody waits
+
+	void retire(Segment* segment);
+	void freeRetired();
+};
+
+
+// the threads of one isolate
+class Threads
+{
+public:
+	// print writes to the output, which runtime errors flush before they are reported
+	Threads(OutputSink& out, std::ostream& err);
+
+	// waits for the workers
+	~Threads();
+
+	Threads(const Threads&) = delete;
+	Threads& operator=(const Threads&) = delete;
+
+	// started by the first spawn
+	ThreadPool& pool();
+
+	// until every worker spawned so far, and every one they spawned, has returned
+	void wait();
+
+	// a message from the channel, waiting while it is empty, and a worker waiting is replaced by another meanwhile.
+	// Waiting while every other thread waits as well, or has returned, is a runtime error, nothing could send then
+	std::unique_ptr<Message> receive(Channel& channel);
+
+	// a worker is counted from when it is spawned until it returned
+	void spawned();
+	void returned();
+
+	// reports an error of the main thread or a worker
+	void runtimeError(const RuntimeError& error);
+	bool hadRuntimeError() const { return m_hadRuntimeError; }
+
+	// held while printing, so the lines of threads are not interleaved
+	std::mutex output;
+
+private:
+	OutputSink& m_out;
+	std::ostream& m_err;
+
+	std::once_flag m_started;
+	std::unique_ptr<ThreadPool> m_pool;
+	std::atomic<bool> m_hadRuntimeError = false;
+
+	// the threads that have not returned, the main one included, and the channel each thread waiting waits on
+	std::mutex m_mutex;
+	size_t m_alive = 1;
+	std::vector<Channel*> m_receiving;
+	bool m_mainReceiving = false;
+	bool m_mainWaiting = false; // for the workers, in wait
+	bool m_deadlocked = false;  // until the last thread waiting stopped
+	std::atomic<bool> m_deadlockReported = false; // or left to the main thread
+
+	const std::thread::id m_mainThread = std::this_thread::get_id(); // the one that made the threads
+
+	// tells the threads waiting to stop when none can be woken by another
+	void detectDeadlock();
+};
+
+
+// spawn, channel, send and receive
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateThreadNatives();
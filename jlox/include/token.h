@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #include "object.h"
 
@@ -19,24 +21,37 @@ enum TokenType
 	IDENTIFIER, STRING, NUMBER,
 
 	// Keywords
-	AND, CLASS, ELSE, FALSE, FUN, FOR, IF, NIL, OR, PRINT, RETURN, SUPER, THIS, TRUE, VAR, WHILE,
+	AND, CLASS, ELSE, FALSE, FUN, FOR, IF, IMPORT, NIL, OR, PRINT, RETURN, SUPER, THIS, TRUE, VAR, WHILE,
 
 	END_OF_FILE
 };
 
 
+// 32 bytes: the lexeme points into the source, which outlives the syntax tree (see Lox::run), and only number tokens
+// carry a value, the value of a string is its lexeme without the quotes
 class Token
 {
 public:
-	Token(const TokenType type, std::string lexeme, object_t literal, const size_t line) :
+	Token(const TokenType type, const std::string_view lexeme, const uint32_t line, const double number = 0.0) :
 		type(type),
-		lexeme(std::move(lexeme)),
-		literal(std::move(literal)),
-		line(line)
+		line(line),
+		lexeme(lexeme),
+		number(number)
 	{}
 
+	// the value of a NUMBER or STRING token, nil for everything else
+	object_t literal() const
+	{
+		switch (type)
+		{
+		case NUMBER: return number;
+		case STRING: return std::string(lexeme.substr(1, lexeme.size() - 2));
+		default: return {};
+		}
+	}
+
 	TokenType type;
-	std::string lexeme;
-	object_t literal;
-	size_t line;
+	uint32_t line;
+	std::string_view lexeme;
+	double number;
 };
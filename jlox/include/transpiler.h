@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+
+
+// Translates a resolved program into a standalone C++ translation unit (--emit-cpp). Every Lox function becomes a C++
+// function and every statement becomes the C++ that the interpreter would run for it, written against the runtime in
+// aot.h, so the program still uses the interpreter's environments, classes and error messages and prints exactly what
+// the interpreter prints. Build the output together with everything in src/ but main.cpp, see the README.
+class Transpiler final : public Stmt::Visitor, public Expr::Visitor
+{
+public:
+	explicit Transpiler(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals);
+
+	void emit(const std::vector<std::shared_ptr<Stmt>>& statements, std::ostream& out);
+
+#define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
+	STMT_TYPES;
+#undef TYPE
+#define TYPE(name, ...) object_t visit ## name ## Expr(Expr::name& expr) override;
+	EXPR_TYPES;
+#undef TYPE
+
+private:
+	// the C++ function being written, its environments are env0 (the parameters, or the globals) to envN
+	struct Function
+	{
+		std::ostringstream code;
+		size_t depth = 0;
+		size_t indent = 1;
+	};
+
+	void block(const std::shared_ptr<Stmt>& stmt);
+	std::string expression(const std::shared_ptr<Expr>& expr);
+	std::string function(const Stmt::Function& declaration);
+	std::ostream& line();
+
+	// C++ that reads or assigns the variable, depth is the resolver's distance and nothing for globals
+	std::string variable(const Token& name, std::optional<size_t> depth);
+	std::string assign(const Token& name, std::optional<size_t> depth, const std::string& value);
+	std::optional<size_t> depthOf(const Expr& expr) const;
+	std::string environment() const;
+
+	std::string token(const Token& token);
+	std::string literal(const object_t& value);
+
+	const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+
+	std::vector<std::unique_ptr<Function>> m_functions;
+	std::string m_expr;
+
+	std::map<std::tuple<int, std::string_view, uint32_t>, std::string> m_tokens;
+	std::map<std::string, std::string> m_strings;
+	std::ostringstream m_constants;
+	std::ostringstream m_prototypes;
+	std::ostringstream m_definitions;
+	std::ostringstream m_declarations;
+	std::vector<std::string> m_declarationInitializers; // run in main, D<index> for every function and method
+};
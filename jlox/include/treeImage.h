@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "expr.h"
+
+
+// The binary form of resolved syntax trees that the program cache and snapshots store. A tree is a statement count,
+// then every statement as a tag followed by its fields; expressions carry their resolved depth plus one, zero when the
+// resolver left them to the globals. Numbers are in the byte order of the machine that wrote them, the files that hold
+// a tree record it in their header.
+
+// eight bytes at a time, the source of a large script is hashed on every run
+uint64_t ImageHash(std::string_view bytes);
+
+
+class TreeWriter final : public Stmt::Visitor, public Expr::Visitor
+{
+public:
+	explicit TreeWriter(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) : m_locals(locals) {}
+
+	std::string payload;
+	bool failed = false; // the tree holds a node only a later pass creates
+
+	// every function and method by the order it was written in, which is the order TreeReader reads them in
+	std::unordered_map<const Stmt::Function*, uint32_t> functions;
+
+	void statements(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+#define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
+	STMT_TYPES;
+#undef TYPE
+#define TYPE(name, ...) object_t visit ## name ## Expr(Expr::name& expr) override;
+	EXPR_TYPES;
+#undef TYPE
+
+private:
+	const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+
+	void stmt(Stmt* statement);
+	void expr(Expr* expression);
+
+	template <typename T>
+	void put(const T value)
+	{
+		payload.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void bytes(std::string_view text);
+	void token(const Token& token);
+	void header(uint8_t tag, Expr& expr);
+};
+
+
+// every read is checked against the end of the image, and every depth against the names declared in the scopes the
+// resolver would have seen at that point, the engines trust both, so a damaged image fails instead of reaching them
+class TreeReader
+{
+public:
+	TreeReader(std::string_view image, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) :
+		m_position(image.data()),
+		m_end(image.data() + image.size()),
+		m_locals(locals)
+	{}
+
+	struct Function
+	{
+		std::shared_ptr<Stmt::Function> declaration;
+		std::vector<std::unordered_set<std::string_view>> scopes; // the names its body may find in enclosing scopes
+		bool method = false;
+	};
+
+	bool failed = false;
+
+	// every function and method in the order they were read, the order TreeWriter numbers them in
+	std::vector<Function> functions;
+
+	bool atEnd() const { return m_position == m_end; }
+
+	bool statements(std::vector<std::shared_ptr<Stmt>>& statements);
+
+private:
+	const char* m_position;
+	const char* m_end;
+	std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+
+	std::vector<std::unordered_set<std::string_view>> m_scopes; // the names declared so far, like the resolver's
+	size_t m_functions = 0; // the functions the reader is inside of
+
+	bool fail();
+	void declare(std::string_view name);
+
+	template <typename T>
+	T get();
+
+	std::string_view bytes();
+	Token token();
+
+	template <typename T>
+	std::shared_ptr<T> required(std::shared_ptr<T> node);
+
+	std::shared_ptr<Stmt> stmt();
+	std::shared_ptr<Expr> expr();
+	std::shared_ptr<Stmt::Function> function(bool method);
+	std::shared_ptr<Expr> node(uint8_t tag, std::string_view& name);
+};
@@ -0,0 +1,172 @@
+#include "aot.h"
+
+#include <iostream>
+#include <unordered_map>
+
+#include "loxInstance.h"
+#include "natives.h"
+
+
+namespace
+{
+	// where print writes, flushed when the program ends
+	OutputSink& Output()
+	{
+		static OutputSink sink(std::cout);
+		return sink;
+	}
+}
+
+
+aot::Function::Function(std::shared_ptr<Stmt::Function> declaration, const Body body, std::shared_ptr<Environment> closure, const bool isInitializer) :
+	LoxFunction(std::move(declaration), std::move(closure), isInitializer),
+	m_body(body)
+{}
+
+std::shared_ptr<LoxFunction> aot::Function::bind(const LoxInstance& instance) const
+{
+	auto environment = newShared<Environment>(getClosure());
+	environment->define("this", instance.getShared());
+	return newShared<Function>(getDeclaration(), m_body, std::move(environment), isInitializer());
+}
+
+object_t aot::Function::call(Interpreter*, const std::vector<object_t>& arguments) const
+{
+	auto environment = newShared<Environment>(getClosure());
+
+	const auto& params = getDeclaration()->params;
+	for (size_t i = 0; i < params.size(); i++)
+	{
+		environment->define(params[i].lexeme, arguments[i]);
+	}
+
+	object_t result = m_body(environment);
+
+	if (isInitializer()) { return getClosure()->getAt(0, "this"); }
+	return result;
+}
+
+
+std::shared_ptr<Environment> aot::CreateGlobals()
+{
+	auto globals = newShared<Environment>(nullptr);
+	for (auto& [name, native] : CreateNatives())
+	{
+		globals->define(name, std::move(native));
+	}
+	return globals;
+}
+
+std::shared_ptr<Stmt::Function> aot::Declare(Token name, std::vector<Token> params)
+{
+	return newShared<Stmt::Function>(std::move(name), std::move(params), std::vector<std::shared_ptr<Stmt>>());
+}
+
+int aot::Run(void (*program)())
+{
+	try
+	{
+		program();
+	}
+	catch (RuntimeError& error)
+	{
+		Output().flush();
+		std::cerr << error.what() << "\n[line " << error.token.line << "]\n";
+		return 70;
+	}
+	Output().flush();
+	return 0;
+}
+
+
+// statements
+void aot::DefineFunction(const std::shared_ptr<Environment>& environment, const std::shared_ptr<Stmt::Function>& declaration, const Body body)
+{
+	std::shared_ptr<LoxCallable> function = newShared<Function>(declaration, body, environment, false);
+	environment->define(declaration->name.lexeme, std::move(function));
+}
+
+void aot::DefineClass(const std::shared_ptr<Environment>& environment, const Token& name, std::shared_ptr<LoxClass> superclass, const std::vector<Method>& methods)
+{
+	environment->define(name.lexeme, {});
+
+	// methods close over an environment that defines "super"
+	std::shared_ptr<Environment> closure = environment;
+	if (superclass != nullptr)
+	{
+		closure = newShared<Environment>(environment);
+		closure->define("super", superclass);
+	}
+
+	StringMap<std::shared_ptr<LoxFunction>> functions;
+	for (const auto& [declaration, body] : methods)
+	{
+		functions.insert_or_assign(std::string(declaration->name.lexeme), newShared<Function>(declaration, body, closure, declaration->name.lexeme == "init"));
+	}
+
+	environment->assign(name, newShared<LoxClass>(std::string(name.lexeme), std::move(superclass), std::move(functions)));
+}
+
+std::shared_ptr<LoxClass> aot::Superclass(const Token& name, const object_t& value)
+{
+	if (!is<std::shared_ptr<LoxClass>>(value))
+	{
+		throw RuntimeError(name, "Superclass must be a class.");
+	}
+	return as<std::shared_ptr<LoxClass>>(value);
+}
+
+void aot::Print(const object_t& value)
+{
+	Output().print(value);
+}
+
+
+// expressions
+object_t aot::Binary(const Token& op, const Operands& operands)
+{
+	return EvaluateBinary(op, operands.left, operands.right);
+}
+
+object_t aot::Call(const Token& paren, const std::vector<object_t>& calleeAndArguments)
+{
+	const std::vector<object_t> arguments(calleeAndArguments.begin() + 1, calleeAndArguments.end());
+	return CallValue(nullptr, paren, calleeAndArguments.front(), arguments);
+}
+
+object_t aot::Get(const Token& name, const object_t& object)
+{
+	if (is<std::shared_ptr<LoxInstance>>(object))
+	{
+		return as<std::shared_ptr<LoxInstance>>(object)->get(name);
+	}
+
+	throw RuntimeError(name, "Only instances have properties.");
+}
+
+object_t aot::Super(const std::shared_ptr<Environment>& environment, const size_t distance, const Token& method)
+{
+	const auto superclass = as<std::shared_ptr<LoxClass>>(environment->getAt(distance, "super"));
+	const auto function = superclass->findMethod(method.lexeme);
+
+	if (!function)
+	{
+		throw RuntimeError(method, "Undefined property '" + std::string(method.lexeme) + "'.");
+	}
+
+	const auto instance = as<std::shared_ptr<LoxInstance>>(environment->getAt(distance - 1, "this"));
+	return function->bind(*instance);
+}
+
+void aot::CheckInstance(const Token& name, const object_t& object)
+{
+	if (!is<std::shared_ptr<LoxInstance>>(object))
+	{
+		throw RuntimeError(name, "Only instances have fields.");
+	}
+}
+
+void aot::SetField(const Token& name, const object_t& object, const object_t& value)
+{
+	as<std::shared_ptr<LoxInstance>>(object)->set(name, value);
+}
@@ -0,0 +1,209 @@
+#include "astRewriter.h"
+
+
+void AstRewriter::rewrite(std::vector<std::shared_ptr<Stmt>>& stmts)
+{
+	for (auto& stmt : stmts)
+	{
+		rewrite(stmt);
+	}
+}
+
+void AstRewriter::rewrite(std::shared_ptr<Stmt>& stmt)
+{
+	if (stmt == nullptr) return;
+
+	stmt->accept(this);
+	if (std::shared_ptr<Stmt> replacement = transform(stmt))
+	{
+		stmt = std::move(replacement);
+	}
+}
+
+void AstRewriter::rewrite(std::shared_ptr<Expr>& expr)
+{
+	if (expr == nullptr) return;
+
+	expr->accept(this);
+	if (std::shared_ptr<Expr> replacement = transform(expr))
+	{
+		expr = std::move(replacement);
+	}
+}
+
+
+// statements ------------------------------------------------------
+
+void AstRewriter::visitBlockStmt(Stmt::Block& stmt)
+{
+	rewrite(stmt.statements);
+}
+
+void AstRewriter::visitClassStmt(Stmt::Class& stmt)
+{
+	// the superclass is always a plain variable, the method declarations themselves are kept
+	for (const auto& method : stmt.methods)
+	{
+		rewrite(method->body);
+	}
+}
+
+void AstRewriter::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+{
+	// the interpreter relies on the shape of the condition and the increment, so they are visited but never replaced
+	std::shared_ptr<Stmt> variable = stmt.variable;
+	rewrite(variable);
+	std::shared_ptr<Expr> condition = stmt.condition;
+	rewrite(condition);
+	rewrite(stmt.body);
+	std::shared_ptr<Expr> increment = stmt.increment;
+	rewrite(increment);
+}
+
+void AstRewriter::visitExpressionStmt(Stmt::Expression& stmt)
+{
+	rewrite(stmt.expression);
+}
+
+void AstRewriter::visitFunctionStmt(Stmt::Function& stmt)
+{
+	rewrite(stmt.body);
+}
+
+void AstRewriter::visitIfStmt(Stmt::If& stmt)
+{
+	rewrite(stmt.condition);
+	rewrite(stmt.thenBranch);
+	rewrite(stmt.elseBranch);
+}
+
+void AstRewriter::visitImportStmt(Stmt::Import&)
+{
+}
+
+void AstRewriter::visitPrintStmt(Stmt::Print& stmt)
+{
+	rewrite(stmt.expression);
+}
+
+void AstRewriter::visitReturnStmt(Stmt::Return& stmt)
+{
+	rewrite(stmt.value);
+}
+
+void AstRewriter::visitVarStmt(Stmt::Var& stmt)
+{
+	rewrite(stmt.initializer);
+}
+
+void AstRewriter::visitWhileStmt(Stmt::While& stmt)
+{
+	rewrite(stmt.condition);
+	rewrite(stmt.body);
+}
+
+
+// expressions -----------------------------------------------------
+
+object_t AstRewriter::visitAssignExpr(Expr::Assign& expr)
+{
+	rewrite(expr.value);
+	return {};
+}
+
+object_t AstRewriter::visitBinaryExpr(Expr::Binary& expr)
+{
+	rewrite(expr.left);
+	rewrite(expr.right);
+	return {};
+}
+
+object_t AstRewriter::visitCallExpr(Expr::Call& expr)
+{
+	rewrite(expr.callee);
+	for (auto& argument : expr.arguments)
+	{
+		rewrite(argument);
+	}
+	return {};
+}
+
+object_t AstRewriter::visitCompareConstantExpr(Expr::CompareConstant&)
+{
+	return {};
+}
+
+object_t AstRewriter::visitGetExpr(Expr::Get& expr)
+{
+	rewrite(expr.object);
+	return {};
+}
+
+object_t AstRewriter::visitGetChainExpr(Expr::GetChain& expr)
+{
+	rewrite(expr.object);
+	return {};
+}
+
+object_t AstRewriter::visitGroupingExpr(Expr::Grouping& expr)
+{
+	rewrite(expr.expression);
+	return {};
+}
+
+object_t AstRewriter::visitIncrementExpr(Expr::Increment&)
+{
+	return {};
+}
+
+object_t AstRewriter::visitLiteralExpr(Expr::Literal&)
+{
+	return {};
+}
+
+object_t AstRewriter::visitLogicalExpr(Expr::Logical& expr)
+{
+	rewrite(expr.left);
+	rewrite(expr.right);
+	return {};
+}
+
+object_t AstRewriter::visitNilCheckExpr(Expr::NilCheck& expr)
+{
+	rewrite(expr.operand);
+	return {};
+}
+
+object_t AstRewriter::visitSetExpr(Expr::Set& expr)
+{
+	rewrite(expr.object);
+	rewrite(expr.value);
+	return {};
+}
+
+object_t AstRewriter::visitSetThisExpr(Expr::SetThis& expr)
+{
+	rewrite(expr.value);
+	return {};
+}
+
+object_t AstRewriter::visitSuperExpr(Expr::Super&)
+{
+	return {};
+}
+
+object_t AstRewriter::visitThisExpr(Expr::This&)
+{
+	return {};
+}
+
+object_t AstRewriter::visitUnaryExpr(Expr::Unary& expr)
+{
+	rewrite(expr.right);
+	return {};
+}
+
+object_t AstRewriter::visitVariableExpr(Expr::Variable&)
+{
+	return {};
+}
@@ -0,0 +1,264 @@
+#include "charRuns.h"
+
+#include <bit>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHAR_RUNS_X86_64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// gcc and clang only emit AVX2 instructions in functions marked for it, msvc emits any intrinsic anywhere
+#if defined(__GNUC__)
+#define CHAR_RUNS_AVX2 __attribute__((target("avx2")))
+#else
+#define CHAR_RUNS_AVX2
+#endif
+
+
+namespace
+{
+	// scalar ----------------------------------------------------------
+
+	bool IsDigit(const char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	bool IsIdentifier(const char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || IsDigit(c) || c == '_';
+	}
+
+	bool IsWhitespace(const char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	const char* ScalarSkipIdentifier(const char* p, const char* end)
+	{
+		while (p < end && IsIdentifier(*p)) p++;
+		return p;
+	}
+
+	const char* ScalarSkipDigits(const char* p, const char* end)
+	{
+		while (p < end && IsDigit(*p)) p++;
+		return p;
+	}
+
+	const char* ScalarSkipWhitespace(const char* p, const char* end, uint32_t& lines)
+	{
+		for (; p < end && IsWhitespace(*p); p++)
+		{
+			if (*p == '\n') lines++;
+		}
+		return p;
+	}
+
+	const char* ScalarFindQuote(const char* p, const char* end, uint32_t& lines)
+	{
+		for (; p < end && *p != '"'; p++)
+		{
+			if (*p == '\n') lines++;
+		}
+		return p;
+	}
+
+	const char* ScalarFindNewline(const char* p, const char* end)
+	{
+		while (p < end && *p != '\n') p++;
+		return p;
+	}
+
+
+#if defined(CHAR_RUNS_X86_64)
+	// vectors ---------------------------------------------------------
+
+	// every kernel works on a bit mask per block, bit i set when character i is part of the run, so the same loops serve
+	// both widths, a block that is not all ones ends the run
+	template <typename Isa>
+	const char* SkipIdentifier(const char* p, const char* end)
+	{
+		for (; end - p >= Isa::WIDTH; p += Isa::WIDTH)
+		{
+			if (const uint32_t mask = Isa::Identifier(p); mask != Isa::ALL) return p + std::countr_one(mask);
+		}
+		return ScalarSkipIdentifier(p, end);
+	}
+
+	template <typename Isa>
+	const char* SkipDigits(const char* p, const char* end)
+	{
+		for (; end - p >= Isa::WIDTH; p += Isa::WIDTH)
+		{
+			if (const uint32_t mask = Isa::Digits(p); mask != Isa::ALL) return p + std::countr_one(mask);
+		}
+		return ScalarSkipDigits(p, end);
+	}
+
+	template <typename Isa>
+	const char* SkipWhitespace(const char* p, const char* end, uint32_t& lines)
+	{
+		for (; end - p >= Isa::WIDTH; p += Isa::WIDTH)
+		{
+			const uint32_t newlines = Isa::Equal(p, '\n');
+			if (const uint32_t mask = Isa::Whitespace(p) | newlines; mask != Isa::ALL)
+			{
+				const int length = std::countr_one(mask);
+				lines += std::popcount(newlines & ((1u << length) - 1));
+				return p + length;
+			}
+			lines += std::popcount(newlines);
+		}
+		return ScalarSkipWhitespace(p, end, lines);
+	}
+
+	template <typename Isa>
+	const char* FindQuote(const char* p, const char* end, uint32_t& lines)
+	{
+		for (; end - p >= Isa::WIDTH; p += Isa::WIDTH)
+		{
+			const uint32_t newlines = Isa::Equal(p, '\n');
+			if (const uint32_t quotes = Isa::Equal(p, '"'); quotes != 0)
+			{
+				const int length = std::countr_zero(quotes);
+				lines += std::popcount(newlines & ((1u << length) - 1));
+				return p + length;
+			}
+			lines += std::popcount(newlines);
+		}
+		return ScalarFindQuote(p, end, lines);
+	}
+
+	template <typename Isa>
+	const char* FindNewline(const char* p, const char* end)
+	{
+		for (; end - p >= Isa::WIDTH; p += Isa::WIDTH)
+		{
+			if (const uint32_t newlines = Isa::Equal(p, '\n'); newlines != 0) return p + std::countr_zero(newlines);
+		}
+		return ScalarFindNewline(p, end);
+	}
+
+	// characters are compared as signed bytes, so anything outside ASCII is below every range and never part of a run
+	struct Sse2
+	{
+		static constexpr ptrdiff_t WIDTH = 16;
+		static constexpr uint32_t ALL = 0xFFFF;
+
+		static __m128i Load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+
+		static __m128i InRange(const __m128i v, const char low, const char high)
+		{
+			return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(low - 1))), _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(high + 1))));
+		}
+
+		static uint32_t Equal(const char* p, const char c)
+		{
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(Load(p), _mm_set1_epi8(c))));
+		}
+
+		static uint32_t Digits(const char* p)
+		{
+			return static_cast<uint32_t>(_mm_movemask_epi8(InRange(Load(p), '0', '9')));
+		}
+
+		static uint32_t Identifier(const char* p)
+		{
+			const __m128i v = Load(p);
+			// setting bit 5 folds upper case into lower case and moves no other character into 'a'..'z'
+			const __m128i letters = InRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+			const __m128i underscores = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, InRange(v, '0', '9')), underscores)));
+		}
+
+		// without newlines, the kernels count those separately
+		static uint32_t Whitespace(const char* p)
+		{
+			const __m128i v = Load(p);
+			const __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(spaces, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')))));
+		}
+	};
+
+	struct Avx2
+	{
+		static constexpr ptrdiff_t WIDTH = 32;
+		static constexpr uint32_t ALL = 0xFFFFFFFF;
+
+		CHAR_RUNS_AVX2 static __m256i Load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+
+		CHAR_RUNS_AVX2 static __m256i InRange(const __m256i v, const char low, const char high)
+		{
+			return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(low - 1))), _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), v));
+		}
+
+		CHAR_RUNS_AVX2 static uint32_t Equal(const char* p, const char c)
+		{
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(Load(p), _mm256_set1_epi8(c))));
+		}
+
+		CHAR_RUNS_AVX2 static uint32_t Digits(const char* p)
+		{
+			return static_cast<uint32_t>(_mm256_movemask_epi8(InRange(Load(p), '0', '9')));
+		}
+
+		CHAR_RUNS_AVX2 static uint32_t Identifier(const char* p)
+		{
+			const __m256i v = Load(p);
+			const __m256i letters = InRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+			const __m256i underscores = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letters, InRange(v, '0', '9')), underscores)));
+		}
+
+		CHAR_RUNS_AVX2 static uint32_t Whitespace(const char* p)
+		{
+			const __m256i v = Load(p);
+			const __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(spaces, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')))));
+		}
+	};
+
+	template <typename Isa>
+	constexpr CharRuns Vectorized(const char* name)
+	{
+		return { SkipIdentifier<Isa>, SkipDigits<Isa>, SkipWhitespace<Isa>, FindQuote<Isa>, FindNewline<Isa>, name };
+	}
+
+	// AVX2 needs the processor to support it and the operating system to save the 256 bit registers
+	bool HasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+}
+
+const CharRuns& GetCharRuns()
+{
+#if defined(CHAR_RUNS_X86_64)
+	// SSE2 is part of x86-64
+	static const CharRuns runs = HasAvx2() ? Vectorized<Avx2>("avx2") : Vectorized<Sse2>("sse2");
+	return runs;
+#else
+	static constexpr CharRuns runs = { ScalarSkipIdentifier, ScalarSkipDigits, ScalarSkipWhitespace, ScalarFindQuote, ScalarFindNewline, "scalar" };
+	return runs;
+#endif
+}
@@ -0,0 +1,1059 @@
+#include "closureEngine.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <type_traits>
+
+#include "interpreter.h"
+#include "loxClass.h"
+#include "loxFunction.h"
+#include "loxInstance.h"
+#include "RuntimeError.h"
+
+
+namespace
+{
+	// runtime ---------------------------------------------------------
+
+	// the variables of one scope, scopes that don't declare anything are never created
+	struct Scope
+	{
+		Scope(std::shared_ptr<Scope> enclosing, const size_t size) : enclosing(std::move(enclosing)), slots(size) {}
+
+		std::shared_ptr<Scope> enclosing;
+		std::vector<object_t> slots;
+	};
+
+	struct Context
+	{
+		ClosureEngine& engine;
+		std::shared_ptr<Scope> scope;
+		object_t returnValue;
+	};
+
+	Scope& Ancestor(const Context& context, size_t hops)
+	{
+		Scope* scope = context.scope.get();
+		while (hops-- > 0) { scope = scope->enclosing.get(); }
+		return *scope;
+	}
+
+	// restores the current scope when a block is left, also when it is left through an exception
+	class ScopeGuard
+	{
+	public:
+		ScopeGuard(Context& context, std::shared_ptr<Scope> scope) : m_context(context), m_previous(std::move(context.scope))
+		{
+			m_context.scope = std::move(scope);
+		}
+		ScopeGuard(const ScopeGuard&) = delete;
+		ScopeGuard& operator=(const ScopeGuard&) = delete;
+		~ScopeGuard() { m_context.scope = std::move(m_previous); }
+
+	private:
+		Context& m_context;
+		std::shared_ptr<Scope> m_previous;
+	};
+
+
+	// nodes -----------------------------------------------------------
+
+	struct ExprNode
+	{
+		using Fn = object_t(*)(const ExprNode& node, Context& context);
+
+		explicit ExprNode(const Fn fn) : fn(fn) {}
+		virtual ~ExprNode() = default;
+
+		object_t operator()(Context& context) const { return fn(*this, context); }
+
+		Fn fn;
+	};
+
+	// statements return true when a return statement was executed
+	struct StmtNode
+	{
+		using Fn = bool(*)(const StmtNode& node, Context& context);
+
+		explicit StmtNode(const Fn fn) : fn(fn) {}
+		virtual ~StmtNode() = default;
+
+		bool operator()(Context& context) const { return fn(*this, context); }
+
+		Fn fn;
+	};
+
+	using ExprPtr = std::unique_ptr<ExprNode>;
+	using StmtPtr = std::unique_ptr<StmtNode>;
+
+	bool Execute(const std::vector<StmtPtr>& stmts, Context& context)
+	{
+		for (const auto& stmt : stmts)
+		{
+			if ((*stmt)(context)) { return true; }
+		}
+		return false;
+	}
+
+	// where a declaration stores its value, always in the current scope
+	struct Target
+	{
+		bool global;
+		size_t index;
+
+		void define(Context& context, object_t value) const
+		{
+			if (global)
+			{
+				GlobalTable::Global& g = context.engine.globals[index];
+				g.value = std::move(value);
+				g.defined = true;
+			}
+			else
+			{
+				context.scope->slots[index] = std::move(value);
+			}
+		}
+	};
+
+
+	// functions -------------------------------------------------------
+
+	struct FunctionProto
+	{
+		std::shared_ptr<Stmt::Function> declaration;
+		size_t scopeSize = 0; // zero when the function scope is never created
+		std::vector<StmtPtr> body;
+	};
+
+	class CompiledFunction final : public LoxFunction
+	{
+	public:
+		CompiledFunction(std::shared_ptr<const FunctionProto> proto, std::shared_ptr<Scope> closure, ClosureEngine& engine, const bool isInitializer) :
+			LoxFunction(proto->declaration, nullptr, isInitializer),
+			m_proto(std::move(proto)),
+			m_scope(std::move(closure)),
+			m_engine(engine)
+		{}
+
+		std::shared_ptr<LoxFunction> bind(const LoxInstance& instance) const override
+		{
+			auto scope = std::make_shared<Scope>(m_scope, 1);
+			scope->slots[0] = instance.getShared();
+			return newShared<CompiledFunction>(m_proto, std::move(scope), m_engine, isInitializer());
+		}
+
+		// the closure engine has no tree-walking interpreter, so the parameter is unused
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			Context context{ m_engine, m_scope, {} };
+			if (m_proto->scopeSize > 0)
+			{
+				context.scope = std::make_shared<Scope>(m_scope, m_proto->scopeSize);
+				std::copy(arguments.begin(), arguments.end(), context.scope->slots.begin());
+			}
+
+			Execute(m_proto->body, context);
+
+			if (isInitializer()) { return m_scope->slots[0]; }
+			return std::move(context.returnValue);
+		}
+
+	private:
+		std::shared_ptr<const FunctionProto> m_proto;
+		std::shared_ptr<Scope> m_scope;
+		ClosureEngine& m_engine;
+	};
+
+
+	// expressions -----------------------------------------------------
+
+	struct Constant final : ExprNode
+	{
+		explicit Constant(object_t value) : ExprNode(&eval), value(std::move(value)) {}
+
+		static object_t eval(const ExprNode& node, Context&)
+		{
+			return static_cast<const Constant&>(node).value;
+		}
+
+		object_t value;
+	};
+
+	struct Local final : ExprNode
+	{
+		Local(const size_t hops, const size_t slot) : ExprNode(hops == 0 ? &evalCurrent : &eval), hops(hops), slot(slot) {}
+
+		static object_t evalCurrent(const ExprNode& node, Context& context)
+		{
+			return context.scope->slots[static_cast<const Local&>(node).slot];
+		}
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& local = static_cast<const Local&>(node);
+			return Ancestor(context, local.hops).slots[local.slot];
+		}
+
+		size_t hops;
+		size_t slot;
+	};
+
+	struct GlobalVariable final : ExprNode
+	{
+		GlobalVariable(const size_t index, Token name) : ExprNode(&eval), index(index), name(std::move(name)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& global = static_cast<const GlobalVariable&>(node);
+			const GlobalTable::Global& g = context.engine.globals[global.index];
+			if (!g.defined) { throw RuntimeError(global.name, "Undefined variable '" + std::string(global.name.lexeme) + "'."); }
+			return g.value;
+		}
+
+		size_t index;
+		Token name;
+	};
+
+	struct AssignLocal final : ExprNode
+	{
+		AssignLocal(const size_t hops, const size_t slot, ExprPtr value) : ExprNode(&eval), hops(hops), slot(slot), value(std::move(value)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& assign = static_cast<const AssignLocal&>(node);
+			object_t value = (*assign.value)(context);
+			Ancestor(context, assign.hops).slots[assign.slot] = value;
+			return value;
+		}
+
+		size_t hops;
+		size_t slot;
+		ExprPtr value;
+	};
+
+	struct AssignGlobal final : ExprNode
+	{
+		AssignGlobal(const size_t index, Token name, ExprPtr value) : ExprNode(&eval), index(index), name(std::move(name)), value(std::move(value)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& assign = static_cast<const AssignGlobal&>(node);
+			object_t value = (*assign.value)(context);
+
+			GlobalTable::Global& g = context.engine.globals[assign.index];
+			if (!g.defined) { throw RuntimeError(assign.name, "Undefined variable '" + std::string(assign.name.lexeme) + "'."); }
+			g.value = value;
+			return value;
+		}
+
+		size_t index;
+		Token name;
+		ExprPtr value;
+	};
+
+	struct Binary final : ExprNode
+	{
+		Binary(const Fn fn, ExprPtr left, Token op, ExprPtr right) : ExprNode(fn), left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
+
+		// comparisons and arithmetic on numbers
+		template <typename Op>
+		static object_t evalNumbers(const ExprNode& node, Context& context)
+		{
+			const auto& binary = static_cast<const Binary&>(node);
+			const object_t left = (*binary.left)(context);
+			const object_t right = (*binary.right)(context);
+			CheckNumberOperands(binary.op, left, right);
+			return Op()(as<double>(left), as<double>(right));
+		}
+
+		static object_t evalAdd(const ExprNode& node, Context& context)
+		{
+			const auto& binary = static_cast<const Binary&>(node);
+			const object_t left = (*binary.left)(context);
+			const object_t right = (*binary.right)(context);
+
+			if (is<double>(left) && is<double>(right))
+			{
+				return as<double>(left) + as<double>(right);
+			}
+			if (is<std::string>(left) && is<std::string>(right))
+			{
+				return as<std::string>(left) + as<std::string>(right);
+			}
+			throw RuntimeError(binary.op, "Operands must be two numbers or two strings.");
+		}
+
+		template <bool Equal>
+		static object_t evalEquality(const ExprNode& node, Context& context)
+		{
+			const auto& binary = static_cast<const Binary&>(node);
+			const object_t left = (*binary.left)(context);
+			const object_t right = (*binary.right)(context);
+			return IsEqual(left, right) == Equal;
+		}
+
+		ExprPtr left;
+		Token op;
+		ExprPtr right;
+	};
+
+	struct Logical final : ExprNode
+	{
+		Logical(const bool isOr, ExprPtr left, ExprPtr right) : ExprNode(isOr ? &evalOr : &evalAnd), left(std::move(left)), right(std::move(right)) {}
+
+		static object_t evalOr(const ExprNode& node, Context& context)
+		{
+			const auto& logical = static_cast<const Logical&>(node);
+			object_t left = (*logical.left)(context);
+			if (IsTruthy(left)) { return left; }
+			return (*logical.right)(context);
+		}
+		static object_t evalAnd(const ExprNode& node, Context& context)
+		{
+			const auto& logical = static_cast<const Logical&>(node);
+			object_t left = (*logical.left)(context);
+			if (!IsTruthy(left)) { return left; }
+			return (*logical.right)(context);
+		}
+
+		ExprPtr left;
+		ExprPtr right;
+	};
+
+	struct Unary final : ExprNode
+	{
+		Unary(const Fn fn, Token op, ExprPtr right) : ExprNode(fn), op(std::move(op)), right(std::move(right)) {}
+
+		static object_t evalNegate(const ExprNode& node, Context& context)
+		{
+			const auto& unary = static_cast<const Unary&>(node);
+			const object_t right = (*unary.right)(context);
+			CheckNumberOperand(unary.op, right);
+			return -as<double>(right);
+		}
+		static object_t evalNot(const ExprNode& node, Context& context)
+		{
+			const auto& unary = static_cast<const Unary&>(node);
+			return !IsTruthy((*unary.right)(context));
+		}
+
+		Token op;
+		ExprPtr right;
+	};
+
+	struct Call final : ExprNode
+	{
+		Call(ExprPtr callee, Token paren, std::vector<ExprPtr> arguments) : ExprNode(&eval), callee(std::move(callee)), paren(std::move(paren)), arguments(std::move(arguments)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& call = static_cast<const Call&>(node);
+			const object_t callee = (*call.callee)(context);
+
+			std::vector<object_t> arguments;
+			arguments.reserve(call.arguments.size());
+			for (const auto& arg : call.arguments)
+			{
+				arguments.push_back((*arg)(context));
+			}
+
+			return CallValue(nullptr, call.paren, callee, arguments);
+		}
+
+		ExprPtr callee;
+		Token paren;
+		std::vector<ExprPtr> arguments;
+	};
+
+	struct Get final : ExprNode
+	{
+		Get(ExprPtr object, Token name) : ExprNode(&eval), object(std::move(object)), name(std::move(name)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& get = static_cast<const Get&>(node);
+			const object_t object = (*get.object)(context);
+			if (is<std::shared_ptr<LoxInstance>>(object))
+			{
+				return as<std::shared_ptr<LoxInstance>>(object)->get(get.name);
+			}
+
+			throw RuntimeError(get.name, "Only instances have properties.");
+		}
+
+		ExprPtr object;
+		Token name;
+	};
+
+	struct Set final : ExprNode
+	{
+		Set(ExprPtr object, Token name, ExprPtr value) : ExprNode(&eval), object(std::move(object)), name(std::move(name)), value(std::move(value)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& set = static_cast<const Set&>(node);
+			const object_t instance = (*set.object)(context);
+
+			if (!is<std::shared_ptr<LoxInstance>>(instance))
+			{
+				throw RuntimeError(set.name, "Only instances have fields.");
+			}
+
+			object_t value = (*set.value)(context);
+			as<std::shared_ptr<LoxInstance>>(instance)->set(set.name, value);
+			return value;
+		}
+
+		ExprPtr object;
+		Token name;
+		ExprPtr value;
+	};
+
+	struct Super final : ExprNode
+	{
+		// "this" is always bound in the scope right below "super"
+		Super(const size_t hops, Token method) : ExprNode(&eval), hops(hops), method(std::move(method)) {}
+
+		static object_t eval(const ExprNode& node, Context& context)
+		{
+			const auto& super = static_cast<const Super&>(node);
+
+			const auto superclass = as<std::shared_ptr<LoxClass>>(Ancestor(context, super.hops).slots[0]);
+			const auto method = superclass->findMethod(super.method.lexeme);
+
+			if (!method)
+			{
+				throw RuntimeError(super.method, "Undefined property '" + std::string(super.method.lexeme) + "'.");
+			}
+
+			const auto instance = as<std::shared_ptr<LoxInstance>>(Ancestor(context, super.hops - 1).slots[0]);
+			return method->bind(*instance);
+		}
+
+		size_t hops;
+		Token method;
+	};
+
+
+	// statements ------------------------------------------------------
+
+	struct Expression final : StmtNode
+	{
+		explicit Expression(ExprPtr expression) : StmtNode(&exec), expression(std::move(expression)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			(*static_cast<const Expression&>(node).expression)(context);
+			return false;
+		}
+
+		ExprPtr expression;
+	};
+
+	struct Print final : StmtNode
+	{
+		explicit Print(ExprPtr expression) : StmtNode(&exec), expression(std::move(expression)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const object_t value = (*static_cast<const Print&>(node).expression)(context);
+			context.engine.out.print(value);
+			return false;
+		}
+
+		ExprPtr expression;
+	};
+
+	struct Var final : StmtNode
+	{
+		Var(const Target target, ExprPtr initializer) : StmtNode(&exec), target(target), initializer(std::move(initializer)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& var = static_cast<const Var&>(node);
+			object_t value = {};
+			if (var.initializer != nullptr)
+			{
+				value = (*var.initializer)(context);
+			}
+			var.target.define(context, std::move(value));
+			return false;
+		}
+
+		Target target;
+		ExprPtr initializer;
+	};
+
+	struct Block final : StmtNode
+	{
+		Block(const size_t scopeSize, std::vector<StmtPtr> statements) : StmtNode(scopeSize == 0 ? &execInline : &exec), scopeSize(scopeSize), statements(std::move(statements)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& block = static_cast<const Block&>(node);
+			ScopeGuard guard(context, std::make_shared<Scope>(context.scope, block.scopeSize));
+			return Execute(block.statements, context);
+		}
+		static bool execInline(const StmtNode& node, Context& context)
+		{
+			return Execute(static_cast<const Block&>(node).statements, context);
+		}
+
+		size_t scopeSize;
+		std::vector<StmtPtr> statements;
+	};
+
+	struct If final : StmtNode
+	{
+		If(ExprPtr condition, StmtPtr thenBranch, StmtPtr elseBranch) : StmtNode(&exec), condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& stmt = static_cast<const If&>(node);
+			if (IsTruthy((*stmt.condition)(context)))
+			{
+				return (*stmt.thenBranch)(context);
+			}
+			if (stmt.elseBranch != nullptr)
+			{
+				return (*stmt.elseBranch)(context);
+			}
+			return false;
+		}
+
+		ExprPtr condition;
+		StmtPtr thenBranch;
+		StmtPtr elseBranch;
+	};
+
+	struct While final : StmtNode
+	{
+		While(ExprPtr condition, StmtPtr body) : StmtNode(&exec), condition(std::move(condition)), body(std::move(body)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& stmt = static_cast<const While&>(node);
+			while (IsTruthy((*stmt.condition)(context)))
+			{
+				if ((*stmt.body)(context)) { return true; }
+			}
+			return false;
+		}
+
+		ExprPtr condition;
+		StmtPtr body;
+	};
+
+	struct Return final : StmtNode
+	{
+		explicit Return(ExprPtr value) : StmtNode(&exec), value(std::move(value)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& stmt = static_cast<const Return&>(node);
+			context.returnValue = stmt.value != nullptr ? (*stmt.value)(context) : object_t();
+			return true;
+		}
+
+		ExprPtr value;
+	};
+
+	struct Function final : StmtNode
+	{
+		Function(const Target target, std::shared_ptr<const FunctionProto> proto) : StmtNode(&exec), target(target), proto(std::move(proto)) {}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& function = static_cast<const Function&>(node);
+			std::shared_ptr<LoxCallable> callable = newShared<CompiledFunction>(function.proto, context.scope, context.engine, false);
+			function.target.define(context, std::move(callable));
+			return false;
+		}
+
+		Target target;
+		std::shared_ptr<const FunctionProto> proto;
+	};
+
+	struct Class final : StmtNode
+	{
+		Class(const Target target, Token name, ExprPtr superclass, Token superclassName, std::vector<std::shared_ptr<const FunctionProto>> methods) :
+			StmtNode(&exec),
+			target(target),
+			name(std::move(name)),
+			superclass(std::move(superclass)),
+			superclassName(std::move(superclassName)),
+			methods(std::move(methods))
+		{}
+
+		static bool exec(const StmtNode& node, Context& context)
+		{
+			const auto& stmt = static_cast<const Class&>(node);
+
+			std::shared_ptr<LoxClass> superclass = nullptr;
+			if (stmt.superclass != nullptr)
+			{
+				const object_t sc = (*stmt.superclass)(context);
+				if (!is<std::shared_ptr<LoxClass>>(sc))
+				{
+					throw RuntimeError(stmt.superclassName, "Superclass must be a class.");
+				}
+				superclass = as<std::shared_ptr<LoxClass>>(sc);
+			}
+
+			stmt.target.define(context, {});
+
+			// the methods close over a scope that holds "super"
+			std::shared_ptr<Scope> closure = context.scope;
+			if (superclass != nullptr)
+			{
+				closure = std::make_shared<Scope>(std::move(closure), 1);
+				closure->slots[0] = superclass;
+			}
+
+			StringMap<std::shared_ptr<LoxFunction>> methods;
+			for (const auto& method : stmt.methods)
+			{
+				const std::string_view methodName = method->declaration->name.lexeme;
+				methods.insert_or_assign(std::string(methodName), newShared<CompiledFunction>(method, closure, context.engine, methodName == "init"));
+			}
+
+			stmt.target.define(context, newShared<LoxClass>(std::string(stmt.name.lexeme), std::move(superclass), std::move(methods)));
+			return false;
+		}
+
+		Target target;
+		Token name;
+		ExprPtr superclass;
+		Token superclassName;
+		std::vector<std::shared_ptr<const FunctionProto>> methods;
+	};
+
+
+	// compiler --------------------------------------------------------
+
+	ExprNode::Fn BinaryFn(const Token& op)
+	{
+		switch (op.type)
+		{
+		case GREATER: return &Binary::evalNumbers<std::greater<>>;
+		case GREATER_EQUAL: return &Binary::evalNumbers<std::greater_equal<>>;
+		case LESS: return &Binary::evalNumbers<std::less<>>;
+		case LESS_EQUAL: return &Binary::evalNumbers<std::less_equal<>>;
+		case BANG_EQUAL: return &Binary::evalEquality<false>;
+		case EQUAL_EQUAL: return &Binary::evalEquality<true>;
+		case MINUS: return &Binary::evalNumbers<std::minus<>>;
+		case PLUS: return &Binary::evalAdd;
+		case SLASH: return &Binary::evalNumbers<std::divides<>>;
+		case STAR: return &Binary::evalNumbers<std::multiplies<>>;
+		default:
+			throw RuntimeError(op, "Unknown binary operator.");
+		}
+	}
+
+	// returns true if the statements declare a variable directly in their scope
+	bool DeclaresVariables(const std::vector<std::shared_ptr<Stmt>>& stmts)
+	{
+		return std::ranges::any_of(stmts, [](const std::shared_ptr<Stmt>& stmt)
+		{
+			return dynamic_cast<Stmt::Var*>(stmt.get()) || dynamic_cast<Stmt::Function*>(stmt.get()) || dynamic_cast<Stmt::Class*>(stmt.get());
+		});
+	}
+
+	// mirrors the scopes of the resolver to turn its depths into slots
+	class Compiler final : public Stmt::Visitor, public Expr::Visitor
+	{
+	public:
+		Compiler(ClosureEngine& engine, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) : m_engine(engine), m_locals(locals)
+		{}
+
+		template <typename T>
+		ExprPtr compile(const std::shared_ptr<T>& expr) requires std::is_base_of_v<Expr, T>
+		{
+			expr->accept(this);
+			return std::move(m_expr);
+		}
+
+		StmtPtr compile(const std::shared_ptr<Stmt>& stmt)
+		{
+			stmt->accept(this);
+			return std::move(m_stmt);
+		}
+
+		std::vector<StmtPtr> compile(const std::vector<std::shared_ptr<Stmt>>& stmts)
+		{
+			std::vector<StmtPtr> nodes;
+			nodes.reserve(stmts.size());
+			for (const auto& stmt : stmts)
+			{
+				nodes.push_back(compile(stmt));
+			}
+			return nodes;
+		}
+
+#define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
+		STMT_TYPES;
+#undef TYPE
+#define TYPE(name, ...) object_t visit ## name ## Expr(Expr::name& expr) override;
+		EXPR_TYPES;
+#undef TYPE
+
+	private:
+		struct CompileScope
+		{
+			std::unordered_map<std::string_view, size_t> slots;
+			bool materialized;
+		};
+
+		struct Slot
+		{
+			size_t hops;
+			size_t index;
+		};
+
+		Target declare(std::string_view name);
+		std::optional<Slot> resolve(Expr& expr, std::string_view name) const;
+		std::optional<Slot> resolve(std::optional<size_t> depth, std::string_view name) const;
+		ExprPtr variable(const Token& name, std::optional<size_t> depth) const;
+		ExprPtr assignment(const Token& name, std::optional<size_t> depth, ExprPtr value) const;
+		std::shared_ptr<const FunctionProto> compileFunction(Stmt::Function& function);
+
+		ClosureEngine& m_engine;
+		const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+		std::vector<CompileScope> m_scopes;
+
+		ExprPtr m_expr = nullptr;
+		StmtPtr m_stmt = nullptr;
+	};
+
+
+	Target Compiler::declare(const std::string_view name)
+	{
+		if (m_scopes.empty())
+		{
+			return { true, m_engine.globals.index(name) };
+		}
+
+		CompileScope& scope = m_scopes.back();
+		const size_t index = scope.slots.size();
+		scope.slots.insert_or_assign(name, index);
+		return { false, index };
+	}
+
+	std::optional<Compiler::Slot> Compiler::resolve(Expr& expr, const std::string_view name) const
+	{
+		const auto it = m_locals.find(expr.getShared());
+		if (it == m_locals.end()) { return std::nullopt; }
+
+		return resolve(it->second, name);
+	}
+
+	std::optional<Compiler::Slot> Compiler::resolve(const std::optional<size_t> depth, const std::string_view name) const
+	{
+		if (!depth) { return std::nullopt; }
+
+		// count the scopes that will exist at runtime between here and the declaration
+		const size_t declaration = m_scopes.size() - 1 - *depth;
+		size_t hops = 0;
+		for (size_t i = declaration + 1; i < m_scopes.size(); i++)
+		{
+			if (m_scopes[i].materialized) { hops++; }
+		}
+
+		return Slot{ hops, m_scopes[declaration].slots.at(name) };
+	}
+
+	ExprPtr Compiler::variable(const Token& name, const std::optional<size_t> depth) const
+	{
+		if (const auto slot = resolve(depth, name.lexeme))
+		{
+			return std::make_unique<Local>(slot->hops, slot->index);
+		}
+		return std::make_unique<GlobalVariable>(m_engine.globals.index(name.lexeme), name);
+	}
+
+	ExprPtr Compiler::assignment(const Token& name, const std::optional<size_t> depth, ExprPtr value) const
+	{
+		if (const auto slot = resolve(depth, name.lexeme))
+		{
+			return std::make_unique<AssignLocal>(slot->hops, slot->index, std::move(value));
+		}
+		return std::make_unique<AssignGlobal>(m_engine.globals.index(name.lexeme), name, std::move(value));
+	}
+
+	std::shared_ptr<const FunctionProto> Compiler::compileFunction(Stmt::Function& function)
+	{
+		auto proto = std::make_shared<FunctionProto>();
+		proto->declaration = std::dynamic_pointer_cast<Stmt::Function>(function.getShared());
+
+		m_scopes.push_back({ {}, !function.params.empty() || DeclaresVariables(function.body) });
+		for (const auto& param : function.params)
+		{
+			declare(param.lexeme);
+		}
+
+		proto->body = compile(function.body);
+		if (m_scopes.back().materialized) { proto->scopeSize = m_scopes.back().slots.size(); }
+		m_scopes.pop_back();
+
+		return proto;
+	}
+
+
+	// statements ------------------------------------------------------
+
+	void Compiler::visitBlockStmt(Stmt::Block& stmt)
+	{
+		m_scopes.push_back({ {}, DeclaresVariables(stmt.statements) });
+		std::vector<StmtPtr> statements = compile(stmt.statements);
+		const size_t scopeSize = m_scopes.back().materialized ? m_scopes.back().slots.size() : 0;
+		m_scopes.pop_back();
+
+		m_stmt = std::make_unique<Block>(scopeSize, std::move(statements));
+	}
+
+	void Compiler::visitClassStmt(Stmt::Class& stmt)
+	{
+		const Target target = declare(stmt.name.lexeme);
+
+		ExprPtr superclass = nullptr;
+		Token superclassName = stmt.name;
+		if (stmt.superclass != nullptr)
+		{
+			superclass = compile(stmt.superclass);
+			superclassName = stmt.superclass->name;
+			m_scopes.push_back({ { { "super", 0 } }, true });
+		}
+		m_scopes.push_back({ { { "this", 0 } }, true });
+
+		std::vector<std::shared_ptr<const FunctionProto>> methods;
+		for (const auto& method : stmt.methods)
+		{
+			methods.push_back(compileFunction(*method));
+		}
+
+		m_scopes.pop_back();
+		if (stmt.superclass != nullptr) { m_scopes.pop_back(); }
+
+		m_stmt = std::make_unique<Class>(target, stmt.name, std::move(superclass), std::move(superclassName), std::move(methods));
+	}
+
+	void Compiler::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+	{
+		// compiles to the loop it was specialized from
+		m_scopes.push_back({ {}, true });
+		StmtPtr variable = compile(stmt.variable);
+		ExprPtr condition = compile(stmt.condition);
+
+		m_scopes.push_back({ {}, false });
+		std::vector<StmtPtr> iteration;
+		iteration.push_back(compile(stmt.body));
+		iteration.push_back(std::make_unique<Expression>(compile(stmt.increment)));
+		m_scopes.pop_back();
+
+		std::vector<StmtPtr> statements;
+		statements.push_back(std::move(variable));
+		statements.push_back(std::make_unique<While>(std::move(condition), std::make_unique<Block>(0, std::move(iteration))));
+		const size_t scopeSize = m_scopes.back().slots.size();
+		m_scopes.pop_back();
+
+		m_stmt = std::make_unique<Block>(scopeSize, std::move(statements));
+	}
+
+	void Compiler::visitExpressionStmt(Stmt::Expression& stmt)
+	{
+		m_stmt = std::make_unique<Expression>(compile(stmt.expression));
+	}
+
+	void Compiler::visitFunctionStmt(Stmt::Function& stmt)
+	{
+		// declared before the body is compiled, so the function can refer to itself
+		const Target target = declare(stmt.name.lexeme);
+		m_stmt = std::make_unique<Function>(target, compileFunction(stmt));
+	}
+
+	void Compiler::visitIfStmt(Stmt::If& stmt)
+	{
+		ExprPtr condition = compile(stmt.condition);
+		StmtPtr thenBranch = compile(stmt.thenBranch);
+		StmtPtr elseBranch = stmt.elseBranch != nullptr ? compile(stmt.elseBranch) : nullptr;
+		m_stmt = std::make_unique<If>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+	}
+
+	void Compiler::visitImportStmt(Stmt::Import&)
+	{
+		// imports are replaced by the statements of their modules before anything runs, see modules.h
+		m_stmt = std::make_unique<Block>(0, std::vector<StmtPtr>());
+	}
+
+	void Compiler::visitPrintStmt(Stmt::Print& stmt)
+	{
+		m_stmt = std::make_unique<Print>(compile(stmt.expression));
+	}
+
+	void Compiler::visitReturnStmt(Stmt::Return& stmt)
+	{
+		m_stmt = std::make_unique<Return>(stmt.value != nullptr ? compile(stmt.value) : nullptr);
+	}
+
+	void Compiler::visitVarStmt(Stmt::Var& stmt)
+	{
+		const Target target = declare(stmt.name.lexeme);
+		m_stmt = std::make_unique<Var>(target, stmt.initializer != nullptr ? compile(stmt.initializer) : nullptr);
+	}
+
+	void Compiler::visitWhileStmt(Stmt::While& stmt)
+	{
+		ExprPtr condition = compile(stmt.condition);
+		m_stmt = std::make_unique<While>(std::move(condition), compile(stmt.body));
+	}
+
+
+	// expressions -----------------------------------------------------
+
+	object_t Compiler::visitAssignExpr(Expr::Assign& expr)
+	{
+		ExprPtr value = compile(expr.value);
+
+		const auto it = m_locals.find(expr.getShared());
+		m_expr = assignment(expr.name, it != m_locals.end() ? std::optional(it->second) : std::nullopt, std::move(value));
+		return {};
+	}
+
+	object_t Compiler::visitBinaryExpr(Expr::Binary& expr)
+	{
+		ExprPtr left = compile(expr.left);
+		m_expr = std::make_unique<Binary>(BinaryFn(expr.op), std::move(left), expr.op, compile(expr.right));
+		return {};
+	}
+
+	object_t Compiler::visitCallExpr(Expr::Call& expr)
+	{
+		ExprPtr callee = compile(expr.callee);
+
+		std::vector<ExprPtr> arguments;
+		arguments.reserve(expr.arguments.size());
+		for (const auto& arg : expr.arguments)
+		{
+			arguments.push_back(compile(arg));
+		}
+
+		m_expr = std::make_unique<Call>(std::move(callee), expr.paren, std::move(arguments));
+		return {};
+	}
+
+	object_t Compiler::visitGetExpr(Expr::Get& expr)
+	{
+		m_expr = std::make_unique<Get>(compile(expr.object), expr.name);
+		return {};
+	}
+
+	object_t Compiler::visitGroupingExpr(Expr::Grouping& expr)
+	{
+		// groupings only matter to the parser
+		m_expr = compile(expr.expression);
+		return {};
+	}
+
+	object_t Compiler::visitLiteralExpr(Expr::Literal& expr)
+	{
+		m_expr = std::make_unique<Constant>(expr.value);
+		return {};
+	}
+
+	object_t Compiler::visitLogicalExpr(Expr::Logical& expr)
+	{
+		ExprPtr left = compile(expr.left);
+		m_expr = std::make_unique<Logical>(expr.op.type == OR, std::move(left), compile(expr.right));
+		return {};
+	}
+
+	object_t Compiler::visitSetExpr(Expr::Set& expr)
+	{
+		ExprPtr object = compile(expr.object);
+		m_expr = std::make_unique<Set>(std::move(object), expr.name, compile(expr.value));
+		return {};
+	}
+
+	object_t Compiler::visitSuperExpr(Expr::Super& expr)
+	{
+		const auto slot = resolve(expr, "super");
+		m_expr = std::make_unique<Super>(slot->hops, expr.method);
+		return {};
+	}
+
+	object_t Compiler::visitThisExpr(Expr::This& expr)
+	{
+		const auto slot = resolve(expr, "this");
+		m_expr = std::make_unique<Local>(slot->hops, slot->index);
+		return {};
+	}
+
+	object_t Compiler::visitUnaryExpr(Expr::Unary& expr)
+	{
+		const ExprNode::Fn fn = expr.op.type == MINUS ? &Unary::evalNegate : &Unary::evalNot;
+		m_expr = std::make_unique<Unary>(fn, expr.op, compile(expr.right));
+		return {};
+	}
+
+	object_t Compiler::visitVariableExpr(Expr::Variable& expr)
+	{
+		const auto it = m_locals.find(expr.getShared());
+		m_expr = variable(expr.name, it != m_locals.end() ? std::optional(it->second) : std::nullopt);
+		return {};
+	}
+
+
+	// fused nodes compile to the shapes they were fused from -----------
+
+	object_t Compiler::visitCompareConstantExpr(Expr::CompareConstant& expr)
+	{
+		m_expr = std::make_unique<Binary>(BinaryFn(expr.op), variable(expr.name, expr.depth), expr.op, std::make_unique<Constant>(expr.constant));
+		return {};
+	}
+
+	object_t Compiler::visitGetChainExpr(Expr::GetChain& expr)
+	{
+		ExprPtr object = compile(expr.object);
+		for (const Token& name : expr.names)
+		{
+			object = std::make_unique<Get>(std::move(object), name);
+		}
+		m_expr = std::move(object);
+		return {};
+	}
+
+	object_t Compiler::visitIncrementExpr(Expr::Increment& expr)
+	{
+		ExprPtr value = std::make_unique<Binary>(BinaryFn(expr.op), variable(expr.name, expr.depth), expr.op, std::make_unique<Constant>(expr.amount));
+		m_expr = assignment(expr.name, expr.depth, std::move(value));
+		return {};
+	}
+
+	object_t Compiler::visitNilCheckExpr(Expr::NilCheck& expr)
+	{
+		m_expr = std::make_unique<Binary>(BinaryFn(expr.op), compile(expr.operand), expr.op, std::make_unique<Constant>(object_t()));
+		return {};
+	}
+
+	object_t Compiler::visitSetThisExpr(Expr::SetThis& expr)
+	{
+		const auto slot = resolve(expr.depth, "this");
+		ExprPtr object = std::make_unique<Local>(slot->hops, slot->index);
+		m_expr = std::make_unique<Set>(std::move(object), expr.name, compile(expr.value));
+		return {};
+	}
+}
+
+
+ClosureEngine::ClosureEngine(OutputSink& output) : out(output)
+{}
+
+void ClosureEngine::interpret(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals)
+{
+	Compiler compiler(*this, locals);
+	const std::vector<StmtPtr> program = compiler.compile(statements);
+
+	Context context{ *this, nullptr, {} };
+	Execute(program, context);
+}
@@ -0,0 +1,132 @@
+#include "countedLoop.h"
+
+#include <string_view>
+#include <unordered_set>
+
+
+namespace
+{
+	template <typename T>
+	std::shared_ptr<T> As(const std::shared_ptr<Expr>& expr)
+	{
+		return std::dynamic_pointer_cast<T>(expr);
+	}
+
+	template <typename T>
+	std::shared_ptr<T> As(const std::shared_ptr<Stmt>& stmt)
+	{
+		return std::dynamic_pointer_cast<T>(stmt);
+	}
+
+	bool IsNumberLiteral(const std::shared_ptr<Expr>& expr)
+	{
+		const auto literal = As<Expr::Literal>(expr);
+		return literal != nullptr && is<double>(literal->value);
+	}
+
+	// collects the names a loop body assigns, and the names used inside the functions it declares
+	class NameUses final : public AstRewriter
+	{
+	public:
+		bool assigns(const std::string_view name) const { return m_assigned.contains(name); }
+		bool captures(const std::string_view name) const { return m_captured.contains(name); }
+
+		void visitClassStmt(Stmt::Class& stmt) override
+		{
+			m_functionDepth++;
+			AstRewriter::visitClassStmt(stmt);
+			m_functionDepth--;
+		}
+
+		void visitFunctionStmt(Stmt::Function& stmt) override
+		{
+			m_functionDepth++;
+			AstRewriter::visitFunctionStmt(stmt);
+			m_functionDepth--;
+		}
+
+	private:
+		std::shared_ptr<Expr> transform(const std::shared_ptr<Expr>& expr) override
+		{
+			if (const auto assign = As<Expr::Assign>(expr))
+			{
+				m_assigned.insert(assign->name.lexeme);
+				if (m_functionDepth > 0) { m_captured.insert(assign->name.lexeme); }
+			}
+			else if (const auto variable = As<Expr::Variable>(expr); variable != nullptr && m_functionDepth > 0)
+			{
+				m_captured.insert(variable->name.lexeme);
+			}
+			return nullptr;
+		}
+
+		std::unordered_set<std::string_view> m_assigned;
+		std::unordered_set<std::string_view> m_captured;
+		size_t m_functionDepth = 0;
+	};
+}
+
+
+CountedLoopPass::CountedLoopPass(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) : m_locals(locals)
+{}
+
+bool CountedLoopPass::refersTo(const std::shared_ptr<Expr>& expr, const std::string_view name, const size_t depth) const
+{
+	const auto variable = As<Expr::Variable>(expr);
+	if (variable == nullptr || variable->name.lexeme != name) return false;
+
+	const auto it = m_locals.find(expr);
+	return it != m_locals.end() && it->second == depth;
+}
+
+std::shared_ptr<Stmt> CountedLoopPass::transform(const std::shared_ptr<Stmt>& stmt)
+{
+	// { var i = a; while (i < n) { body; i = i + c; } }
+	const auto block = As<Stmt::Block>(stmt);
+	if (block == nullptr || block->statements.size() != 2) return nullptr;
+
+	const auto variable = As<Stmt::Var>(block->statements[0]);
+	const auto loop = As<Stmt::While>(block->statements[1]);
+	if (variable == nullptr || variable->initializer == nullptr || loop == nullptr) return nullptr;
+	const std::string_view name = variable->name.lexeme;
+
+	const auto condition = As<Expr::Binary>(loop->condition);
+	if (condition == nullptr || !refersTo(condition->left, name, 0)) return nullptr;
+	switch (condition->op.type)
+	{
+	case GREATER:
+	case GREATER_EQUAL:
+	case LESS:
+	case LESS_EQUAL:
+		break;
+	default:
+		return nullptr;
+	}
+
+	const auto bound = As<Expr::Variable>(condition->right);
+	if (bound == nullptr && !IsNumberLiteral(condition->right)) return nullptr;
+	if (bound != nullptr && bound->name.lexeme == name) return nullptr;
+
+	const auto iteration = As<Stmt::Block>(loop->body);
+	if (iteration == nullptr || iteration->statements.size() != 2) return nullptr;
+
+	const auto increment = As<Stmt::Expression>(iteration->statements[1]);
+	const auto assign = increment != nullptr ? As<Expr::Assign>(increment->expression) : nullptr;
+	if (assign == nullptr || assign->name.lexeme != name) return nullptr;
+
+	const auto it = m_locals.find(assign);
+	if (it == m_locals.end() || it->second != 1) return nullptr;
+
+	const auto step = As<Expr::Binary>(assign->value);
+	if (step == nullptr || (step->op.type != PLUS && step->op.type != MINUS) || !refersTo(step->left, name, 1) || !IsNumberLiteral(step->right)) return nullptr;
+
+	const std::shared_ptr<Stmt>& body = iteration->statements[0];
+	NameUses uses;
+	std::shared_ptr<Stmt> walked = body;
+	uses.rewrite(walked);
+	if (uses.assigns(name) || uses.captures(name)) return nullptr;
+	if (bound != nullptr && uses.assigns(bound->name.lexeme)) return nullptr;
+
+	const double amount = as<double>(As<Expr::Literal>(step->right)->value);
+	return newShared<Stmt::CountedLoop>(variable, condition, body, assign, step->op.type == PLUS ? amount : -amount);
+}
@@ -2,7 +2,6 @@
 
 #include <iostream>
 
-#include "lox.h"
 #include "RuntimeError.h"
 
 Environment::Environment(std::shared_ptr<Environment> enclosing): m_enclosing(std::move(enclosing))
@@ -24,20 +23,20 @@ object_t Environment::get(const Token& name)
 	if (m_enclosing != nullptr)
 	{ return m_enclosing->get(name); }
 
-	throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
+	throw RuntimeError(name, "Undefined variable '" + std::string(name.lexeme) + "'.");
 }
 
-object_t Environment::getAt(const size_t distance, const std::string& name)
+object_t Environment::getAt(const size_t distance, const std::string_view name)
 {
-	return ancestor(distance).m_values.at(name);
+	return ancestor(distance).m_values.find(name)->second;
 }
 
 void Environment::assign(const Token& name, object_t value)
 {
 	// try and assign in the current scope
-	if (m_values.contains(name.lexeme))
+	if (const auto it = m_values.find(name.lexeme); it != m_values.end())
 	{
-		m_values.at(name.lexeme) = std::move(value);
+		it->second = std::move(value);
 		return;
 	}
 
@@ -48,16 +47,34 @@ void Environment::assign(const Token& name, object_t value)
 		return;
 	}
 
-	throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
+	throw RuntimeError(name, "Undefined variable '" + std::string(name.lexeme) + "'.");
 }
 void Environment::assignAt(const size_t distance, const Token& name, object_t value)
 {
-	ancestor(distance).m_values.insert_or_assign(name.lexeme, std::move(value));
+	ancestor(distance).define(name.lexeme, std::move(value));
 }
 
-void Environment::define(const std::string& name, object_t value)
+void Environment::define(const std::string_view name, object_t value)
 {
-	m_values.insert_or_assign(name, std::move(value));
+	// only build the key when the variable is new
+	if (const auto it = m_values.find(name); it != m_values.end())
+	{
+		it->second = std::move(value);
+		return;
+	}
+	m_values.emplace(name, std::move(value));
+}
+
+object_t& Environment::slot(const std::string_view name)
+{
+	return m_values.find(name)->second;
+}
+
+void Environment::clear()
+{
+	// moved out first, destroying the values may run destructors that look into this environment
+	StringMap<object_t> values = std::move(m_values);
+	m_values.clear();
 }
 
 
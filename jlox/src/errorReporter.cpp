@@ -0,0 +1,42 @@
+#include "errorReporter.h"
+
+#include "token.h"
+
+
+ErrorReporter::ErrorReporter(std::ostream& out) : m_out(out)
+{}
+
+ErrorReporter::ErrorReporter(ErrorReporter& parent, std::string module) :
+	m_parent(&parent),
+	m_out(parent.m_out),
+	m_module(std::move(module))
+{}
+
+void ErrorReporter::error(const Token& token, const std::string& message)
+{
+	if (token.type == END_OF_FILE)
+	{
+		report(token.line, " at end", message);
+	}
+	else
+	{
+		report(token.line, " at '" + std::string(token.lexeme) + "'", message);
+	}
+}
+
+void ErrorReporter::error(const size_t line, const std::string& message)
+{
+	report(line, "", message);
+}
+
+void ErrorReporter::report(const size_t line, const std::string& where, const std::string& message)
+{
+	ErrorReporter& root = m_parent != nullptr ? *m_parent : *this;
+	{
+		std::lock_guard lock(root.m_mutex);
+		m_out << "[" << m_module << (m_module.empty() ? "" : " ") << "line " << line << "] Error" << where << ": " << message << "\n";
+	}
+
+	m_hadError = true;
+	root.m_hadError = true;
+}
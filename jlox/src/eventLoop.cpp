@@ -0,0 +1,268 @@
+#include "eventLoop.h"
+
+#include <algorithm>
+#include <climits>
+#include <thread>
+
+#include "interpreter.h"
+#include "loxClass.h"
+#include "loxFunction.h"
+#include "RuntimeError.h"
+#include "source.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+#else
+#include <iostream>
+#endif
+
+
+EventLoop::EventLoop()
+{
+#if defined(__linux__)
+	m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	m_inputPollable = m_epoll != -1;
+#endif
+}
+
+EventLoop::~EventLoop()
+{
+#if defined(__linux__)
+	if (m_epoll != -1) { close(m_epoll); }
+#endif
+}
+
+void EventLoop::post(Task task)
+{
+	m_ready.push_back(std::move(task));
+}
+
+void EventLoop::after(const Clock::duration delay, Task task)
+{
+	// the clock moved on since the delay was clamped
+	const Clock::time_point now = Clock::now();
+	const Clock::time_point due = delay < Clock::time_point::max() - now ? now + delay : Clock::time_point::max();
+	m_timers.emplace(std::pair(due, m_timersAdded++), std::move(task));
+}
+
+void EventLoop::readLine(std::function<void(std::optional<std::string>)> task)
+{
+	m_lineReaders.push_back(std::move(task));
+}
+
+void EventLoop::run()
+{
+	while (true)
+	{
+		if (runDue()) { continue; }
+		if (m_ready.empty() && m_timers.empty() && m_lineReaders.empty()) { return; }
+
+		std::optional<Clock::time_point> deadline;
+		if (!m_timers.empty()) { deadline = m_timers.begin()->first.first; }
+
+		if (!m_lineReaders.empty()) { waitForInput(deadline); }
+		else { std::this_thread::sleep_until(*deadline); }
+	}
+}
+
+void EventLoop::clear()
+{
+	m_ready.clear();
+	m_timers.clear();
+	m_lineReaders.clear();
+}
+
+bool EventLoop::runDue()
+{
+	bool ran = false;
+
+	// the tasks these post wait for the next turn
+	std::deque<Task> ready = std::move(m_ready);
+	m_ready.clear();
+	for (Task& task : ready)
+	{
+		ran = true;
+		task();
+	}
+
+	const Clock::time_point now = Clock::now();
+	while (!m_timers.empty() && m_timers.begin()->first.first <= now)
+	{
+		Task task = std::move(m_timers.begin()->second);
+		m_timers.erase(m_timers.begin());
+		ran = true;
+		task();
+	}
+
+	while (!m_lineReaders.empty())
+	{
+		std::optional<std::string> line;
+		if (const size_t end = m_input.find('\n'); end != std::string::npos)
+		{
+			line = m_input.substr(0, end);
+			m_input.erase(0, end + 1);
+		}
+		else if (!m_inputEnded) { break; }
+		else if (!m_input.empty())
+		{
+			// the last line has no line break
+			line = std::move(m_input);
+			m_input.clear();
+		}
+
+		if (line.has_value() && !line->empty() && line->back() == '\r') { line->pop_back(); }
+
+		auto reader = std::move(m_lineReaders.front());
+		m_lineReaders.pop_front();
+		ran = true;
+		reader(std::move(line));
+	}
+
+	return ran;
+}
+
+void EventLoop::waitForInput([[maybe_unused]] const std::optional<Clock::time_point> deadline)
+{
+#if defined(__linux__)
+	if (m_inputPollable && !m_inputWatched)
+	{
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = STDIN_FILENO;
+		m_inputWatched = epoll_ctl(m_epoll, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0;
+		m_inputPollable = m_inputWatched;
+	}
+
+	if (m_inputPollable)
+	{
+		int timeout = -1;
+		if (deadline.has_value())
+		{
+			// rounded up, so the timer has expired when the wait times out
+			const auto left = std::chrono::ceil<std::chrono::milliseconds>(*deadline - Clock::now()).count();
+			timeout = static_cast<int>(std::clamp<decltype(left)>(left, 0, INT_MAX));
+		}
+
+		epoll_event event{};
+		if (epoll_wait(m_epoll, &event, 1, timeout) <= 0) { return; }
+	}
+
+	// only read when there is something to read, or the end, so this does not block on a terminal or a pipe
+	char buffer[64 * 1024];
+	const ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+	if (count > 0) { m_input.append(buffer, static_cast<size_t>(count)); }
+	else if (count == 0 || errno != EINTR) { m_inputEnded = true; }
+#else
+	std::string line;
+	if (std::getline(std::cin, line))
+	{
+		m_input += line;
+		m_input += '\n';
+	}
+	else
+	{
+		m_inputEnded = true;
+	}
+#endif
+}
+
+
+// built-in functions
+
+namespace
+{
+	EventLoop& Available(const Interpreter* interpreter)
+	{
+		if (interpreter == nullptr || interpreter->events == nullptr)
+		{
+			throw NativeError("Async functions need the main thread of the tree-walking interpreter.");
+		}
+		return *interpreter->events;
+	}
+
+	// the function or class to call back, with the number of arguments it will be called with
+	std::shared_ptr<LoxCallable> Callback(const object_t& value, const size_t arity)
+	{
+		std::shared_ptr<LoxCallable> callable = nullptr;
+		if (is<std::shared_ptr<LoxCallable>>(value)) { callable = as<std::shared_ptr<LoxCallable>>(value); }
+		else if (is<std::shared_ptr<LoxFunction>>(value)) { callable = as<std::shared_ptr<LoxFunction>>(value); }
+		else if (is<std::shared_ptr<LoxClass>>(value)) { callable = as<std::shared_ptr<LoxClass>>(value); }
+
+		if (callable == nullptr || callable->arity() != arity)
+		{
+			throw NativeError("Expected a function that takes " + std::to_string(arity) + (arity == 1 ? " argument." : " arguments."));
+		}
+		return callable;
+	}
+
+
+	class SleepFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override
+		{
+			EventLoop& events = Available(interpreter);
+			const double milliseconds = is<double>(arguments[0]) ? as<double>(arguments[0]) : -1;
+			if (!(milliseconds >= 0)) { throw NativeError("Expected a number of milliseconds."); } // NaN as well
+
+			// a longer delay would overflow the clock and fire early, this one never fires
+			const auto longest = EventLoop::Clock::time_point::max() - EventLoop::Clock::now();
+			const std::chrono::duration<double, std::milli> delay(milliseconds);
+			events.after(delay < longest ? std::chrono::duration_cast<EventLoop::Clock::duration>(delay) : longest,
+				[interpreter, callback = Callback(arguments[1], 0)] { callback->call(interpreter, {}); });
+			return {};
+		}
+		size_t arity() const override { return 2; }
+	};
+
+	class ReadFileAsyncFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override
+		{
+			EventLoop& events = Available(interpreter);
+			if (!is<std::string>(arguments[0])) { throw NativeError("Expected a path."); }
+
+			events.post([interpreter, path = as<std::string>(arguments[0]), callback = Callback(arguments[1], 1)]
+			{
+				// nil when the file cannot be read
+				object_t contents = {};
+				if (const auto source = Source::Load(path.c_str())) { contents = std::string(source->text()); }
+				callback->call(interpreter, { contents });
+			});
+			return {};
+		}
+		size_t arity() const override { return 2; }
+	};
+
+	class ReadLineAsyncFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override
+		{
+			EventLoop& events = Available(interpreter);
+
+			events.readLine([interpreter, callback = Callback(arguments[0], 1)](std::optional<std::string> line)
+			{
+				// nil at the end of the input
+				object_t value = {};
+				if (line.has_value()) { value = std::move(*line); }
+				callback->call(interpreter, { value });
+			});
+			return {};
+		}
+		size_t arity() const override { return 1; }
+	};
+}
+
+
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateAsyncNatives()
+{
+	return {
+		{ "sleep", newShared<SleepFunction>() },
+		{ "readFileAsync", newShared<ReadFileAsyncFunction>() },
+		{ "readLineAsync", newShared<ReadLineAsyncFunction>() }
+	};
+}
@@ -0,0 +1,230 @@
+#include "files.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "RuntimeError.h"
+#include "source.h"
+
+
+namespace
+{
+	constexpr size_t BLOCK = 64 * 1024;
+
+	// so a chunk always fits in memory
+	constexpr double MAX_CHUNK = 1 << 30;
+}
+
+
+const std::array<InputFile::Method, 0> InputFile::methods = {};
+
+InputFile::InputFile(const std::string& path) : m_buffer(BLOCK)
+{
+	// the blocks are read into the buffer here, a second one in the stream would only copy them once more
+	m_stream.rdbuf()->pubsetbuf(nullptr, 0);
+	m_stream.open(path, std::ios::binary);
+}
+
+std::optional<std::string> InputFile::readLine()
+{
+	std::lock_guard lock(m_lock);
+
+	// the characters before this were looked at already
+	size_t searched = m_begin;
+	while (true)
+	{
+		if (const auto* found = static_cast<const char*>(std::memchr(m_buffer.data() + searched, '\n', m_end - searched)))
+		{
+			const auto end = static_cast<size_t>(found - m_buffer.data());
+			std::string line(m_buffer.data() + m_begin, end - m_begin);
+			m_begin = end + 1;
+
+			if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+			return line;
+		}
+
+		searched = m_end - m_begin;
+		if (!fill())
+		{
+			// the last line has no line break
+			if (m_begin == m_end) { return std::nullopt; }
+
+			std::string line(m_buffer.data() + m_begin, m_end - m_begin);
+			m_begin = m_end;
+			return line;
+		}
+	}
+}
+
+std::optional<std::string> InputFile::readChunk(const size_t size)
+{
+	std::lock_guard lock(m_lock);
+
+	if (m_begin == m_end && !fill()) { return std::nullopt; }
+
+	// what is buffered, and then the rest straight into the chunk
+	const size_t buffered = std::min(size, m_end - m_begin);
+	std::string chunk(m_buffer.data() + m_begin, buffered);
+	m_begin += buffered;
+
+	if (chunk.size() < size && !m_ended)
+	{
+		chunk.resize(size);
+		m_stream.read(&chunk[buffered], static_cast<std::streamsize>(size - buffered));
+		chunk.resize(buffered + static_cast<size_t>(m_stream.gcount()));
+		m_ended = !m_stream;
+	}
+	return chunk;
+}
+
+bool InputFile::fill()
+{
+	if (m_ended) { return false; }
+
+	std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+	m_end -= m_begin;
+	m_begin = 0;
+
+	// a line longer than the buffer
+	if (m_end == m_buffer.size()) { m_buffer.resize(m_buffer.size() * 2); }
+
+	m_stream.read(m_buffer.data() + m_end, static_cast<std::streamsize>(m_buffer.size() - m_end));
+	const auto count = static_cast<size_t>(m_stream.gcount());
+	m_end += count;
+	m_ended = !m_stream;
+	return count > 0;
+}
+
+
+// built-in functions
+
+namespace
+{
+	const std::string& Path(const object_t& value)
+	{
+		if (!is<std::string>(value)) { throw NativeError("Expected a path."); }
+		return std::get<std::string>(value);
+	}
+
+	InputFile& FileArgument(const object_t& value)
+	{
+		if (is<std::shared_ptr<LoxInstance>>(value))
+		{
+			if (auto* file = dynamic_cast<InputFile*>(as<std::shared_ptr<LoxInstance>>(value).get())) { return *file; }
+		}
+		throw NativeError("Expected a file.");
+	}
+
+	object_t StringOrNil(std::optional<std::string> text)
+	{
+		if (!text.has_value()) { return {}; }
+		return std::move(*text);
+	}
+
+	// the value as print writes it, false when the file could not be written
+	bool Write(const std::string& path, const std::ios::openmode mode, const object_t& value)
+	{
+		std::ofstream stream(path, std::ios::binary | mode);
+		if (!stream.is_open()) { return false; }
+
+		if (is<std::string>(value))
+		{
+			const std::string& text = std::get<std::string>(value);
+			stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+		}
+		else
+		{
+			const std::string text = toString(value);
+			stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+		}
+
+		stream.close();
+		return !stream.fail();
+	}
+
+
+	class OpenFileFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			auto file = newShared<InputFile>(Path(arguments[0]));
+			if (!file->isOpen()) { return {}; }
+			return std::shared_ptr<LoxInstance>(file);
+		}
+		size_t arity() const override { return 1; }
+	};
+
+	class ReadLineFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			return StringOrNil(FileArgument(arguments[0]).readLine());
+		}
+		size_t arity() const override { return 1; }
+	};
+
+	class ReadChunkFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			InputFile& file = FileArgument(arguments[0]);
+
+			const double size = is<double>(arguments[1]) ? as<double>(arguments[1]) : 0;
+			if (size < 1 || size > MAX_CHUNK || size != std::floor(size))
+			{
+				throw NativeError("Expected a whole number of characters from 1 to 2^30.");
+			}
+			return StringOrNil(file.readChunk(static_cast<size_t>(size)));
+		}
+		size_t arity() const override { return 2; }
+	};
+
+	class ReadFileFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			const auto source = Source::Load(Path(arguments[0]).c_str());
+			if (source == nullptr) { return {}; }
+			return std::string(source->text());
+		}
+		size_t arity() const override { return 1; }
+	};
+
+	class WriteFileFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			return Write(Path(arguments[0]), std::ios::trunc, arguments[1]);
+		}
+		size_t arity() const override { return 2; }
+	};
+
+	class AppendFileFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			return Write(Path(arguments[0]), std::ios::app, arguments[1]);
+		}
+		size_t arity() const override { return 2; }
+	};
+}
+
+
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateFileNatives()
+{
+	return {
+		{ "openFile", newShared<OpenFileFunction>() },
+		{ "readLine", newShared<ReadLineFunction>() },
+		{ "readChunk", newShared<ReadChunkFunction>() },
+		{ "readFile", newShared<ReadFileFunction>() },
+		{ "writeFile", newShared<WriteFileFunction>() },
+		{ "appendFile", newShared<AppendFileFunction>() }
+	};
+}
@@ -0,0 +1,472 @@
+#include "flatAst.h"
+
+#include <algorithm>
+#include <optional>
+
+
+namespace
+{
+	constexpr uint32_t NONE = FlatTree::NONE;
+
+	// returns true if the statements declare a variable directly in their scope
+	bool DeclaresVariables(const std::vector<std::shared_ptr<Stmt>>& stmts)
+	{
+		return std::ranges::any_of(stmts, [](const std::shared_ptr<Stmt>& stmt)
+		{
+			return dynamic_cast<Stmt::Var*>(stmt.get()) || dynamic_cast<Stmt::Function*>(stmt.get()) || dynamic_cast<Stmt::Class*>(stmt.get());
+		});
+	}
+
+	FlatKind BinaryKind(const TokenType op)
+	{
+		switch (op)
+		{
+		case PLUS: return FlatKind::ADD;
+		case MINUS: return FlatKind::SUBTRACT;
+		case STAR: return FlatKind::MULTIPLY;
+		case SLASH: return FlatKind::DIVIDE;
+		case GREATER: return FlatKind::GREATER;
+		case GREATER_EQUAL: return FlatKind::GREATER_EQUAL;
+		case LESS: return FlatKind::LESS;
+		case LESS_EQUAL: return FlatKind::LESS_EQUAL;
+		case EQUAL_EQUAL: return FlatKind::EQUAL;
+		default: return FlatKind::NOT_EQUAL;
+		}
+	}
+
+	// mirrors the scopes of the resolver to turn its depths into slots, the same way the closure engine does
+	class Converter final : public Stmt::Visitor, public Expr::Visitor
+	{
+	public:
+		Converter(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, const std::function<uint32_t(std::string_view)>& globalIndex) :
+			m_tree(std::make_shared<FlatTree>()),
+			m_locals(locals),
+			m_globalIndex(globalIndex)
+		{}
+
+		std::shared_ptr<FlatTree> convert(const std::vector<std::shared_ptr<Stmt>>& statements)
+		{
+			m_tree->program = statementList(statements);
+			return std::move(m_tree);
+		}
+
+#define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
+		STMT_TYPES;
+#undef TYPE
+#define TYPE(name, ...) object_t visit ## name ## Expr(Expr::name& expr) override;
+		EXPR_TYPES;
+#undef TYPE
+
+	private:
+		struct Scope
+		{
+			std::unordered_map<std::string_view, uint32_t> slots;
+			bool materialized;
+		};
+
+		struct Target
+		{
+			bool global;
+			uint32_t index;
+		};
+
+		struct Slot
+		{
+			uint32_t hops;
+			uint32_t index;
+		};
+
+		template <typename T>
+		uint32_t convert(const std::shared_ptr<T>& node)
+		{
+			node->accept(this);
+			return m_node;
+		}
+
+		uint32_t add(const FlatKind kind, const uint32_t a = 0, const uint32_t b = 0, const uint32_t c = 0, const bool global = false)
+		{
+			m_tree->nodes.push_back({ kind, global, a, b, c });
+			return static_cast<uint32_t>(m_tree->nodes.size() - 1);
+		}
+
+		uint32_t list(const std::vector<uint32_t>& elements)
+		{
+			const auto index = static_cast<uint32_t>(m_tree->lists.size());
+			m_tree->lists.push_back(static_cast<uint32_t>(elements.size()));
+			m_tree->lists.insert(m_tree->lists.end(), elements.begin(), elements.end());
+			return index;
+		}
+
+		uint32_t statementList(const std::vector<std::shared_ptr<Stmt>>& stmts)
+		{
+			std::vector<uint32_t> elements;
+			elements.reserve(stmts.size());
+			for (const auto& stmt : stmts)
+			{
+				elements.push_back(convert(stmt));
+			}
+			return list(elements);
+		}
+
+		uint32_t token(const Token& token)
+		{
+			m_tree->tokens.push_back(token);
+			return static_cast<uint32_t>(m_tree->tokens.size() - 1);
+		}
+
+		uint32_t constant(const object_t& value)
+		{
+			m_tree->constants.push_back(value);
+			return add(FlatKind::CONSTANT, static_cast<uint32_t>(m_tree->constants.size() - 1));
+		}
+
+		std::optional<size_t> depthOf(const Expr& expr) const
+		{
+			if (const auto it = m_locals.find(expr.getShared()); it != m_locals.end()) { return it->second; }
+			return std::nullopt;
+		}
+
+		Target declare(std::string_view name);
+		std::optional<Slot> resolve(std::optional<size_t> depth, std::string_view name) const;
+		uint32_t variable(const Token& name, std::optional<size_t> depth);
+		uint32_t assignment(const Token& name, std::optional<size_t> depth, uint32_t value);
+		uint32_t binary(const Token& op, uint32_t left, uint32_t right);
+		uint32_t function(Stmt::Function& function);
+
+		std::shared_ptr<FlatTree> m_tree;
+		const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+		const std::function<uint32_t(std::string_view)>& m_globalIndex;
+		std::vector<Scope> m_scopes;
+
+		uint32_t m_node = NONE;
+	};
+
+
+	Converter::Target Converter::declare(const std::string_view name)
+	{
+		if (m_scopes.empty())
+		{
+			return { true, m_globalIndex(name) };
+		}
+
+		Scope& scope = m_scopes.back();
+		const auto index = static_cast<uint32_t>(scope.slots.size());
+		scope.slots.insert_or_assign(name, index);
+		return { false, index };
+	}
+
+	std::optional<Converter::Slot> Converter::resolve(const std::optional<size_t> depth, const std::string_view name) const
+	{
+		if (!depth) { return std::nullopt; }
+
+		// count the scopes that will exist at runtime between here and the declaration
+		const size_t declaration = m_scopes.size() - 1 - *depth;
+		uint32_t hops = 0;
+		for (size_t i = declaration + 1; i < m_scopes.size(); i++)
+		{
+			if (m_scopes[i].materialized) { hops++; }
+		}
+
+		return Slot{ hops, m_scopes[declaration].slots.at(name) };
+	}
+
+	uint32_t Converter::variable(const Token& name, const std::optional<size_t> depth)
+	{
+		if (const auto slot = resolve(depth, name.lexeme))
+		{
+			return add(FlatKind::LOCAL, slot->hops, slot->index);
+		}
+		return add(FlatKind::GLOBAL, m_globalIndex(name.lexeme), token(name));
+	}
+
+	uint32_t Converter::assignment(const Token& name, const std::optional<size_t> depth, const uint32_t value)
+	{
+		if (const auto slot = resolve(depth, name.lexeme))
+		{
+			return add(FlatKind::ASSIGN_LOCAL, slot->hops, slot->index, value);
+		}
+		return add(FlatKind::ASSIGN_GLOBAL, m_globalIndex(name.lexeme), token(name), value);
+	}
+
+	uint32_t Converter::binary(const Token& op, const uint32_t left, const uint32_t right)
+	{
+		return add(BinaryKind(op.type), left, right, token(op));
+	}
+
+	uint32_t Converter::function(Stmt::Function& function)
+	{
+		m_scopes.push_back({ {}, !function.params.empty() || DeclaresVariables(function.body) });
+		for (const auto& param : function.params)
+		{
+			declare(param.lexeme);
+		}
+
+		FlatFunction flat;
+		flat.declaration = std::dynamic_pointer_cast<Stmt::Function>(function.getShared());
+		flat.body = statementList(function.body);
+		if (m_scopes.back().materialized) { flat.scopeSize = static_cast<uint32_t>(m_scopes.back().slots.size()); }
+		m_scopes.pop_back();
+
+		m_tree->functions.push_back(std::move(flat));
+		return static_cast<uint32_t>(m_tree->functions.size() - 1);
+	}
+
+
+	// statements ------------------------------------------------------
+
+	void Converter::visitBlockStmt(Stmt::Block& stmt)
+	{
+		m_scopes.push_back({ {}, DeclaresVariables(stmt.statements) });
+		const uint32_t statements = statementList(stmt.statements);
+		const uint32_t scopeSize = m_scopes.back().materialized ? static_cast<uint32_t>(m_scopes.back().slots.size()) : 0;
+		m_scopes.pop_back();
+
+		m_node = add(FlatKind::BLOCK, statements, scopeSize);
+	}
+
+	void Converter::visitClassStmt(Stmt::Class& stmt)
+	{
+		const Target target = declare(stmt.name.lexeme);
+
+		FlatClass flat;
+		flat.name = token(stmt.name);
+		flat.superclass = NONE;
+		flat.superclassName = flat.name;
+		if (stmt.superclass != nullptr)
+		{
+			flat.superclass = convert(stmt.superclass);
+			flat.superclassName = token(stmt.superclass->name);
+			m_scopes.push_back({ { { "super", 0 } }, true });
+		}
+		m_scopes.push_back({ { { "this", 0 } }, true });
+
+		std::vector<uint32_t> methods;
+		for (const auto& method : stmt.methods)
+		{
+			methods.push_back(function(*method));
+		}
+		flat.methods = list(methods);
+
+		m_scopes.pop_back();
+		if (stmt.superclass != nullptr) { m_scopes.pop_back(); }
+
+		m_tree->classes.push_back(flat);
+		m_node = add(FlatKind::CLASS, target.index, static_cast<uint32_t>(m_tree->classes.size() - 1), 0, target.global);
+	}
+
+	void Converter::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+	{
+		// converts to the loop it was specialized from
+		m_scopes.push_back({ {}, true });
+		const uint32_t variable = convert(stmt.variable);
+		const uint32_t condition = convert(stmt.condition);
+
+		m_scopes.push_back({ {}, false });
+		const uint32_t body = convert(stmt.body);
+		const uint32_t increment = add(FlatKind::EXPRESSION, convert(stmt.increment));
+		const uint32_t iteration = add(FlatKind::BLOCK, list({ body, increment }), 0);
+		m_scopes.pop_back();
+
+		const uint32_t loop = add(FlatKind::WHILE, condition, iteration);
+		const auto scopeSize = static_cast<uint32_t>(m_scopes.back().slots.size());
+		m_scopes.pop_back();
+
+		m_node = add(FlatKind::BLOCK, list({ variable, loop }), scopeSize);
+	}
+
+	void Converter::visitExpressionStmt(Stmt::Expression& stmt)
+	{
+		m_node = add(FlatKind::EXPRESSION, convert(stmt.expression));
+	}
+
+	void Converter::visitFunctionStmt(Stmt::Function& stmt)
+	{
+		// declared before the body is converted, so the function can refer to itself
+		const Target target = declare(stmt.name.lexeme);
+		m_node = add(FlatKind::FUNCTION, target.index, function(stmt), 0, target.global);
+	}
+
+	void Converter::visitIfStmt(Stmt::If& stmt)
+	{
+		const uint32_t condition = convert(stmt.condition);
+		const uint32_t thenBranch = convert(stmt.thenBranch);
+		const uint32_t elseBranch = stmt.elseBranch != nullptr ? convert(stmt.elseBranch) : NONE;
+		m_node = add(FlatKind::IF, condition, thenBranch, elseBranch);
+	}
+
+	void Converter::visitImportStmt(Stmt::Import&)
+	{
+		// imports are replaced by the statements of their modules before anything runs, see modules.h
+		m_node = add(FlatKind::BLOCK, statementList({}), 0);
+	}
+
+	void Converter::visitPrintStmt(Stmt::Print& stmt)
+	{
+		m_node = add(FlatKind::PRINT, convert(stmt.expression));
+	}
+
+	void Converter::visitReturnStmt(Stmt::Return& stmt)
+	{
+		m_node = add(FlatKind::RETURN, stmt.value != nullptr ? convert(stmt.value) : NONE);
+	}
+
+	void Converter::visitVarStmt(Stmt::Var& stmt)
+	{
+		// the initializer can't see the variable, so it is converted first
+		const uint32_t initializer = stmt.initializer != nullptr ? convert(stmt.initializer) : NONE;
+		const Target target = declare(stmt.name.lexeme);
+		m_node = add(FlatKind::VAR, target.index, initializer, 0, target.global);
+	}
+
+	void Converter::visitWhileStmt(Stmt::While& stmt)
+	{
+		const uint32_t condition = convert(stmt.condition);
+		m_node = add(FlatKind::WHILE, condition, convert(stmt.body));
+	}
+
+
+	// expressions -----------------------------------------------------
+
+	object_t Converter::visitAssignExpr(Expr::Assign& expr)
+	{
+		const uint32_t value = convert(expr.value);
+		m_node = assignment(expr.name, depthOf(expr), value);
+		return {};
+	}
+
+	object_t Converter::visitBinaryExpr(Expr::Binary& expr)
+	{
+		const uint32_t left = convert(expr.left);
+		const uint32_t right = convert(expr.right);
+		m_node = binary(expr.op, left, right);
+		return {};
+	}
+
+	object_t Converter::visitCallExpr(Expr::Call& expr)
+	{
+		const uint32_t callee = convert(expr.callee);
+
+		std::vector<uint32_t> arguments;
+		arguments.reserve(expr.arguments.size());
+		for (const auto& arg : expr.arguments)
+		{
+			arguments.push_back(convert(arg));
+		}
+
+		m_node = add(FlatKind::CALL, callee, list(arguments), token(expr.paren));
+		return {};
+	}
+
+	object_t Converter::visitGetExpr(Expr::Get& expr)
+	{
+		m_node = add(FlatKind::GET, convert(expr.object), 0, token(expr.name));
+		return {};
+	}
+
+	object_t Converter::visitGroupingExpr(Expr::Grouping& expr)
+	{
+		m_node = convert(expr.expression);
+		return {};
+	}
+
+	object_t Converter::visitLiteralExpr(Expr::Literal& expr)
+	{
+		m_node = constant(expr.value);
+		return {};
+	}
+
+	object_t Converter::visitLogicalExpr(Expr::Logical& expr)
+	{
+		const uint32_t left = convert(expr.left);
+		const uint32_t right = convert(expr.right);
+		m_node = add(expr.op.type == OR ? FlatKind::OR : FlatKind::AND, left, right);
+		return {};
+	}
+
+	object_t Converter::visitSetExpr(Expr::Set& expr)
+	{
+		const uint32_t object = convert(expr.object);
+		const uint32_t value = convert(expr.value);
+		m_node = add(FlatKind::SET, object, value, token(expr.name));
+		return {};
+	}
+
+	object_t Converter::visitSuperExpr(Expr::Super& expr)
+	{
+		const auto slot = resolve(depthOf(expr), "super");
+		m_node = add(FlatKind::SUPER, slot->hops, 0, token(expr.method));
+		return {};
+	}
+
+	object_t Converter::visitThisExpr(Expr::This& expr)
+	{
+		const auto slot = resolve(depthOf(expr), "this");
+		m_node = add(FlatKind::LOCAL, slot->hops, slot->index);
+		return {};
+	}
+
+	object_t Converter::visitUnaryExpr(Expr::Unary& expr)
+	{
+		const uint32_t right = convert(expr.right);
+		m_node = expr.op.type == MINUS ? add(FlatKind::NEGATE, right, 0, token(expr.op)) : add(FlatKind::NOT, right);
+		return {};
+	}
+
+	object_t Converter::visitVariableExpr(Expr::Variable& expr)
+	{
+		m_node = variable(expr.name, depthOf(expr));
+		return {};
+	}
+
+
+	// fused nodes convert to the shapes they were fused from -----------
+
+	object_t Converter::visitCompareConstantExpr(Expr::CompareConstant& expr)
+	{
+		const uint32_t left = variable(expr.name, expr.depth);
+		m_node = binary(expr.op, left, constant(expr.constant));
+		return {};
+	}
+
+	object_t Converter::visitGetChainExpr(Expr::GetChain& expr)
+	{
+		uint32_t object = convert(expr.object);
+		for (const Token& name : expr.names)
+		{
+			object = add(FlatKind::GET, object, 0, token(name));
+		}
+		m_node = object;
+		return {};
+	}
+
+	object_t Converter::visitIncrementExpr(Expr::Increment& expr)
+	{
+		const uint32_t left = variable(expr.name, expr.depth);
+		const uint32_t value = binary(expr.op, left, constant(expr.amount));
+		m_node = assignment(expr.name, expr.depth, value);
+		return {};
+	}
+
+	object_t Converter::visitNilCheckExpr(Expr::NilCheck& expr)
+	{
+		const uint32_t operand = convert(expr.operand);
+		m_node = binary(expr.op, operand, constant(object_t()));
+		return {};
+	}
+
+	object_t Converter::visitSetThisExpr(Expr::SetThis& expr)
+	{
+		const auto slot = resolve(expr.depth, "this");
+		const uint32_t object = add(FlatKind::LOCAL, slot->hops, slot->index);
+		const uint32_t value = convert(expr.value);
+		m_node = add(FlatKind::SET, object, value, token(expr.name));
+		return {};
+	}
+}
+
+
+std::shared_ptr<const FlatTree> Flatten(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, const std::function<uint32_t(std::string_view)>& globalIndex)
+{
+	Converter converter(locals, globalIndex);
+	return converter.convert(statements);
+}
@@ -0,0 +1,447 @@
+#include "flatEngine.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "flatAst.h"
+#include "interpreter.h"
+#include "loxClass.h"
+#include "loxFunction.h"
+#include "loxInstance.h"
+#include "RuntimeError.h"
+
+// keeps a function out of its callers, whose frames would grow by its temporaries
+#if defined(_MSC_VER)
+#define FLAT_NOINLINE __declspec(noinline)
+#else
+#define FLAT_NOINLINE __attribute__((noinline))
+#endif
+
+
+namespace
+{
+	constexpr uint32_t NONE = FlatTree::NONE;
+
+	// how deep the calls of a program may take the stack before the next one is a runtime error, below the 8 MB the
+	// executable reserves, so deep recursion is reported instead of crashing
+	constexpr uintptr_t MAX_STACK = 7 * 1024 * 1024;
+
+	// the top of the stack the programs run on this thread started from
+	thread_local uintptr_t t_stackBase = 0;
+
+	// the variables of one scope, scopes that don't declare anything are never created
+	struct Scope
+	{
+		Scope(std::shared_ptr<Scope> enclosing, const size_t size) : enclosing(std::move(enclosing)), slots(size) {}
+
+		std::shared_ptr<Scope> enclosing;
+		std::vector<object_t> slots;
+	};
+
+	// evaluates the nodes of one tree, a new evaluator is created for every call
+	class Evaluator
+	{
+	public:
+		Evaluator(const std::shared_ptr<const FlatTree>& tree, FlatEngine& engine, std::shared_ptr<Scope> scope) : m_treeOwner(tree), m_tree(*tree), m_engine(engine), m_scope(std::move(scope)) {}
+
+		object_t evaluate(uint32_t index);
+
+		// returns true when a return statement was executed
+		bool execute(uint32_t index);
+		bool executeList(uint32_t list);
+
+		object_t returnValue;
+
+	private:
+		Scope& ancestor(uint32_t hops) const
+		{
+			Scope* scope = m_scope.get();
+			while (hops-- > 0) { scope = scope->enclosing.get(); }
+			return *scope;
+		}
+
+		void define(const FlatNode& node, object_t value)
+		{
+			if (node.global)
+			{
+				GlobalTable::Global& global = m_engine.globals[node.a];
+				global.value = std::move(value);
+				global.defined = true;
+			}
+			else
+			{
+				m_scope->slots[node.a] = std::move(value);
+			}
+		}
+
+		GlobalTable::Global& global(const FlatNode& node) const
+		{
+			GlobalTable::Global& global = m_engine.globals[node.a];
+			if (!global.defined) { undefined(node); }
+			return global;
+		}
+
+		[[noreturn]] FLAT_NOINLINE void undefined(const FlatNode& node) const
+		{
+			const Token& name = m_tree.tokens[node.b];
+			throw RuntimeError(name, "Undefined variable '" + std::string(name.lexeme) + "'.");
+		}
+
+		// kept out of evaluate, see there
+		FLAT_NOINLINE object_t assign(const FlatNode& node);
+		FLAT_NOINLINE object_t binary(const FlatNode& node);
+		FLAT_NOINLINE object_t concatenate(const FlatNode& node, const object_t& left, const object_t& right) const;
+		FLAT_NOINLINE object_t unary(const FlatNode& node);
+		FLAT_NOINLINE object_t property(const FlatNode& node);
+		FLAT_NOINLINE object_t call(const FlatNode& node);
+
+		// kept out of execute likewise
+		FLAT_NOINLINE bool block(const FlatNode& node);
+		FLAT_NOINLINE void defineFunction(const FlatNode& node);
+		FLAT_NOINLINE void defineClass(const FlatNode& node);
+
+		const std::shared_ptr<const FlatTree>& m_treeOwner; // functions created here keep the tree alive
+		const FlatTree& m_tree;
+		FlatEngine& m_engine;
+		std::shared_ptr<Scope> m_scope;
+	};
+
+	class FlatFunctionObject final : public LoxFunction
+	{
+	public:
+		FlatFunctionObject(std::shared_ptr<const FlatTree> tree, const uint32_t function, std::shared_ptr<Scope> closure, FlatEngine& engine, const bool isInitializer) :
+			LoxFunction(tree->functions[function].declaration, nullptr, isInitializer),
+			m_tree(std::move(tree)),
+			m_function(function),
+			m_scope(std::move(closure)),
+			m_engine(engine)
+		{}
+
+		std::shared_ptr<LoxFunction> bind(const LoxInstance& instance) const override
+		{
+			auto scope = std::make_shared<Scope>(m_scope, 1);
+			scope->slots[0] = instance.getShared();
+			return newShared<FlatFunctionObject>(m_tree, m_function, std::move(scope), m_engine, isInitializer());
+		}
+
+		// the flat engine has no tree-walking interpreter, so the parameter is unused
+		object_t call(Interpreter*, const std::vector<object_t>& arguments) const override
+		{
+			// the stack grows down
+			const char here = 0;
+			if (reinterpret_cast<uintptr_t>(&here) + MAX_STACK < t_stackBase) { throw NativeError("Stack overflow."); }
+
+			const FlatFunction& function = m_tree->functions[m_function];
+
+			std::shared_ptr<Scope> scope = m_scope;
+			if (function.scopeSize > 0)
+			{
+				scope = std::make_shared<Scope>(m_scope, function.scopeSize);
+				std::copy(arguments.begin(), arguments.end(), scope->slots.begin());
+			}
+
+			Evaluator evaluator(m_tree, m_engine, std::move(scope));
+			evaluator.executeList(function.body);
+
+			if (isInitializer()) { return m_scope->slots[0]; }
+			return std::move(evaluator.returnValue);
+		}
+
+	private:
+		std::shared_ptr<const FlatTree> m_tree;
+		uint32_t m_function;
+		std::shared_ptr<Scope> m_scope;
+		FlatEngine& m_engine;
+	};
+
+
+	// only the cases without temporaries of their own are handled here, the others are left to functions of their own,
+	// which keeps the frame of evaluate small: every call in Lox nests a few of them
+	object_t Evaluator::evaluate(const uint32_t index)
+	{
+		const FlatNode& node = m_tree.nodes[index];
+
+		switch (node.kind)
+		{
+		case FlatKind::CONSTANT:
+			return m_tree.constants[node.a];
+		case FlatKind::LOCAL:
+			return node.a == 0 ? m_scope->slots[node.b] : ancestor(node.a).slots[node.b];
+		case FlatKind::GLOBAL:
+			return global(node).value;
+		case FlatKind::ASSIGN_LOCAL:
+		case FlatKind::ASSIGN_GLOBAL:
+			return assign(node);
+
+		case FlatKind::ADD:
+		case FlatKind::SUBTRACT:
+		case FlatKind::MULTIPLY:
+		case FlatKind::DIVIDE:
+		case FlatKind::GREATER:
+		case FlatKind::GREATER_EQUAL:
+		case FlatKind::LESS:
+		case FlatKind::LESS_EQUAL:
+		case FlatKind::EQUAL:
+		case FlatKind::NOT_EQUAL:
+			return binary(node);
+
+		case FlatKind::AND:
+		case FlatKind::OR:
+		case FlatKind::NEGATE:
+		case FlatKind::NOT:
+			return unary(node);
+
+		case FlatKind::CALL:
+			return call(node);
+		case FlatKind::GET:
+		case FlatKind::SET:
+		case FlatKind::SUPER:
+			return property(node);
+
+		default:
+			return {};
+		}
+	}
+
+	object_t Evaluator::assign(const FlatNode& node)
+	{
+		object_t value = evaluate(node.c);
+		if (node.kind == FlatKind::ASSIGN_LOCAL) { ancestor(node.a).slots[node.b] = value; }
+		else { global(node).value = value; }
+		return value;
+	}
+
+	object_t Evaluator::binary(const FlatNode& node)
+	{
+		const object_t left = evaluate(node.a);
+		const object_t right = evaluate(node.b);
+
+		if (node.kind == FlatKind::ADD)
+		{
+			if (is<double>(left) && is<double>(right)) { return as<double>(left) + as<double>(right); }
+			return concatenate(node, left, right);
+		}
+		if (node.kind == FlatKind::EQUAL || node.kind == FlatKind::NOT_EQUAL)
+		{
+			return IsEqual(left, right) == (node.kind == FlatKind::EQUAL);
+		}
+
+		CheckNumberOperands(m_tree.tokens[node.c], left, right);
+		const double l = as<double>(left);
+		const double r = as<double>(right);
+		switch (node.kind)
+		{
+		case FlatKind::SUBTRACT: return l - r;
+		case FlatKind::MULTIPLY: return l * r;
+		case FlatKind::DIVIDE: return l / r;
+		case FlatKind::GREATER: return l > r;
+		case FlatKind::GREATER_EQUAL: return l >= r;
+		case FlatKind::LESS: return l < r;
+		default: return l <= r;
+		}
+	}
+
+	object_t Evaluator::concatenate(const FlatNode& node, const object_t& left, const object_t& right) const
+	{
+		if (is<std::string>(left) && is<std::string>(right)) { return as<std::string>(left) + as<std::string>(right); }
+		throw RuntimeError(m_tree.tokens[node.c], "Operands must be two numbers or two strings.");
+	}
+
+	object_t Evaluator::unary(const FlatNode& node)
+	{
+		object_t operand = evaluate(node.a);
+		switch (node.kind)
+		{
+		case FlatKind::AND:
+			if (!IsTruthy(operand)) { return operand; }
+			return evaluate(node.b);
+		case FlatKind::OR:
+			if (IsTruthy(operand)) { return operand; }
+			return evaluate(node.b);
+		case FlatKind::NEGATE:
+			CheckNumberOperand(m_tree.tokens[node.c], operand);
+			return -as<double>(operand);
+		default:
+			return !IsTruthy(operand);
+		}
+	}
+
+	object_t Evaluator::property(const FlatNode& node)
+	{
+		if (node.kind == FlatKind::SUPER)
+		{
+			// "this" is always bound in the scope right below "super"
+			const Token& name = m_tree.tokens[node.c];
+			const auto superclass = as<std::shared_ptr<LoxClass>>(ancestor(node.a).slots[0]);
+			const auto method = superclass->findMethod(name.lexeme);
+			if (!method)
+			{
+				throw RuntimeError(name, "Undefined property '" + std::string(name.lexeme) + "'.");
+			}
+
+			const auto instance = as<std::shared_ptr<LoxInstance>>(ancestor(node.a - 1).slots[0]);
+			return method->bind(*instance);
+		}
+
+		const object_t object = evaluate(node.a);
+		if (!is<std::shared_ptr<LoxInstance>>(object))
+		{
+			throw RuntimeError(m_tree.tokens[node.c], node.kind == FlatKind::GET ? "Only instances have properties." : "Only instances have fields.");
+		}
+		if (node.kind == FlatKind::GET)
+		{
+			return as<std::shared_ptr<LoxInstance>>(object)->get(m_tree.tokens[node.c]);
+		}
+
+		object_t value = evaluate(node.b);
+		as<std::shared_ptr<LoxInstance>>(object)->set(m_tree.tokens[node.c], value);
+		return value;
+	}
+
+	bool Evaluator::execute(const uint32_t index)
+	{
+		const FlatNode& node = m_tree.nodes[index];
+
+		switch (node.kind)
+		{
+		case FlatKind::EXPRESSION:
+			evaluate(node.a);
+			return false;
+		case FlatKind::PRINT:
+			m_engine.out.print(evaluate(node.a));
+			return false;
+		case FlatKind::VAR:
+			define(node, node.b != NONE ? evaluate(node.b) : object_t());
+			return false;
+		case FlatKind::BLOCK:
+			return block(node);
+		case FlatKind::IF:
+			if (IsTruthy(evaluate(node.a))) { return execute(node.b); }
+			if (node.c != NONE) { return execute(node.c); }
+			return false;
+		case FlatKind::WHILE:
+			while (IsTruthy(evaluate(node.a)))
+			{
+				if (execute(node.b)) { return true; }
+			}
+			return false;
+		case FlatKind::RETURN:
+			returnValue = node.a != NONE ? evaluate(node.a) : object_t();
+			return true;
+		case FlatKind::FUNCTION:
+			defineFunction(node);
+			return false;
+		case FlatKind::CLASS:
+			defineClass(node);
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	bool Evaluator::executeList(const uint32_t list)
+	{
+		const uint32_t* statements = m_tree.list(list);
+		const uint32_t length = m_tree.length(list);
+		for (uint32_t i = 0; i < length; i++)
+		{
+			if (execute(statements[i])) { return true; }
+		}
+		return false;
+	}
+
+	bool Evaluator::block(const FlatNode& node)
+	{
+		if (node.b == 0) { return executeList(node.a); }
+
+		// restores the current scope when the block is left, also when it is left through an exception
+		std::shared_ptr<Scope> previous = m_scope;
+		m_scope = std::make_shared<Scope>(previous, node.b);
+		try
+		{
+			const bool returned = executeList(node.a);
+			m_scope = std::move(previous);
+			return returned;
+		}
+		catch (...)
+		{
+			m_scope = std::move(previous);
+			throw;
+		}
+	}
+
+	object_t Evaluator::call(const FlatNode& node)
+	{
+		const object_t callee = evaluate(node.a);
+
+		const uint32_t* argumentNodes = m_tree.list(node.b);
+		const uint32_t count = m_tree.length(node.b);
+
+		std::vector<object_t> arguments;
+		arguments.reserve(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			arguments.push_back(evaluate(argumentNodes[i]));
+		}
+
+		return CallValue(nullptr, m_tree.tokens[node.c], callee, arguments);
+	}
+
+	void Evaluator::defineFunction(const FlatNode& node)
+	{
+		std::shared_ptr<LoxCallable> function = newShared<FlatFunctionObject>(m_treeOwner, node.b, m_scope, m_engine, false);
+		define(node, std::move(function));
+	}
+
+	void Evaluator::defineClass(const FlatNode& node)
+	{
+		const FlatClass& flat = m_tree.classes[node.b];
+		const Token& name = m_tree.tokens[flat.name];
+
+		std::shared_ptr<LoxClass> superclass = nullptr;
+		if (flat.superclass != NONE)
+		{
+			const object_t sc = evaluate(flat.superclass);
+			if (!is<std::shared_ptr<LoxClass>>(sc))
+			{
+				throw RuntimeError(m_tree.tokens[flat.superclassName], "Superclass must be a class.");
+			}
+			superclass = as<std::shared_ptr<LoxClass>>(sc);
+		}
+
+		define(node, {});
+
+		// the methods close over a scope that holds "super"
+		std::shared_ptr<Scope> closure = m_scope;
+		if (superclass != nullptr)
+		{
+			closure = std::make_shared<Scope>(std::move(closure), 1);
+			closure->slots[0] = superclass;
+		}
+
+		StringMap<std::shared_ptr<LoxFunction>> methods;
+		const uint32_t* functions = m_tree.list(flat.methods);
+		for (uint32_t i = 0; i < m_tree.length(flat.methods); i++)
+		{
+			const std::string_view methodName = m_tree.functions[functions[i]].declaration->name.lexeme;
+			methods.insert_or_assign(std::string(methodName), newShared<FlatFunctionObject>(m_treeOwner, functions[i], closure, m_engine, methodName == "init"));
+		}
+
+		define(node, newShared<LoxClass>(std::string(name.lexeme), std::move(superclass), std::move(methods)));
+	}
+}
+
+
+FlatEngine::FlatEngine(OutputSink& output) : out(output)
+{}
+
+void FlatEngine::interpret(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals)
+{
+	const char here = 0;
+	t_stackBase = std::max(t_stackBase, reinterpret_cast<uintptr_t>(&here));
+
+	const std::shared_ptr<const FlatTree> tree = Flatten(statements, locals, [this](const std::string_view name) { return globals.index(name); });
+
+	Evaluator evaluator(tree, *this, nullptr);
+	evaluator.executeList(tree->program);
+}
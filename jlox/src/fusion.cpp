@@ -0,0 +1,163 @@
+#include "fusion.h"
+
+#include <iomanip>
+
+
+namespace
+{
+	template <typename T>
+	T* As(const std::shared_ptr<Expr>& expr)
+	{
+		return dynamic_cast<T*>(expr.get());
+	}
+
+	bool IsNumberLiteral(const std::shared_ptr<Expr>& expr)
+	{
+		const auto* literal = As<Expr::Literal>(expr);
+		return literal != nullptr && is<double>(literal->value);
+	}
+
+	bool IsNilLiteral(const std::shared_ptr<Expr>& expr)
+	{
+		const auto* literal = As<Expr::Literal>(expr);
+		return literal != nullptr && IsNull(literal->value);
+	}
+
+	// x = x + c, x = x - c
+	std::shared_ptr<Expr> FuseIncrement(const FusionPass& pass, const std::shared_ptr<Expr>& expr)
+	{
+		const auto* assign = As<Expr::Assign>(expr);
+		if (assign == nullptr) return nullptr;
+
+		const auto* binary = As<Expr::Binary>(assign->value);
+		if (binary == nullptr || (binary->op.type != PLUS && binary->op.type != MINUS) || !IsNumberLiteral(binary->right)) return nullptr;
+
+		const auto* variable = As<Expr::Variable>(binary->left);
+		if (variable == nullptr || variable->name.lexeme != assign->name.lexeme) return nullptr;
+
+		// both have to refer to the same declaration
+		const std::optional<size_t> depth = pass.depthOf(expr);
+		if (depth != pass.depthOf(binary->left)) return nullptr;
+
+		const double amount = as<double>(As<Expr::Literal>(binary->right)->value);
+		return newShared<Expr::Increment>(assign->name, depth, binary->op, amount);
+	}
+
+	// x < c, x <= c, x > c, x >= c
+	std::shared_ptr<Expr> FuseCompareConstant(const FusionPass& pass, const std::shared_ptr<Expr>& expr)
+	{
+		const auto* binary = As<Expr::Binary>(expr);
+		if (binary == nullptr || !IsNumberLiteral(binary->right)) return nullptr;
+
+		switch (binary->op.type)
+		{
+		case LESS:
+		case LESS_EQUAL:
+		case GREATER:
+		case GREATER_EQUAL:
+			break;
+		default:
+			return nullptr;
+		}
+
+		const auto* variable = As<Expr::Variable>(binary->left);
+		if (variable == nullptr) return nullptr;
+
+		const double constant = as<double>(As<Expr::Literal>(binary->right)->value);
+		return newShared<Expr::CompareConstant>(variable->name, pass.depthOf(binary->left), binary->op, constant);
+	}
+
+	// this.x = value
+	std::shared_ptr<Expr> FuseSetThis(const FusionPass& pass, const std::shared_ptr<Expr>& expr)
+	{
+		const auto* set = As<Expr::Set>(expr);
+		if (set == nullptr) return nullptr;
+
+		const auto* self = As<Expr::This>(set->object);
+		if (self == nullptr) return nullptr;
+
+		const std::optional<size_t> depth = pass.depthOf(set->object);
+		if (!depth) return nullptr;
+
+		return newShared<Expr::SetThis>(self->keyword, *depth, set->name, set->value);
+	}
+
+	// a.b.c
+	std::shared_ptr<Expr> FuseGetChain(const FusionPass&, const std::shared_ptr<Expr>& expr)
+	{
+		const auto* get = As<Expr::Get>(expr);
+		if (get == nullptr) return nullptr;
+
+		// the inner gets have already been fused, extend their chain
+		if (const auto* chain = As<Expr::GetChain>(get->object))
+		{
+			std::vector<Token> names = chain->names;
+			names.push_back(get->name);
+			return newShared<Expr::GetChain>(chain->object, std::move(names));
+		}
+
+		if (const auto* inner = As<Expr::Get>(get->object))
+		{
+			return newShared<Expr::GetChain>(inner->object, std::vector<Token>{ inner->name, get->name });
+		}
+
+		return nullptr;
+	}
+
+	// x == nil, x != nil
+	std::shared_ptr<Expr> FuseNilCheck(const FusionPass&, const std::shared_ptr<Expr>& expr)
+	{
+		const auto* binary = As<Expr::Binary>(expr);
+		if (binary == nullptr || (binary->op.type != EQUAL_EQUAL && binary->op.type != BANG_EQUAL)) return nullptr;
+
+		if (IsNilLiteral(binary->right)) return newShared<Expr::NilCheck>(binary->left, binary->op);
+		if (IsNilLiteral(binary->left)) return newShared<Expr::NilCheck>(binary->right, binary->op);
+		return nullptr;
+	}
+}
+
+
+const std::array<FusionPass::Pattern, FusionPass::PATTERN_COUNT> FusionPass::patterns = { {
+	{ "x = x + c", &FuseIncrement },
+	{ "x < c", &FuseCompareConstant },
+	{ "this.x = v", &FuseSetThis },
+	{ "a.b.c", &FuseGetChain },
+	{ "x == nil", &FuseNilCheck },
+} };
+
+
+FusionPass::FusionPass(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, Statistics& statistics) :
+	m_locals(locals),
+	m_statistics(statistics)
+{}
+
+void FusionPass::PrintStatistics(std::ostream& out, const Statistics& statistics)
+{
+	out << std::left << std::setw(14) << "fusion" << std::right << std::setw(10) << "fused" << std::setw(14) << "hits" << "\n";
+	for (size_t i = 0; i < PATTERN_COUNT; i++)
+	{
+		out << std::left << std::setw(14) << patterns[i].shape << std::right << std::setw(10) << statistics.fused[i] << std::setw(14) << statistics.hits[i] << "\n";
+	}
+}
+
+std::optional<size_t> FusionPass::depthOf(const std::shared_ptr<Expr>& expr) const
+{
+	if (const auto it = m_locals.find(expr); it != m_locals.end())
+	{
+		return it->second;
+	}
+	return std::nullopt;
+}
+
+std::shared_ptr<Expr> FusionPass::transform(const std::shared_ptr<Expr>& expr)
+{
+	for (size_t i = 0; i < PATTERN_COUNT; i++)
+	{
+		if (std::shared_ptr<Expr> fused = patterns[i].fuse(*this, expr))
+		{
+			m_statistics.fused[i]++;
+			return fused;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,29 @@
+#include "globalTable.h"
+
+#include <utility>
+
+#include "natives.h"
+
+
+GlobalTable::GlobalTable()
+{
+	for (auto& [name, native] : CreateNatives())
+	{
+		Global& global = m_globals[index(name)];
+		global.value = std::move(native);
+		global.defined = true;
+	}
+}
+
+uint32_t GlobalTable::index(const std::string_view name)
+{
+	if (const auto it = m_indices.find(name); it != m_indices.end())
+	{
+		return it->second;
+	}
+
+	m_globals.push_back({ name, {}, false });
+	const auto index = static_cast<uint32_t>(m_globals.size() - 1);
+	m_indices.emplace(name, index);
+	return index;
+}
@@ -0,0 +1,405 @@
+#include "heapCopy.h"
+
+#include <typeinfo>
+
+#include "environment.h"
+#include "files.h"
+#include "interpreter.h"
+#include "loxArray.h"
+#include "loxClass.h"
+#include "loxFunction.h"
+#include "loxInstance.h"
+#include "loxMap.h"
+#include "threads.h"
+
+
+namespace
+{
+	// a copy of a syntax tree with fresh type feedback, nodes reached twice are copied once
+	class TreeCopy final : public Stmt::Visitor, public Expr::Visitor
+	{
+	public:
+		TreeCopy(const std::unordered_map<std::shared_ptr<Expr>, size_t>& from, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, std::unordered_map<const Stmt::Function*, std::shared_ptr<Stmt::Function>>& functions) :
+			m_from(from),
+			m_locals(locals),
+			m_functions(functions)
+		{}
+
+		std::shared_ptr<Stmt::Function> function(const std::shared_ptr<Stmt::Function>& function)
+		{
+			if (const auto it = m_functions.find(function.get()); it != m_functions.end()) { return it->second; }
+
+			auto copy = newShared<Stmt::Function>(function->name, function->params, statements(function->body));
+			m_functions.emplace(function.get(), copy);
+			return copy;
+		}
+
+#define TYPE(name, ...) void visit ## name ## Stmt(Stmt::name& stmt) override;
+		STMT_TYPES;
+#undef TYPE
+#define TYPE(name, ...) object_t visit ## name ## Expr(Expr::name& expr) override;
+		EXPR_TYPES;
+#undef TYPE
+
+	private:
+		const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_from;
+		std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+		std::unordered_map<const Stmt::Function*, std::shared_ptr<Stmt::Function>>& m_functions;
+
+		std::unordered_map<const Stmt*, std::shared_ptr<Stmt>> m_stmts;
+		std::unordered_map<const Expr*, std::shared_ptr<Expr>> m_exprs;
+
+		// the copy the last node visited made
+		std::shared_ptr<Stmt> m_stmt;
+		std::shared_ptr<Expr> m_expr;
+
+		std::shared_ptr<Stmt> stmt(const std::shared_ptr<Stmt>& statement)
+		{
+			if (statement == nullptr) { return nullptr; }
+			if (const auto it = m_stmts.find(statement.get()); it != m_stmts.end()) { return it->second; }
+
+			statement->accept(this);
+			m_stmts.emplace(statement.get(), m_stmt);
+			return std::move(m_stmt);
+		}
+
+		std::shared_ptr<Expr> expr(const std::shared_ptr<Expr>& expression)
+		{
+			if (expression == nullptr) { return nullptr; }
+			if (const auto it = m_exprs.find(expression.get()); it != m_exprs.end()) { return it->second; }
+
+			expression->accept(this);
+			if (const auto it = m_from.find(expression); it != m_from.end()) { m_locals.emplace(m_expr, it->second); }
+			m_exprs.emplace(expression.get(), m_expr);
+			return std::move(m_expr);
+		}
+
+		template <typename T>
+		std::shared_ptr<T> stmt(const std::shared_ptr<T>& statement)
+		{
+			return std::static_pointer_cast<T>(stmt(std::static_pointer_cast<Stmt>(statement)));
+		}
+
+		template <typename T>
+		std::shared_ptr<T> expr(const std::shared_ptr<T>& expression)
+		{
+			return std::static_pointer_cast<T>(expr(std::static_pointer_cast<Expr>(expression)));
+		}
+
+		std::vector<std::shared_ptr<Stmt>> statements(const std::vector<std::shared_ptr<Stmt>>& statements)
+		{
+			std::vector<std::shared_ptr<Stmt>> copies;
+			copies.reserve(statements.size());
+			for (const auto& statement : statements) { copies.push_back(stmt(statement)); }
+			return copies;
+		}
+	};
+
+
+	// statements
+
+	void TreeCopy::visitBlockStmt(Stmt::Block& stmt)
+	{
+		m_stmt = newShared<Stmt::Block>(statements(stmt.statements));
+	}
+
+	void TreeCopy::visitClassStmt(Stmt::Class& stmt)
+	{
+		std::vector<std::shared_ptr<Stmt::Function>> methods;
+		for (const auto& method : stmt.methods) { methods.push_back(function(method)); }
+		m_stmt = newShared<Stmt::Class>(stmt.name, expr(stmt.superclass), std::move(methods));
+	}
+
+	void TreeCopy::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+	{
+		auto variable = this->stmt(stmt.variable);
+		auto condition = expr(stmt.condition);
+		auto body = this->stmt(stmt.body);
+		m_stmt = newShared<Stmt::CountedLoop>(std::move(variable), std::move(condition), std::move(body), expr(stmt.increment), stmt.step);
+	}
+
+	void TreeCopy::visitExpressionStmt(Stmt::Expression& stmt)
+	{
+		m_stmt = newShared<Stmt::Expression>(expr(stmt.expression));
+	}
+
+	void TreeCopy::visitFunctionStmt(Stmt::Function& stmt)
+	{
+		m_stmt = function(std::static_pointer_cast<Stmt::Function>(stmt.getShared()));
+	}
+
+	void TreeCopy::visitIfStmt(Stmt::If& stmt)
+	{
+		auto condition = expr(stmt.condition);
+		auto thenBranch = this->stmt(stmt.thenBranch);
+		m_stmt = newShared<Stmt::If>(std::move(condition), std::move(thenBranch), this->stmt(stmt.elseBranch));
+	}
+
+	void TreeCopy::visitImportStmt(Stmt::Import& stmt)
+	{
+		m_stmt = newShared<Stmt::Import>(stmt.keyword, stmt.path);
+	}
+
+	void TreeCopy::visitPrintStmt(Stmt::Print& stmt)
+	{
+		m_stmt = newShared<Stmt::Print>(expr(stmt.expression));
+	}
+
+	void TreeCopy::visitReturnStmt(Stmt::Return& stmt)
+	{
+		m_stmt = newShared<Stmt::Return>(stmt.keyword, expr(stmt.value));
+	}
+
+	void TreeCopy::visitVarStmt(Stmt::Var& stmt)
+	{
+		m_stmt = newShared<Stmt::Var>(stmt.name, expr(stmt.initializer));
+	}
+
+	void TreeCopy::visitWhileStmt(Stmt::While& stmt)
+	{
+		auto condition = expr(stmt.condition);
+		m_stmt = newShared<Stmt::While>(std::move(condition), this->stmt(stmt.body));
+	}
+
+
+	// expressions
+
+	object_t TreeCopy::visitAssignExpr(Expr::Assign& expr)
+	{
+		m_expr = newShared<Expr::Assign>(expr.name, this->expr(expr.value));
+		return {};
+	}
+
+	object_t TreeCopy::visitBinaryExpr(Expr::Binary& expr)
+	{
+		auto left = this->expr(expr.left);
+		m_expr = newShared<Expr::Binary>(std::move(left), expr.op, this->expr(expr.right));
+		return {};
+	}
+
+	object_t TreeCopy::visitCallExpr(Expr::Call& expr)
+	{
+		auto callee = this->expr(expr.callee);
+		std::vector<std::shared_ptr<Expr>> arguments;
+		arguments.reserve(expr.arguments.size());
+		for (const auto& argument : expr.arguments) { arguments.push_back(this->expr(argument)); }
+		m_expr = newShared<Expr::Call>(std::move(callee), expr.paren, std::move(arguments));
+		return {};
+	}
+
+	object_t TreeCopy::visitCompareConstantExpr(Expr::CompareConstant& expr)
+	{
+		m_expr = newShared<Expr::CompareConstant>(expr.name, expr.depth, expr.op, expr.constant);
+		return {};
+	}
+
+	object_t TreeCopy::visitGetExpr(Expr::Get& expr)
+	{
+		m_expr = newShared<Expr::Get>(this->expr(expr.object), expr.name);
+		return {};
+	}
+
+	object_t TreeCopy::visitGetChainExpr(Expr::GetChain& expr)
+	{
+		m_expr = newShared<Expr::GetChain>(this->expr(expr.object), expr.names);
+		return {};
+	}
+
+	object_t TreeCopy::visitGroupingExpr(Expr::Grouping& expr)
+	{
+		m_expr = newShared<Expr::Grouping>(this->expr(expr.expression));
+		return {};
+	}
+
+	object_t TreeCopy::visitIncrementExpr(Expr::Increment& expr)
+	{
+		m_expr = newShared<Expr::Increment>(expr.name, expr.depth, expr.op, expr.amount);
+		return {};
+	}
+
+	object_t TreeCopy::visitLiteralExpr(Expr::Literal& expr)
+	{
+		m_expr = newShared<Expr::Literal>(expr.value);
+		return {};
+	}
+
+	object_t TreeCopy::visitLogicalExpr(Expr::Logical& expr)
+	{
+		auto left = this->expr(expr.left);
+		m_expr = newShared<Expr::Logical>(std::move(left), expr.op, this->expr(expr.right));
+		return {};
+	}
+
+	object_t TreeCopy::visitNilCheckExpr(Expr::NilCheck& expr)
+	{
+		m_expr = newShared<Expr::NilCheck>(this->expr(expr.operand), expr.op);
+		return {};
+	}
+
+	object_t TreeCopy::visitSetExpr(Expr::Set& expr)
+	{
+		auto object = this->expr(expr.object);
+		m_expr = newShared<Expr::Set>(std::move(object), expr.name, this->expr(expr.value));
+		return {};
+	}
+
+	object_t TreeCopy::visitSetThisExpr(Expr::SetThis& expr)
+	{
+		m_expr = newShared<Expr::SetThis>(expr.keyword, expr.depth, expr.name, this->expr(expr.value));
+		return {};
+	}
+
+	object_t TreeCopy::visitSuperExpr(Expr::Super& expr)
+	{
+		m_expr = newShared<Expr::Super>(expr.keyword, expr.method);
+		return {};
+	}
+
+	object_t TreeCopy::visitThisExpr(Expr::This& expr)
+	{
+		m_expr = newShared<Expr::This>(expr.keyword);
+		return {};
+	}
+
+	object_t TreeCopy::visitUnaryExpr(Expr::Unary& expr)
+	{
+		m_expr = newShared<Expr::Unary>(expr.op, this->expr(expr.right));
+		return {};
+	}
+
+	object_t TreeCopy::visitVariableExpr(Expr::Variable& expr)
+	{
+		m_expr = newShared<Expr::Variable>(expr.name);
+		return {};
+	}
+}
+
+
+HeapCopy::HeapCopy(const Interpreter& from, std::shared_ptr<Environment> globals) :
+	m_from(from),
+	m_globals(std::move(globals))
+{
+	m_environments.emplace(m_from.globals.get(), m_globals);
+}
+
+object_t HeapCopy::value(const object_t& value)
+{
+	if (is<std::shared_ptr<LoxInstance>>(value)) { return instance(*as<std::shared_ptr<LoxInstance>>(value)); }
+	if (is<std::shared_ptr<LoxClass>>(value)) { return klass(*as<std::shared_ptr<LoxClass>>(value)); }
+	if (is<std::shared_ptr<LoxFunction>>(value)) { return function(*as<std::shared_ptr<LoxFunction>>(value)); }
+
+	if (is<std::shared_ptr<LoxCallable>>(value))
+	{
+		const LoxCallable& callable = *as<std::shared_ptr<LoxCallable>>(value);
+		if (typeid(callable) == typeid(LoxFunction)) { return std::shared_ptr<LoxCallable>(function(static_cast<const LoxFunction&>(callable))); }
+		if (typeid(callable) == typeid(LoxClass)) { return std::shared_ptr<LoxCallable>(klass(static_cast<const LoxClass&>(callable))); }
+	}
+
+	// nil, booleans, numbers, strings, built-in functions, channels and files
+	return value;
+}
+
+void HeapCopy::globals()
+{
+	for (const auto& [name, global] : m_from.globals->getValues())
+	{
+		m_globals->define(name, value(global));
+	}
+}
+
+std::shared_ptr<Environment> HeapCopy::environment(const std::shared_ptr<Environment>& environment)
+{
+	if (environment == nullptr) { return nullptr; }
+	if (const auto it = m_environments.find(environment.get()); it != m_environments.end()) { return it->second; }
+
+	// known before its values are copied, which may refer back to it
+	auto copy = newShared<Environment>(this->environment(environment->getEnclosing()));
+	m_environments.emplace(environment.get(), copy);
+
+	for (const auto& [name, variable] : environment->getValues())
+	{
+		copy->define(name, value(variable));
+	}
+	return copy;
+}
+
+std::shared_ptr<LoxFunction> HeapCopy::function(const LoxFunction& function)
+{
+	if (const auto it = m_functions.find(&function); it != m_functions.end()) { return it->second; }
+
+	auto closure = environment(function.getClosure());
+	auto copy = newShared<LoxFunction>(declaration(function.getDeclaration()), std::move(closure), function.isInitializer());
+
+	// copying the closure may have copied the function itself
+	return m_functions.try_emplace(&function, std::move(copy)).first->second;
+}
+
+std::shared_ptr<LoxClass> HeapCopy::klass(const LoxClass& klass)
+{
+	if (const auto it = m_classes.find(&klass); it != m_classes.end()) { return it->second; }
+
+	std::shared_ptr<LoxClass> superclass = klass.superclass != nullptr ? this->klass(*klass.superclass) : nullptr;
+
+	StringMap<std::shared_ptr<LoxFunction>> methods;
+	for (const auto& [name, method] : klass.getMethods())
+	{
+		methods.emplace(name, function(*method));
+	}
+
+	if (const auto it = m_classes.find(&klass); it != m_classes.end()) { return it->second; }
+	auto copy = newShared<LoxClass>(klass.name, std::move(superclass), std::move(methods));
+	m_classes.emplace(&klass, copy);
+	return copy;
+}
+
+std::shared_ptr<LoxInstance> HeapCopy::instance(const LoxInstance& instance)
+{
+	if (const auto it = m_instances.find(&instance); it != m_instances.end()) { return it->second; }
+
+	// channels and open files are shared
+	if (dynamic_cast<const Channel*>(&instance) != nullptr || dynamic_cast<const InputFile*>(&instance) != nullptr)
+	{
+		return instance.getShared();
+	}
+
+	// the elements and fields are copied once the instance is known, they may refer back to it
+	if (const auto* array = dynamic_cast<const LoxArray*>(&instance))
+	{
+		auto copy = newShared<LoxArray>();
+		m_instances.emplace(&instance, copy);
+
+		copy->elements.reserve(array->elements.size());
+		for (const object_t& element : array->elements)
+		{
+			copy->elements.push_back(value(element));
+		}
+		return copy;
+	}
+
+	if (const auto* map = dynamic_cast<const LoxMap*>(&instance))
+	{
+		auto copy = newShared<LoxMap>();
+		m_instances.emplace(&instance, copy);
+
+		map->forEach([this, &copy](const object_t& key, const object_t& entry) { copy->insert(value(key), value(entry)); });
+		return copy;
+	}
+
+	std::shared_ptr<LoxClass> klass = this->klass(instance.getClass());
+	if (const auto it = m_instances.find(&instance); it != m_instances.end()) { return it->second; }
+
+	auto copy = newShared<LoxInstance>(std::move(klass));
+	m_instances.emplace(&instance, copy);
+
+	for (const auto& [name, field] : instance.getFields())
+	{
+		copy->set(Token(IDENTIFIER, name, 0), value(field));
+	}
+	return copy;
+}
+
+std::shared_ptr<Stmt::Function> HeapCopy::declaration(const std::shared_ptr<Stmt::Function>& declaration)
+{
+	TreeCopy tree(m_from.locals, locals, m_declarations);
+	return tree.function(declaration);
+}
@@ -1,25 +1,17 @@
 #include "interpreter.h"
 
-#include <chrono>
-#include <iostream>
+#include <algorithm>
+#include <mutex>
 
-#include "lox.h"
+#include "fusion.h"
 #include "loxClass.h"
 #include "loxFunction.h"
 #include "loxInstance.h"
+#include "natives.h"
 #include "return.h"
 #include "RuntimeError.h"
-
-
-class ClockFunction final : public LoxCallable
-{
-public:
-	object_t call(Interpreter*, const std::vector<object_t>&) const override
-	{
-		return static_cast<double>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-	}
-	size_t arity() const override { return 0; }
-};
+#include "specialization.h"
+#include "threads.h"
 
 
 // helper functions
@@ -33,28 +25,29 @@ void CheckNumberOperands(const Token& op, const object_t& left, const object_t&
 }
 
 // constructor
-Interpreter::Interpreter() :
-	globals(newShared<Environment>(nullptr)),
-	m_environment(globals),
-	m_clockFunction(newShared<ClockFunction>())
+Interpreter::Interpreter(OutputSink& output) :
+	Interpreter(output, newShared<Environment>(nullptr))
 {
-	globals->define("clock", m_clockFunction);
+	for (auto& [name, native] : CreateNatives())
+	{
+		globals->define(name, std::move(native));
+	}
 }
 
 
+Interpreter::Interpreter(OutputSink& output, std::shared_ptr<Environment> globalScope) :
+	globals(std::move(globalScope)),
+	out(output),
+	m_environment(globals)
+{}
+
+
 // where the magic starts
 void Interpreter::interpret(const std::vector<std::shared_ptr<Stmt>>& statements)
 {
-	try
-	{
-		for (const auto& statement : statements)
-		{
-			execute(statement);
-		}
-	}
-	catch (RuntimeError& error)
+	for (const auto& statement : statements)
 	{
-		Lox::runtimeError(error);
+		execute(statement);
 	}
 }
 
@@ -91,10 +84,10 @@ void Interpreter::visitClassStmt(Stmt::Class& stmt)
 	}
 
 	// collect methods
-	std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods;
+	StringMap<std::shared_ptr<LoxFunction>> methods;
 	for (const auto& method : stmt.methods)
 	{
-		methods.insert_or_assign(method->name.lexeme, newShared<LoxFunction>(method, m_environment, method->name.lexeme == "init"));
+		methods.insert_or_assign(std::string(method->name.lexeme), newShared<LoxFunction>(method, m_environment, method->name.lexeme == "init"));
 	}
 
 	if (superclass != nullptr)
@@ -103,7 +96,25 @@ void Interpreter::visitClassStmt(Stmt::Class& stmt)
 	}
 
 	// assign the class to the class name
-	m_environment->assign(stmt.name, newShared<LoxClass>(stmt.name.lexeme, std::move(superclass), std::move(methods)));
+	m_environment->assign(stmt.name, newShared<LoxClass>(std::string(stmt.name.lexeme), std::move(superclass), std::move(methods)));
+}
+
+void Interpreter::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+{
+	std::shared_ptr<Environment> previous = m_environment;
+	m_environment = newShared<Environment>(previous);
+
+	try
+	{
+		countedLoop(stmt);
+	}
+	catch (...)
+	{
+		m_environment = std::move(previous);
+		throw;
+	}
+
+	m_environment = std::move(previous);
 }
 
 void Interpreter::visitExpressionStmt(Stmt::Expression& stmt)
@@ -130,10 +141,17 @@ void Interpreter::visitIfStmt(Stmt::If& stmt)
 	}
 }
 
+void Interpreter::visitImportStmt(Stmt::Import&)
+{
+	// imports are replaced by the statements of their modules before anything runs, see modules.h
+}
+
 void Interpreter::visitPrintStmt(Stmt::Print& stmt)
 {
 	const object_t value = evaluate(stmt.expression);
-	std::cout << toString(value) << "\n";
+	std::unique_lock<std::mutex> lock;
+	if (threads != nullptr) { lock = std::unique_lock(threads->output); }
+	out.print(value);
 }
 
 void Interpreter::visitReturnStmt(Stmt::Return& stmt)
@@ -162,6 +180,49 @@ void Interpreter::visitWhileStmt(Stmt::While& stmt)
 	}
 }
 
+void Interpreter::countedLoop(const Stmt::CountedLoop& stmt)
+{
+	const std::shared_ptr<Environment> loop = m_environment;
+	execute(stmt.variable);
+	object_t& variable = loop->slot(stmt.variable->name.lexeme);
+
+	// the block the parser wraps around the body and the increment declares nothing, so every iteration can share it
+	const std::shared_ptr<Environment> iteration = newShared<Environment>(loop);
+
+	if (is<double>(variable))
+	{
+		double counter = as<double>(variable);
+		const TokenType op = stmt.condition->op.type;
+
+		while (true)
+		{
+			const object_t bound = evaluate(stmt.condition->right);
+			if (!is<double>(bound)) break; // let the generic loop below raise the error
+
+			const double limit = as<double>(bound);
+			const bool keepGoing = op == LESS ? counter < limit : op == LESS_EQUAL ? counter <= limit : op == GREATER ? counter > limit : counter >= limit;
+			if (!keepGoing) return;
+
+			m_environment = iteration;
+			execute(stmt.body);
+			m_environment = loop;
+
+			counter += stmt.step;
+			variable = counter;
+		}
+	}
+
+	// generic loop, the condition only holds when the variable is a number
+	while (IsTruthy(evaluate(stmt.condition)))
+	{
+		m_environment = iteration;
+		execute(stmt.body);
+		m_environment = loop;
+
+		variable = as<double>(variable) + stmt.step;
+	}
+}
+
 
 // Expressions
 object_t Interpreter::visitAssignExpr(Expr::Assign& expr)
@@ -187,20 +248,68 @@ object_t Interpreter::visitBinaryExpr(Expr::Binary& expr)
 	const object_t left = evaluate(expr.left);
 	const object_t right = evaluate(expr.right);
 
-	switch (expr.op.type)
+	if (expr.specialization == Specialization::UNINITIALIZED) { expr.specialization = Specialize(expr.op, left, right); }
+
+	// specialized nodes only guard the operand types they have seen
+	switch (expr.specialization)
+	{
+	case Specialization::ADD_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) + as<double>(right);
+		break;
+	case Specialization::SUBTRACT_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) - as<double>(right);
+		break;
+	case Specialization::MULTIPLY_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) * as<double>(right);
+		break;
+	case Specialization::DIVIDE_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) / as<double>(right);
+		break;
+	case Specialization::GREATER_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) > as<double>(right);
+		break;
+	case Specialization::GREATER_EQUAL_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) >= as<double>(right);
+		break;
+	case Specialization::LESS_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) < as<double>(right);
+		break;
+	case Specialization::LESS_EQUAL_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) <= as<double>(right);
+		break;
+	case Specialization::EQUAL_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) == as<double>(right);
+		break;
+	case Specialization::NOT_EQUAL_NUMBERS:
+		if (is<double>(left) && is<double>(right)) return as<double>(left) != as<double>(right);
+		break;
+	case Specialization::CONCATENATE_STRINGS:
+		if (is<std::string>(left) && is<std::string>(right)) return as<std::string>(left) + as<std::string>(right);
+		break;
+	default:
+		return EvaluateBinary(expr.op, left, right);
+	}
+
+	Deoptimize(expr);
+	return EvaluateBinary(expr.op, left, right);
+}
+
+object_t EvaluateBinary(const Token& op, const object_t& left, const object_t& right)
+{
+	switch (op.type)
 	{
 		// comparisons
 	case GREATER:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) > as<double>(right);
 	case GREATER_EQUAL:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) >= as<double>(right);
 	case LESS:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) < as<double>(right);
 	case LESS_EQUAL:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) <= as<double>(right);
 	case BANG_EQUAL:
 		return!IsEqual(left, right);
@@ -209,7 +318,7 @@ object_t Interpreter::visitBinaryExpr(Expr::Binary& expr)
 
 		// arithmetic
 	case MINUS:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) - as<double>(right);
 	case PLUS:
 		if (is<double>(left) && is<double>(right))
@@ -220,15 +329,15 @@ object_t Interpreter::visitBinaryExpr(Expr::Binary& expr)
 		{
 			return as<std::string>(left) + as<std::string>(right);
 		}
-		throw RuntimeError(expr.op, "Operands must be two numbers or two strings.");
+		throw RuntimeError(op, "Operands must be two numbers or two strings.");
 	case SLASH:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) / as<double>(right);
 	case STAR:
-		CheckNumberOperands(expr.op, left, right);
+		CheckNumberOperands(op, left, right);
 		return as<double>(left) * as<double>(right);
 	default:
-		throw RuntimeError(expr.op, "Unknown binary operator.");
+		throw RuntimeError(op, "Unknown binary operator.");
 	}
 }
 
@@ -242,6 +351,11 @@ object_t Interpreter::visitCallExpr(Expr::Call& expr)
 		arguments.push_back(evaluate(arg));
 	}
 
+	return CallValue(this, expr.paren, callee, arguments);
+}
+
+object_t CallValue(Interpreter* interpreter, const Token& paren, const object_t& callee, const std::vector<object_t>& arguments)
+{
 	LoxCallable* callable = nullptr;
 
 	if (is<std::shared_ptr<LoxCallable>>(callee)) { callable = as<std::shared_ptr<LoxCallable>>(callee).get(); }
@@ -250,15 +364,40 @@ object_t Interpreter::visitCallExpr(Expr::Call& expr)
 
 	if (callable == nullptr)
 	{
-		throw RuntimeError(expr.paren, "Can only call functions and classes.");
+		throw RuntimeError(paren, "Can only call functions and classes.");
 	}
 
 	if (arguments.size() != callable->arity())
 	{
-		throw RuntimeError(std::move(expr.paren), "Expected " + std::to_string(callable->arity()) + " arguments but got " + std::to_string(arguments.size()) + ".");
+		throw RuntimeError(paren, "Expected " + std::to_string(callable->arity()) + " arguments but got " + std::to_string(arguments.size()) + ".");
 	}
 
-	return callable->call(this, arguments);
+	try
+	{
+		return callable->call(interpreter, arguments);
+	}
+	catch (NativeError& error)
+	{
+		throw RuntimeError(paren, error.what());
+	}
+}
+
+object_t Interpreter::visitCompareConstantExpr(Expr::CompareConstant& expr)
+{
+	fusionStatistics.hits[FusionPass::COMPARE_CONSTANT]++;
+
+	const object_t value = getVariable(expr.name, expr.depth);
+	if (!is<double>(value)) { throw RuntimeError(expr.op, "Operands must be numbers."); }
+
+	switch (expr.op.type)
+	{
+	case GREATER: return as<double>(value) > expr.constant;
+	case GREATER_EQUAL: return as<double>(value) >= expr.constant;
+	case LESS: return as<double>(value) < expr.constant;
+	case LESS_EQUAL: return as<double>(value) <= expr.constant;
+	default:
+		throw RuntimeError(expr.op, "Unknown binary operator.");
+	}
 }
 
 object_t Interpreter::visitGetExpr(Expr::Get& expr)
@@ -272,11 +411,42 @@ object_t Interpreter::visitGetExpr(Expr::Get& expr)
 	throw RuntimeError(expr.name, "Only instances have properties.");
 }
 
+object_t Interpreter::visitGetChainExpr(Expr::GetChain& expr)
+{
+	fusionStatistics.hits[FusionPass::GET_CHAIN]++;
+
+	object_t object = evaluate(expr.object);
+	for (const Token& name : expr.names)
+	{
+		if (!is<std::shared_ptr<LoxInstance>>(object))
+		{
+			throw RuntimeError(name, "Only instances have properties.");
+		}
+		object = as<std::shared_ptr<LoxInstance>>(object)->get(name);
+	}
+	return object;
+}
+
 object_t Interpreter::visitGroupingExpr(Expr::Grouping& expr)
 {
 	return evaluate(expr.expression);
 }
 
+object_t Interpreter::visitIncrementExpr(Expr::Increment& expr)
+{
+	fusionStatistics.hits[FusionPass::INCREMENT]++;
+
+	const object_t value = getVariable(expr.name, expr.depth);
+	if (!is<double>(value))
+	{
+		throw RuntimeError(expr.op, expr.op.type == PLUS ? "Operands must be two numbers or two strings." : "Operands must be numbers.");
+	}
+
+	object_t result = expr.op.type == PLUS ? as<double>(value) + expr.amount : as<double>(value) - expr.amount;
+	assignVariable(expr.name, expr.depth, result);
+	return result;
+}
+
 object_t Interpreter::visitLiteralExpr(Expr::Literal& expr)
 {
 	return expr.value;
@@ -298,6 +468,14 @@ object_t Interpreter::visitLogicalExpr(Expr::Logical& expr)
 	return evaluate(expr.right);
 }
 
+object_t Interpreter::visitNilCheckExpr(Expr::NilCheck& expr)
+{
+	fusionStatistics.hits[FusionPass::NIL_CHECK]++;
+
+	const bool isNil = IsNull(evaluate(expr.operand));
+	return expr.op.type == EQUAL_EQUAL ? isNil : !isNil;
+}
+
 object_t Interpreter::visitSetExpr(Expr::Set& expr)
 {
 	// instance.field = value;
@@ -313,6 +491,17 @@ object_t Interpreter::visitSetExpr(Expr::Set& expr)
 	return value;
 }
 
+object_t Interpreter::visitSetThisExpr(Expr::SetThis& expr)
+{
+	fusionStatistics.hits[FusionPass::SET_THIS]++;
+
+	// "this" is always an instance
+	const object_t instance = m_environment->getAt(expr.depth, "this");
+
+	object_t value = evaluate(expr.value);
+	as<std::shared_ptr<LoxInstance>>(instance)->set(expr.name, value);
+	return value;
+}
 
 object_t Interpreter::visitSuperExpr(Expr::Super& expr)
 {
@@ -325,7 +514,7 @@ object_t Interpreter::visitSuperExpr(Expr::Super& expr)
 
 	if (!method)
 	{
-		throw RuntimeError(expr.method, "Undefined property '" + expr.method.lexeme + "'.");
+		throw RuntimeError(expr.method, "Undefined property '" + std::string(expr.method.lexeme) + "'.");
 	}
 
 	const auto instance = as<std::shared_ptr<LoxInstance>>(m_environment->getAt(distance - 1, "this"));
@@ -340,10 +529,24 @@ object_t Interpreter::visitThisExpr(Expr::This& expr)
 object_t Interpreter::visitUnaryExpr(Expr::Unary& expr)
 {
 	const object_t right = evaluate(expr.right);
-	switch (expr.op.type)
+
+	if (expr.specialization == Specialization::UNINITIALIZED) { expr.specialization = Specialize(expr.op, right); }
+
+	if (expr.specialization == Specialization::NEGATE_NUMBER)
+	{
+		if (is<double>(right)) return -as<double>(right);
+		Deoptimize(expr);
+	}
+
+	return EvaluateUnary(expr.op, right);
+}
+
+object_t EvaluateUnary(const Token& op, const object_t& right)
+{
+	switch (op.type)
 	{
 	case MINUS:
-		CheckNumberOperand(expr.op, right);
+		CheckNumberOperand(op, right);
 		return -as<double>(right);
 	case BANG:
 		return !IsTruthy(right);
@@ -360,8 +563,13 @@ object_t Interpreter::visitVariableExpr(Expr::Variable& expr)
 
 void Interpreter::resolve(std::shared_ptr<Expr> expr, size_t depth)
 {
-	// clean up all resolved locals that have no references except for the one in locals
-	std::erase_if(locals, [](const auto& local) { return local.first.use_count() == 1; });
+	// clean up all resolved locals that have no references except for the one in locals, only once the map has doubled
+	// since the last clean up so resolving a large program stays linear
+	if (locals.size() >= m_nextCleanUp)
+	{
+		std::erase_if(locals, [](const auto& local) { return local.first.use_count() == 1; });
+		m_nextCleanUp = std::max<size_t>(2 * locals.size(), 64);
+	}
 
 	locals.emplace(std::move(expr), depth);
 }
@@ -378,6 +586,18 @@ object_t Interpreter::lookUpVariable(const Token& name, const std::shared_ptr<Ex
 	return globals->get(name);
 }
 
+object_t Interpreter::getVariable(const Token& name, const std::optional<size_t> depth)
+{
+	if (depth) { return m_environment->getAt(*depth, name.lexeme); }
+	return globals->get(name);
+}
+
+void Interpreter::assignVariable(const Token& name, const std::optional<size_t> depth, object_t value)
+{
+	if (depth) { m_environment->assignAt(*depth, name, std::move(value)); }
+	else { globals->assign(name, std::move(value)); }
+}
+
 
 void Interpreter::executeBlock(const std::vector<std::shared_ptr<Stmt>>& stmts, std::shared_ptr<Environment> environment)
 {
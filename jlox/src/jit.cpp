@@ -0,0 +1,684 @@
+#include "jit.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iomanip>
+
+#include "environment.h"
+#include "loxFunction.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86_64_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	// a function that keeps bailing out is handed back to the interpreter for good
+	constexpr size_t MAX_BAILS = 3;
+
+	Jit::NativeCode ResolveCallee(Jit::State* state, Jit::CallSite* site) noexcept
+	{
+		return state->jit->resolve(*site);
+	}
+
+#if defined(JIT_X86_64_LINUX)
+	size_t PageAligned(const size_t size)
+	{
+		const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		return (size + page - 1) / page * page;
+	}
+
+	struct Unsupported
+	{
+		const char* reason;
+	};
+
+	// emits raw x86-64, with labels for forward jumps
+	class Assembler
+	{
+	public:
+		using Label = size_t;
+
+		void emit(const std::initializer_list<uint8_t> bytes) { m_code.insert(m_code.end(), bytes); }
+
+		void imm32(const int32_t value)
+		{
+			uint8_t bytes[4];
+			std::memcpy(bytes, &value, sizeof(bytes));
+			m_code.insert(m_code.end(), bytes, bytes + sizeof(bytes));
+		}
+
+		void imm64(const uint64_t value)
+		{
+			uint8_t bytes[8];
+			std::memcpy(bytes, &value, sizeof(bytes));
+			m_code.insert(m_code.end(), bytes, bytes + sizeof(bytes));
+		}
+
+		Label label()
+		{
+			m_labels.push_back(SIZE_MAX);
+			return m_labels.size() - 1;
+		}
+
+		void bind(const Label label) { m_labels[label] = m_code.size(); }
+
+		void jmp(const Label label)
+		{
+			emit({ 0xE9 });
+			reference(label);
+		}
+
+		// condition is the low nibble of the 0F 8x opcode
+		void jcc(const uint8_t condition, const Label label)
+		{
+			emit({ 0x0F, static_cast<uint8_t>(0x80 | condition) });
+			reference(label);
+		}
+
+		size_t position() const { return m_code.size(); }
+
+		void patch32(const size_t position, const int32_t value) { std::memcpy(m_code.data() + position, &value, sizeof(value)); }
+
+		std::vector<uint8_t> finish()
+		{
+			for (const auto& [position, label] : m_references)
+			{
+				patch32(position, static_cast<int32_t>(m_labels[label] - (position + 4)));
+			}
+			return std::move(m_code);
+		}
+
+	private:
+		void reference(const Label label)
+		{
+			m_references.emplace_back(m_code.size(), label);
+			imm32(0);
+		}
+
+		std::vector<uint8_t> m_code;
+		std::vector<size_t> m_labels;
+		std::vector<std::pair<size_t, Label>> m_references;
+	};
+
+	constexpr uint8_t CC_EQUAL = 0x4;
+	constexpr uint8_t CC_NOT_EQUAL = 0x5;
+
+	// Compiles one function to a frame of doubles: rbp-relative slots for the locals, r12 holding the state and r13 the
+	// arguments. Numbers are computed in xmm0 and booleans in eax, intermediate numbers go on the machine stack.
+	class FunctionCompiler
+	{
+	public:
+		FunctionCompiler(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, std::vector<std::unique_ptr<Jit::CallSite>>& sites) :
+			m_locals(locals), m_sites(sites)
+		{}
+
+		std::vector<uint8_t> compile(const Stmt::Function& function)
+		{
+			m_epilogue = m_asm.label();
+			m_bail = m_asm.label();
+
+			// push rbp; mov rbp, rsp; push r12; push r13; sub rsp, frame
+			m_asm.emit({ 0x55, 0x48, 0x89, 0xE5, 0x41, 0x54, 0x41, 0x55, 0x48, 0x81, 0xEC });
+			const size_t frame = m_asm.position();
+			m_asm.imm32(0);
+			// mov r12, rsi; mov r13, rdi
+			m_asm.emit({ 0x49, 0x89, 0xF4, 0x49, 0x89, 0xFD });
+
+			// the arguments are pushed in order, so the pointer points at the last one
+			m_scopes.emplace_back();
+			const size_t arity = function.params.size();
+			for (size_t i = 0; i < arity; i++)
+			{
+				// movsd xmm0, [r13 + offset]
+				m_asm.emit({ 0xF2, 0x41, 0x0F, 0x10, 0x85 });
+				m_asm.imm32(static_cast<int32_t>(8 * (arity - 1 - i)));
+				store(declare(function.params[i].lexeme));
+			}
+
+			statements(function.body);
+
+			// falling off the end returns nil
+			m_asm.jmp(m_bail);
+
+			// mov byte [r12], 1 (State::bailed)
+			m_asm.bind(m_bail);
+			static_assert(offsetof(Jit::State, bailed) == 0);
+			m_asm.emit({ 0x41, 0xC6, 0x04, 0x24, 0x01 });
+
+			// lea rsp, [rbp - 16]; pop r13; pop r12; pop rbp; ret
+			m_asm.bind(m_epilogue);
+			m_asm.emit({ 0x48, 0x8D, 0x65, 0xF0, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0xC3 });
+
+			// keeps rsp 16 byte aligned in the body
+			m_asm.patch32(frame, static_cast<int32_t>((m_slotCount * 8 + 15) / 16 * 16));
+			return m_asm.finish();
+		}
+
+	private:
+		enum class Type { NUMBER, BOOL };
+
+		// statements --------------------------------------------------
+
+		void statements(const std::vector<std::shared_ptr<Stmt>>& stmts)
+		{
+			for (const auto& stmt : stmts)
+			{
+				statement(stmt);
+			}
+		}
+
+		void statement(const std::shared_ptr<Stmt>& stmt)
+		{
+			if (const auto* block = dynamic_cast<Stmt::Block*>(stmt.get()))
+			{
+				m_scopes.emplace_back();
+				statements(block->statements);
+				m_scopes.pop_back();
+			}
+			else if (const auto* loop = dynamic_cast<Stmt::CountedLoop*>(stmt.get()))
+			{
+				// the loop it was specialized from, counted in a slot
+				m_scopes.emplace_back();
+				statement(loop->variable);
+
+				const auto start = m_asm.label();
+				const auto end = m_asm.label();
+				m_asm.bind(start);
+				condition(loop->condition);
+				branchIfFalse(end);
+
+				m_scopes.emplace_back();
+				statement(loop->body);
+				expression(loop->increment);
+				m_scopes.pop_back();
+
+				m_asm.jmp(start);
+				m_asm.bind(end);
+				m_scopes.pop_back();
+			}
+			else if (const auto* expression = dynamic_cast<Stmt::Expression*>(stmt.get()))
+			{
+				this->expression(expression->expression);
+			}
+			else if (const auto* branch = dynamic_cast<Stmt::If*>(stmt.get()))
+			{
+				const auto otherwise = m_asm.label();
+				const auto end = m_asm.label();
+
+				condition(branch->condition);
+				branchIfFalse(otherwise);
+				statement(branch->thenBranch);
+				m_asm.jmp(end);
+				m_asm.bind(otherwise);
+				if (branch->elseBranch != nullptr) { statement(branch->elseBranch); }
+				m_asm.bind(end);
+			}
+			else if (const auto* ret = dynamic_cast<Stmt::Return*>(stmt.get()))
+			{
+				if (ret->value == nullptr)
+				{
+					m_asm.jmp(m_bail);
+					return;
+				}
+				number(ret->value);
+				m_asm.jmp(m_epilogue);
+			}
+			else if (const auto* var = dynamic_cast<Stmt::Var*>(stmt.get()))
+			{
+				if (var->initializer == nullptr) throw Unsupported{ "declares a variable without a number" };
+				number(var->initializer);
+				store(declare(var->name.lexeme));
+			}
+			else if (const auto* loop = dynamic_cast<Stmt::While*>(stmt.get()))
+			{
+				const auto start = m_asm.label();
+				const auto end = m_asm.label();
+
+				m_asm.bind(start);
+				condition(loop->condition);
+				branchIfFalse(end);
+				statement(loop->body);
+				m_asm.jmp(start);
+				m_asm.bind(end);
+			}
+			else
+			{
+				throw Unsupported{ "uses a statement other than var, if, while, return, blocks and expressions" };
+			}
+		}
+
+		// expressions -------------------------------------------------
+
+		void number(const std::shared_ptr<Expr>& expr)
+		{
+			if (expression(expr) != Type::NUMBER) throw Unsupported{ "uses a boolean as a value" };
+		}
+
+		void condition(const std::shared_ptr<Expr>& expr)
+		{
+			if (expression(expr) != Type::BOOL) throw Unsupported{ "uses a number as a condition" };
+		}
+
+		Type expression(const std::shared_ptr<Expr>& expr)
+		{
+			Expr* e = expr.get();
+
+			if (const auto* assign = dynamic_cast<Expr::Assign*>(e))
+			{
+				number(assign->value);
+				store(slot(depthOf(*e), assign->name.lexeme));
+				return Type::NUMBER;
+			}
+			if (const auto* binary = dynamic_cast<Expr::Binary*>(e))
+			{
+				number(binary->left);
+				push();
+				number(binary->right);
+				popLeft();
+				return operation(binary->op.type);
+			}
+			if (auto* call = dynamic_cast<Expr::Call*>(e))
+			{
+				this->call(*call);
+				return Type::NUMBER;
+			}
+			if (const auto* compare = dynamic_cast<Expr::CompareConstant*>(e))
+			{
+				load(slot(compare->depth, compare->name.lexeme));
+				constant(compare->constant, 1);
+				return operation(compare->op.type);
+			}
+			if (const auto* grouping = dynamic_cast<Expr::Grouping*>(e))
+			{
+				return expression(grouping->expression);
+			}
+			if (const auto* increment = dynamic_cast<Expr::Increment*>(e))
+			{
+				const int32_t variable = slot(increment->depth, increment->name.lexeme);
+				load(variable);
+				constant(increment->amount, 1);
+				operation(increment->op.type);
+				store(variable);
+				return Type::NUMBER;
+			}
+			if (const auto* literal = dynamic_cast<Expr::Literal*>(e))
+			{
+				if (is<double>(literal->value))
+				{
+					constant(as<double>(literal->value), 0);
+					return Type::NUMBER;
+				}
+				if (is<bool>(literal->value))
+				{
+					// mov eax, imm32
+					m_asm.emit({ 0xB8 });
+					m_asm.imm32(as<bool>(literal->value) ? 1 : 0);
+					return Type::BOOL;
+				}
+				throw Unsupported{ "uses a literal that isn't a number or a boolean" };
+			}
+			if (const auto* logical = dynamic_cast<Expr::Logical*>(e))
+			{
+				const auto end = m_asm.label();
+				condition(logical->left);
+				// test eax, eax
+				m_asm.emit({ 0x85, 0xC0 });
+				m_asm.jcc(logical->op.type == OR ? CC_NOT_EQUAL : CC_EQUAL, end);
+				condition(logical->right);
+				m_asm.bind(end);
+				return Type::BOOL;
+			}
+			if (const auto* unary = dynamic_cast<Expr::Unary*>(e))
+			{
+				if (unary->op.type == BANG)
+				{
+					condition(unary->right);
+					// xor eax, 1
+					m_asm.emit({ 0x83, 0xF0, 0x01 });
+					return Type::BOOL;
+				}
+				number(unary->right);
+				// flip the sign bit, so -0 stays distinct from 0: mov rax, 1 << 63; movq xmm1, rax; xorpd xmm0, xmm1
+				m_asm.emit({ 0x48, 0xB8 });
+				m_asm.imm64(uint64_t{ 1 } << 63);
+				m_asm.emit({ 0x66, 0x48, 0x0F, 0x6E, 0xC8, 0x66, 0x0F, 0x57, 0xC1 });
+				return Type::NUMBER;
+			}
+			if (const auto* variable = dynamic_cast<Expr::Variable*>(e))
+			{
+				load(slot(depthOf(*e), variable->name.lexeme));
+				return Type::NUMBER;
+			}
+
+			throw Unsupported{ "uses objects, strings or nil" };
+		}
+
+		// xmm0 op xmm1
+		Type operation(const TokenType op)
+		{
+			switch (op)
+			{
+			case PLUS: m_asm.emit({ 0xF2, 0x0F, 0x58, 0xC1 }); return Type::NUMBER;
+			case MINUS: m_asm.emit({ 0xF2, 0x0F, 0x5C, 0xC1 }); return Type::NUMBER;
+			case STAR: m_asm.emit({ 0xF2, 0x0F, 0x59, 0xC1 }); return Type::NUMBER;
+			case SLASH: m_asm.emit({ 0xF2, 0x0F, 0x5E, 0xC1 }); return Type::NUMBER;
+
+				// ucomisd leaves the unordered (NaN) case with CF, ZF and PF set, which makes every comparison false
+			case GREATER: m_asm.emit({ 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x97, 0xC0 }); break;       // ucomisd xmm0, xmm1; seta al
+			case GREATER_EQUAL: m_asm.emit({ 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x93, 0xC0 }); break; // ucomisd xmm0, xmm1; setae al
+			case LESS: m_asm.emit({ 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x97, 0xC0 }); break;          // ucomisd xmm1, xmm0; seta al
+			case LESS_EQUAL: m_asm.emit({ 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x93, 0xC0 }); break;    // ucomisd xmm1, xmm0; setae al
+			case EQUAL_EQUAL: // ucomisd xmm0, xmm1; sete al; setnp cl; and al, cl
+				m_asm.emit({ 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8 });
+				break;
+			case BANG_EQUAL: // ucomisd xmm0, xmm1; setne al; setp cl; or al, cl
+				m_asm.emit({ 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8 });
+				break;
+			default:
+				throw Unsupported{ "uses an unknown operator" };
+			}
+
+			// movzx eax, al
+			m_asm.emit({ 0x0F, 0xB6, 0xC0 });
+			return Type::BOOL;
+		}
+
+		void call(const Expr::Call& call)
+		{
+			const auto* callee = dynamic_cast<Expr::Variable*>(call.callee.get());
+			if (callee == nullptr || m_locals.contains(call.callee)) throw Unsupported{ "calls something other than a global function" };
+
+			for (const auto& argument : call.arguments)
+			{
+				number(argument);
+				push();
+			}
+
+			auto& site = m_sites.emplace_back(std::make_unique<Jit::CallSite>(Jit::CallSite{ callee->name, call.arguments.size() }));
+
+			// the calls below need rsp 16 byte aligned
+			const bool pad = m_pushed % 2 != 0;
+			if (pad) { m_asm.emit({ 0x48, 0x83, 0xEC, 0x08 }); } // sub rsp, 8
+
+			// mov rdi, r12; mov rsi, site; mov rax, ResolveCallee; call rax
+			m_asm.emit({ 0x4C, 0x89, 0xE7, 0x48, 0xBE });
+			m_asm.imm64(reinterpret_cast<uint64_t>(site.get()));
+			m_asm.emit({ 0x48, 0xB8 });
+			m_asm.imm64(reinterpret_cast<uint64_t>(&ResolveCallee));
+			m_asm.emit({ 0xFF, 0xD0 });
+
+			// test rax, rax; jz bail
+			m_asm.emit({ 0x48, 0x85, 0xC0 });
+			m_asm.jcc(CC_EQUAL, m_bail);
+
+			// lea rdi, [rsp + pad]; mov rsi, r12; call rax
+			m_asm.emit({ 0x48, 0x8D, 0x7C, 0x24, static_cast<uint8_t>(pad ? 8 : 0), 0x4C, 0x89, 0xE6, 0xFF, 0xD0 });
+
+			// add rsp, arguments and padding
+			const size_t bytes = 8 * (call.arguments.size() + (pad ? 1 : 0));
+			if (bytes > 0)
+			{
+				m_asm.emit({ 0x48, 0x81, 0xC4 });
+				m_asm.imm32(static_cast<int32_t>(bytes));
+			}
+			m_pushed -= call.arguments.size();
+
+			// the callee bailed: cmp byte [r12], 0; jne epilogue
+			m_asm.emit({ 0x41, 0x80, 0x3C, 0x24, 0x00 });
+			m_asm.jcc(CC_NOT_EQUAL, m_epilogue);
+		}
+
+		// helpers -----------------------------------------------------
+
+		void branchIfFalse(const Assembler::Label label)
+		{
+			// test eax, eax; jz label
+			m_asm.emit({ 0x85, 0xC0 });
+			m_asm.jcc(CC_EQUAL, label);
+		}
+
+		// mov rax, bits; movq xmm0/xmm1, rax
+		void constant(const double value, const int reg)
+		{
+			uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			m_asm.emit({ 0x48, 0xB8 });
+			m_asm.imm64(bits);
+			m_asm.emit({ 0x66, 0x48, 0x0F, 0x6E, static_cast<uint8_t>(reg == 0 ? 0xC0 : 0xC8) });
+		}
+
+		// sub rsp, 8; movsd [rsp], xmm0
+		void push()
+		{
+			m_asm.emit({ 0x48, 0x83, 0xEC, 0x08, 0xF2, 0x0F, 0x11, 0x04, 0x24 });
+			m_pushed++;
+		}
+
+		// moves the right operand to xmm1 and pops the left one into xmm0:
+		// movapd xmm1, xmm0; movsd xmm0, [rsp]; add rsp, 8
+		void popLeft()
+		{
+			m_asm.emit({ 0x66, 0x0F, 0x28, 0xC8, 0xF2, 0x0F, 0x10, 0x04, 0x24, 0x48, 0x83, 0xC4, 0x08 });
+			m_pushed--;
+		}
+
+		// movsd xmm0, [rbp + displacement]
+		void load(const int32_t displacement)
+		{
+			m_asm.emit({ 0xF2, 0x0F, 0x10, 0x85 });
+			m_asm.imm32(displacement);
+		}
+
+		// movsd [rbp + displacement], xmm0
+		void store(const int32_t displacement)
+		{
+			m_asm.emit({ 0xF2, 0x0F, 0x11, 0x85 });
+			m_asm.imm32(displacement);
+		}
+
+		int32_t declare(const std::string_view name)
+		{
+			const size_t slot = m_slotCount++;
+			m_scopes.back().insert_or_assign(name, slot);
+			return Displacement(slot);
+		}
+
+		std::optional<size_t> depthOf(Expr& expr) const
+		{
+			const auto it = m_locals.find(expr.getShared());
+			if (it == m_locals.end()) return std::nullopt;
+			return it->second;
+		}
+
+		int32_t slot(const std::optional<size_t> depth, const std::string_view name) const
+		{
+			if (!depth) throw Unsupported{ "uses a global variable" };
+			if (*depth >= m_scopes.size()) throw Unsupported{ "uses a variable of an enclosing function" };
+			return Displacement(m_scopes[m_scopes.size() - 1 - *depth].at(name));
+		}
+
+		// below the saved rbp, r12 and r13
+		static int32_t Displacement(const size_t slot) { return -static_cast<int32_t>(24 + 8 * slot); }
+
+		const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+		std::vector<std::unique_ptr<Jit::CallSite>>& m_sites;
+
+		Assembler m_asm;
+		Assembler::Label m_epilogue = 0;
+		Assembler::Label m_bail = 0;
+
+		std::vector<std::unordered_map<std::string_view, size_t>> m_scopes;
+		size_t m_slotCount = 0;
+		size_t m_pushed = 0; // numbers on the machine stack
+	};
+#endif
+}
+
+
+#if defined(JIT_X86_64_LINUX)
+const bool Jit::supported = true;
+#else
+const bool Jit::supported = false;
+#endif
+
+Jit::Jit(std::shared_ptr<Environment> globals, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, const size_t threshold) :
+	m_globals(std::move(globals)),
+	m_locals(locals),
+	m_threshold(threshold)
+{
+	m_state.jit = this;
+}
+
+Jit::~Jit()
+{
+#if defined(JIT_X86_64_LINUX)
+	for (const auto& [declaration, function] : m_functions)
+	{
+		if (function.memory != nullptr) { munmap(function.memory, PageAligned(function.size)); }
+	}
+#endif
+}
+
+std::optional<object_t> Jit::call(const std::shared_ptr<Stmt::Function>& declaration, const std::vector<object_t>& arguments)
+{
+	Function& function = entry(declaration);
+	if (function.status == Function::REJECTED) return std::nullopt;
+
+	function.calls++;
+	if (function.status == Function::INTERPRETED)
+	{
+		if (function.calls < m_threshold) return std::nullopt;
+		compile(function);
+		if (function.status != Function::COMPILED) return std::nullopt;
+	}
+
+	// the guard on entry, the compiled code only ever sees numbers
+	std::array<double, 256> numbers;
+	const size_t arity = arguments.size();
+	for (size_t i = 0; i < arity; i++)
+	{
+		if (!is<double>(arguments[i])) return std::nullopt;
+		numbers[arity - 1 - i] = as<double>(arguments[i]);
+	}
+
+	m_state.bailed = false;
+	m_state.epoch++;
+	const double result = function.code(numbers.data(), &m_state);
+
+	if (m_state.bailed)
+	{
+		if (++function.bails >= MAX_BAILS)
+		{
+			function.status = Function::REJECTED;
+			function.reason = "bailed out too often";
+		}
+		return std::nullopt;
+	}
+	return result;
+}
+
+Jit::NativeCode Jit::resolve(CallSite& site)
+{
+	if (site.epoch == m_state.epoch) return site.code;
+
+	site.epoch = m_state.epoch;
+	site.code = nullptr;
+
+	std::shared_ptr<LoxFunction> callee = nullptr;
+	try
+	{
+		const object_t value = m_globals->get(site.name);
+		if (is<std::shared_ptr<LoxCallable>>(value)) { callee = std::dynamic_pointer_cast<LoxFunction>(as<std::shared_ptr<LoxCallable>>(value)); }
+		else if (is<std::shared_ptr<LoxFunction>>(value)) { callee = as<std::shared_ptr<LoxFunction>>(value); }
+	}
+	catch (...)
+	{
+		// undefined, the interpreter reports it
+		return nullptr;
+	}
+
+	if (callee == nullptr || callee->isInitializer() || callee->arity() != site.arity) return nullptr;
+
+	// callees are compiled on their first call from compiled code
+	Function& function = entry(callee->getDeclaration());
+	if (function.status == Function::INTERPRETED) { compile(function); }
+	if (function.status == Function::COMPILED) { site.code = function.code; }
+	return site.code;
+}
+
+void Jit::printStatistics(std::ostream& out) const
+{
+	out << std::left << std::setw(16) << "jit" << std::right << std::setw(6) << "line" << std::setw(10) << "calls" << std::setw(8) << "bytes"
+		<< std::setw(12) << "compile ms" << std::setw(7) << "bails" << "\n";
+
+	for (const Function* function : m_order)
+	{
+		const Token& name = function->declaration->name;
+		out << std::left << std::setw(16) << name.lexeme << std::right << std::setw(6) << name.line << std::setw(10) << function->calls;
+
+		if (function->code != nullptr)
+		{
+			out << std::setw(8) << function->size << std::setw(12) << std::fixed << std::setprecision(3) << function->compileMilliseconds
+				<< std::defaultfloat << std::setw(7) << function->bails;
+		}
+		if (function->status == Function::REJECTED) { out << "  not compiled: " << function->reason; }
+		out << "\n";
+	}
+}
+
+Jit::Function& Jit::entry(const std::shared_ptr<Stmt::Function>& declaration)
+{
+	auto [it, inserted] = m_functions.try_emplace(declaration.get());
+	if (inserted)
+	{
+		it->second.declaration = declaration;
+		m_order.push_back(&it->second);
+	}
+	return it->second;
+}
+
+void Jit::compile(Function& function)
+{
+#if defined(JIT_X86_64_LINUX)
+	const auto start = std::chrono::steady_clock::now();
+
+	try
+	{
+		FunctionCompiler compiler(m_locals, function.sites);
+		const std::vector<uint8_t> code = compiler.compile(*function.declaration);
+
+		void* memory = mmap(nullptr, PageAligned(code.size()), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) throw Unsupported{ "couldn't map memory for its code" };
+
+		std::memcpy(memory, code.data(), code.size());
+		if (mprotect(memory, PageAligned(code.size()), PROT_READ | PROT_EXEC) != 0)
+		{
+			munmap(memory, PageAligned(code.size()));
+			throw Unsupported{ "couldn't make its code executable" };
+		}
+
+		function.memory = memory;
+		function.size = code.size();
+		function.code = reinterpret_cast<NativeCode>(memory);
+		function.status = Function::COMPILED;
+	}
+	catch (const Unsupported& unsupported)
+	{
+		function.sites.clear();
+		function.status = Function::REJECTED;
+		function.reason = unsupported.reason;
+	}
+
+	function.compileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+#else
+	function.status = Function::REJECTED;
+	function.reason = "the JIT only supports x86-64 Linux";
+#endif
+}
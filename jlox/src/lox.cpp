@@ -1,27 +1,102 @@
 #include "lox.h"
 
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <stack>
 
+#include "countedLoop.h"
+#include "fusion.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "programCache.h"
 #include "resolver.h"
 #include "RuntimeError.h"
 #include "scanner.h"
+#include "specialization.h"
+#include "transpiler.h"
+
+
+Lox::Lox(Options isolateOptions, std::ostream& out, std::ostream& err) :
+	options(std::move(isolateOptions)),
+	m_out(out),
+	m_err(err),
+	m_errors(err),
+	m_modules(m_errors, options.cacheDirectory),
+	m_interpreter(m_out),
+	m_closureEngine(m_out),
+	m_flatEngine(m_out),
+	m_threads(m_out, err)
+{
+	if (options.flush.has_value()) { m_out.policy = *options.flush; }
 
+	m_interpreter.threads = &m_threads;
+	m_interpreter.events = &m_events;
+}
 
-void Lox::RunFile(const char* path)
+int Lox::runFile(const char* path)
 {
-	// https://stackoverflow.com/questions/18398167/how-to-copy-a-txt-file-to-a-char-array-in-c/18398230
+	// the file is mapped into memory where possible, the scanner then works on its bytes directly
+	if (auto source = Source::Load(path))
+	{
+		// imports are relative to the script
+		m_modules.setRoot(std::filesystem::path(path).parent_path());
+
+		run(m_sources.emplace_back(std::move(source))->text(), true);
+		runEvents();
+		m_threads.wait();
+		m_out.flush();
 
-	if (std::ifstream inputStream(path); inputStream.is_open())
+		if (m_hadFileError) { return 74; }
+		if (m_errors.hadError()) { return 65; }
+		if (m_threads.hadRuntimeError()) { return 70; }
+
+		if (std::string error; !options.snapshotOut.empty() && !m_snapshot.write(options.snapshotOut, m_interpreter.globals, error))
+		{
+			// what the script left in the heap is its own error, like a runtime one
+			if (!error.empty())
+			{
+				m_err << error << "\n";
+				return 70;
+			}
+			m_err << "Could not write snapshot '" << options.snapshotOut << "'.\n";
+			return 74;
+		}
+	}
+	return 0;
+}
+
+int Lox::loadSnapshot(const char* path)
+{
+	auto image = Source::Load(path);
+	if (image == nullptr)
 	{
-		const std::string source((std::istreambuf_iterator(inputStream)), std::istreambuf_iterator<char>());
-		Run(source);
+		m_err << "Could not read snapshot '" << path << "'.\n";
+		return 74;
+	}
+
+	std::vector<std::shared_ptr<Stmt>> statements;
+	if (!Snapshot::Read(image->text(), m_interpreter.globals, m_interpreter.locals, statements))
+	{
+		m_err << "Invalid snapshot '" << path << "'.\n";
+		return 65;
+	}
+
+	// the lexemes of the tree point into the image
+	m_sources.push_back(std::move(image));
+
+	// the functions of the image run with the passes they would have had if their script had been parsed, the
+	// statements themselves never run again
+	if (options.optimizationLevel > 0)
+	{
+		Optimizer optimizer;
+		optimizer.rewrite(statements);
 
-		if (m_hadError) { exit(65); }
-		if (m_hadRuntimeError) { exit(70); }
+		fuse(statements);
 	}
+	return 0;
 }
 
 // returns true if the source has no missing '}', ')' or '"', and the last character is an '}', ';' or three '\n' in a row
@@ -91,7 +166,7 @@ bool IsSourceComplete(const std::string& src)
 	return false;
 }
 
-void Lox::RunPrompt(const bool qualityOfLife)
+int Lox::runPrompt(const bool qualityOfLife)
 {
 	std::string source;
 	std::string line;
@@ -100,14 +175,23 @@ void Lox::RunPrompt(const bool qualityOfLife)
 	{
 		if (qualityOfLife)
 		{
-			std::cout << "> ";
+			// the workers of earlier lines may still be printing
+			std::lock_guard lock(m_threads.output);
+			m_out.write("> ");
+			m_out.flush();
 		}
 
 		// get input
 		std::getline(std::cin, source);
 
 		// special commands
-		if (std::cin.eof() || source == "exit") { break; }
+		if (std::cin.eof() || source == "exit")
+		{
+			runEvents();
+			m_threads.wait();
+			m_out.flush();
+			return !qualityOfLife && m_threads.hadRuntimeError() ? 70 : 0;
+		}
 		if (source == "clear") { system("CLS"); continue; }
 
 		// multiline inputs
@@ -115,7 +199,9 @@ void Lox::RunPrompt(const bool qualityOfLife)
 		{
 			if (qualityOfLife)
 			{
-				std::cout << "  ";
+				std::lock_guard lock(m_threads.output);
+				m_out.write("  ");
+				m_out.flush();
 			}
 			std::getline(std::cin, line);
 			source += "\n";
@@ -123,76 +209,203 @@ void Lox::RunPrompt(const bool qualityOfLife)
 		}
 
 		// interpret
-		Run(source);
+		run(m_sources.emplace_back(std::make_unique<Source>(source))->text());
 
 		// for unit testing
 		if (!qualityOfLife)
 		{
-			if (m_hadError) { exit(65); }
-			if (m_hadRuntimeError) { exit(70); }
+			if (m_errors.hadError()) { return 65; }
+			if (m_hadRuntimeError) { return 70; }
+		}
+		else
+		{
+			// after every line, tests run them once the whole script was read like a script file does
+			runEvents();
 		}
 
-		m_hadError = false;
+		m_errors.reset();
+		m_hadRuntimeError = false;
 
 	} while (true);
 }
 
-void Lox::Error(const size_t line, const std::string& message)
+void Lox::run(const std::string_view source, const bool cacheable)
 {
-	Report(line, "", message);
+	std::vector<std::shared_ptr<Stmt>> statements;
+
+	// a program that was run before skips scanning, parsing and resolving, streaming never holds a whole program
+	std::optional<ProgramCache> cache;
+	if (cacheable && !options.cacheDirectory.empty() && !(options.stream && options.emitCpp.empty()))
+	{
+		cache.emplace(options.cacheDirectory, source);
+
+		// the tokens of a cached program point into the entry, so it is kept like a source
+		auto image = Source::Load(cache->path().c_str());
+		if (image != nullptr && cache->read(image->text(), statements, m_interpreter.locals))
+		{
+			m_sources.push_back(std::move(image));
+			if (m_modules.link(statements, m_interpreter.locals)) { execute(statements); }
+			return;
+		}
+	}
+
+	// tokenize string
+	Scanner scanner(source, m_errors);
+
+	// parse tokens, the parser pulls them from the scanner
+	Parser parser(scanner, m_errors);
+
+	// a whole program is needed to write C++
+	if (options.stream && options.emitCpp.empty())
+	{
+		stream(parser);
+		return;
+	}
+
+	statements = parser.parse();
+
+	// Stop if there was a syntax error.
+	if (m_errors.hadError()) { return; }
+
+	if (!resolve(statements)) { return; }
+
+	// before the passes below rewrite the tree into nodes only they create, and before the imports are linked
+	if (cache.has_value()) { cache->write(statements, m_interpreter.locals); }
+
+	if (!m_modules.link(statements, m_interpreter.locals)) { return; }
+
+	execute(statements);
 }
 
-void Lox::runtimeError(const RuntimeError& error)
+bool Lox::resolve(std::vector<std::shared_ptr<Stmt>>& statements)
 {
-	std::cerr << error.what() << "\n[line " << error.token.line << "]\n";
-	m_hadRuntimeError = true;
+	// resolve variable names
+	Resolver resolver(m_interpreter, m_errors);
+	resolver.resolve(statements);
+
+	// Stop if there was a resolution error.
+	return !m_errors.hadError();
 }
 
-void Lox::Error(const Token& token, const std::string& message)
+void Lox::execute(std::vector<std::shared_ptr<Stmt>>& statements)
 {
-	if (token.type == END_OF_FILE)
+	// the heap written after the script ran points into its tree as the resolver left it
+	if (!options.snapshotOut.empty()) { m_snapshot.record(statements, m_interpreter.locals); }
+
+	// fold constants and remove dead code
+	if (options.optimizationLevel > 0)
 	{
-		Report(token.line, " at end", message);
+		Optimizer optimizer;
+		optimizer.rewrite(statements);
 	}
-	else
+
+	// compile ahead of time
+	if (!options.emitCpp.empty())
 	{
-		Report(token.line, " at '" + token.lexeme + "'", message);
+		std::ofstream out(options.emitCpp);
+		if (!out.is_open())
+		{
+			m_err << "Could not write '" << options.emitCpp << "'.\n";
+			m_hadFileError = true;
+			return;
+		}
+
+		Transpiler transpiler(m_interpreter.locals);
+		transpiler.emit(statements, out);
+		return;
 	}
-}
 
+	// interpret
+	try
+	{
+		if (options.engine == Engine::CLOSURE)
+		{
+			m_closureEngine.interpret(statements, m_interpreter.locals);
+		}
+		else if (options.engine == Engine::FLAT)
+		{
+			m_flatEngine.interpret(statements, m_interpreter.locals);
+		}
+		else
+		{
+			if (options.optimizationLevel > 0) { fuse(statements); }
+
+			if (options.jit && m_interpreter.jit == nullptr)
+			{
+				m_interpreter.jit = std::make_unique<Jit>(m_interpreter.globals, m_interpreter.locals, options.jitThreshold);
+			}
 
-Interpreter Lox::m_interpreter = Interpreter();
+			m_interpreter.interpret(statements);
+		}
+	}
+	catch (RuntimeError& error)
+	{
+		runtimeError(error);
+	}
 
-bool Lox::m_hadError = false;
-bool Lox::m_hadRuntimeError = false;
+	if (options.engine == Engine::INTERPRETER && options.dumpSpecializations)
+	{
+		SpecializationDump dump(m_err);
+		dump.rewrite(statements);
+	}
+}
 
-void Lox::Run(const std::string& source)
+void Lox::fuse(std::vector<std::shared_ptr<Stmt>>& statements)
 {
-	// tokenize string
-	Scanner scanner(source);
-	const std::vector<Token> tokens = scanner.scan();
+	CountedLoopPass countedLoops(m_interpreter.locals);
+	countedLoops.rewrite(statements);
 
-	// parse tokens
-	Parser parser(tokens);
-	const std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+	FusionPass fusion(m_interpreter.locals, m_interpreter.fusionStatistics);
+	fusion.rewrite(statements);
+}
 
-	// Stop if there was a syntax error.
-	if (m_hadError) { return; }
+void Lox::stream(Parser& parser)
+{
+	while (!parser.isAtEnd())
+	{
+		std::vector<std::shared_ptr<Stmt>> statements = { parser.parseDeclaration() };
 
-	// resolve variable names
-	Resolver resolver(m_interpreter);
-	resolver.resolve(statements);
+		// stop at a runtime error, after a syntax error keep parsing only to report the rest like a whole program would
+		if (m_hadRuntimeError) { return; }
+		if (m_errors.hadError()) { continue; }
 
-	// Stop if there was a resolution error.
-	if (m_hadError) { return; }
+		// the syntax tree is freed here unless a function or class holds on to it, the interpreter then drops its
+		// resolved locals too
+		if (resolve(statements) && m_modules.link(statements, m_interpreter.locals)) { execute(statements); }
+	}
+}
 
-	// interpret
-	m_interpreter.interpret(statements);
+void Lox::runEvents()
+{
+	if (m_errors.hadError() || m_hadRuntimeError)
+	{
+		m_events.clear();
+		return;
+	}
+
+	try
+	{
+		m_events.run();
+	}
+	catch (RuntimeError& error)
+	{
+		m_events.clear();
+		runtimeError(error);
+	}
+}
+
+void Lox::runtimeError(const RuntimeError& error)
+{
+	m_threads.runtimeError(error);
+	m_hadRuntimeError = true;
 }
 
-void Lox::Report(const size_t line, const std::string& where, const std::string& message)
+void Lox::printFusionStatistics(std::ostream& out) const
 {
-	std::cerr << "[line " << line << "] Error" << where << ": " << message << "\n";
-	m_hadError = true;
+	FusionPass::PrintStatistics(out, m_interpreter.fusionStatistics);
 }
 
+void Lox::printJitStatistics(std::ostream& out) const
+{
+	if (m_interpreter.jit != nullptr) { m_interpreter.jit->printStatistics(out); }
+}
@@ -0,0 +1,64 @@
+#include "loxArray.h"
+
+#include <cmath>
+
+#include "RuntimeError.h"
+
+
+namespace
+{
+	// the index of an element, which must exist
+	size_t Index(const LoxArray& array, const object_t& index)
+	{
+		if (!is<double>(index)) { throw NativeError("Array index must be a number."); }
+
+		const double value = as<double>(index);
+		if (value != std::floor(value)) { throw NativeError("Array index must be a whole number."); }
+		if (value < 0 || value >= static_cast<double>(array.elements.size())) { throw NativeError("Array index out of bounds."); }
+		return static_cast<size_t>(value);
+	}
+}
+
+
+const std::array<LoxArray::Method, 5> LoxArray::methods = { {
+	{ "get", 1, [](LoxArray& array, const std::vector<object_t>& arguments) -> object_t
+	{
+		return array.elements[Index(array, arguments[0])];
+	} },
+	{ "set", 2, [](LoxArray& array, const std::vector<object_t>& arguments) -> object_t
+	{
+		array.elements[Index(array, arguments[0])] = arguments[1];
+		return arguments[1];
+	} },
+	{ "push", 1, [](LoxArray& array, const std::vector<object_t>& arguments) -> object_t
+	{
+		array.elements.push_back(arguments[0]);
+		return static_cast<double>(array.elements.size());
+	} },
+	{ "pop", 0, [](LoxArray& array, const std::vector<object_t>&) -> object_t
+	{
+		if (array.elements.empty()) { throw NativeError("Can't pop from an empty array."); }
+
+		object_t last = std::move(array.elements.back());
+		array.elements.pop_back();
+		return last;
+	} },
+	{ "length", 0, [](LoxArray& array, const std::vector<object_t>&) -> object_t
+	{
+		return static_cast<double>(array.elements.size());
+	} }
+} };
+
+std::string LoxArray::toString() const
+{
+	return printOnce("[...]", [this]
+	{
+		std::string text = "[";
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			if (i > 0) { text += ", "; }
+			text += ::toString(elements[i]);
+		}
+		return text + "]";
+	});
+}
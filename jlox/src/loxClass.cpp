@@ -6,7 +6,7 @@
 #include "loxInstance.h"
 #include "object.h"
 
-LoxClass::LoxClass(std::string name, std::shared_ptr<LoxClass> superclass, std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods) :
+LoxClass::LoxClass(std::string name, std::shared_ptr<LoxClass> superclass, StringMap<std::shared_ptr<LoxFunction>> methods) :
 	name(std::move(name)),
 	superclass(std::move(superclass)),
 	m_methods(std::move(methods))
@@ -17,12 +17,12 @@ bool LoxClass::operator==(const LoxClass& klass) const
 	return klass.name == name;
 }
 
-std::shared_ptr<LoxFunction> LoxClass::findMethod(const std::string& methodName) const
+std::shared_ptr<LoxFunction> LoxClass::findMethod(const std::string_view methodName) const
 {
 	// try to find function in current class
-	if (m_methods.contains(methodName))
+	if (const auto it = m_methods.find(methodName); it != m_methods.end())
 	{
-		return m_methods.at(methodName);
+		return it->second;
 	}
 
 	// resort to parent class
@@ -28,6 +28,11 @@ std::shared_ptr<LoxFunction> LoxFunction::bind(const LoxInstance& instance) cons
 
 object_t LoxFunction::call(Interpreter* interpreter, const std::vector<object_t>& arguments) const
 {
+	if (interpreter->jit != nullptr && !m_isInitializer)
+	{
+		if (std::optional<object_t> result = interpreter->jit->call(m_declaration, arguments)) { return std::move(*result); }
+	}
+
 	auto environment = newShared<Environment>(m_closure);
 
 	for (size_t i = 0; i < m_declaration->params.size(); i++)
@@ -9,9 +9,9 @@ LoxInstance::LoxInstance(std::shared_ptr<LoxClass> klass) : m_class(std::move(kl
 object_t LoxInstance::get(const Token& name)
 {
 	// field
-	if (m_fields.contains(name.lexeme))
+	if (const auto it = m_fields.find(name.lexeme); it != m_fields.end())
 	{
-		return m_fields.at(name.lexeme);
+		return it->second;
 	}
 
 	// method
@@ -21,11 +21,16 @@ object_t LoxInstance::get(const Token& name)
 		return method->bind(*this);
 	}
 
-	throw RuntimeError(name, "Undefined property '" + name.lexeme + "'.");
+	throw RuntimeError(name, "Undefined property '" + std::string(name.lexeme) + "'.");
 }
 
 void LoxInstance::set(const Token& name, const object_t& value)
 {
-	m_fields.insert_or_assign(name.lexeme, value);
+	if (const auto it = m_fields.find(name.lexeme); it != m_fields.end())
+	{
+		it->second = value;
+		return;
+	}
+	m_fields.emplace(name.lexeme, value);
 }
 
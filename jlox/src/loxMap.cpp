@@ -0,0 +1,268 @@
+#include "loxMap.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "loxArray.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define LOX_MAP_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+	constexpr size_t GROUP = 16;
+	constexpr int8_t EMPTY = -128;
+	constexpr int8_t DELETED = -2;
+
+	// the control bytes of one group as bit masks, bit i for entry i
+	class Group
+	{
+	public:
+		explicit Group(const int8_t* control) :
+#if defined(LOX_MAP_SSE2)
+			m_control(_mm_loadu_si128(reinterpret_cast<const __m128i*>(control)))
+#else
+			m_control(control)
+#endif
+		{}
+
+#if defined(LOX_MAP_SSE2)
+		uint32_t match(const int8_t h2) const { return Mask(_mm_cmpeq_epi8(m_control, _mm_set1_epi8(h2))); }
+		uint32_t matchEmpty() const { return Mask(_mm_cmpeq_epi8(m_control, _mm_set1_epi8(EMPTY))); }
+
+		// full entries have the sign bit clear
+		uint32_t matchFree() const { return Mask(m_control); }
+
+	private:
+		static uint32_t Mask(const __m128i bytes) { return static_cast<uint32_t>(_mm_movemask_epi8(bytes)); }
+
+		__m128i m_control;
+#else
+		uint32_t match(const int8_t h2) const { return Mask([h2](const int8_t c) { return c == h2; }); }
+		uint32_t matchEmpty() const { return Mask([](const int8_t c) { return c == EMPTY; }); }
+		uint32_t matchFree() const { return Mask([](const int8_t c) { return c < 0; }); }
+
+	private:
+		template <typename Predicate>
+		uint32_t Mask(const Predicate& predicate) const
+		{
+			uint32_t mask = 0;
+			for (size_t i = 0; i < GROUP; i++)
+			{
+				if (predicate(m_control[i])) { mask |= 1u << i; }
+			}
+			return mask;
+		}
+
+		const int8_t* m_control;
+#endif
+	};
+
+	// consistent with IsEqual: numbers, strings and booleans by value, objects by address. The upper bits choose the
+	// group to start at, the lowest seven are kept in the control byte
+	uint64_t Hash(const object_t& key)
+	{
+		uint64_t hash = 0;
+		if (is<double>(key))
+		{
+			// 0 == -0
+			const double number = as<double>(key);
+			hash = std::hash<double>()(number == 0 ? 0.0 : number);
+		}
+		else if (is<std::string>(key)) { hash = std::hash<std::string_view>()(std::get<std::string>(key)); }
+		else if (is<bool>(key)) { hash = as<bool>(key) ? 1 : 2; }
+		else if (is<std::shared_ptr<LoxInstance>>(key)) { hash = reinterpret_cast<uintptr_t>(std::get<std::shared_ptr<LoxInstance>>(key).get()); }
+		else if (is<std::shared_ptr<LoxCallable>>(key)) { hash = reinterpret_cast<uintptr_t>(std::get<std::shared_ptr<LoxCallable>>(key).get()); }
+		else if (is<std::shared_ptr<LoxClass>>(key)) { hash = reinterpret_cast<uintptr_t>(std::get<std::shared_ptr<LoxClass>>(key).get()); }
+		else if (is<std::shared_ptr<LoxFunction>>(key)) { hash = reinterpret_cast<uintptr_t>(std::get<std::shared_ptr<LoxFunction>>(key).get()); }
+
+		// the standard hashes of numbers and addresses may leave the low bits alike, mix them (murmur3's finalizer)
+		hash += key.index();
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdull;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	int8_t H2(const uint64_t hash)
+	{
+		return static_cast<int8_t>(hash & 0x7F);
+	}
+
+	// groups are probed at triangular distances from the first, which visits every group of a power of two
+	class Probe
+	{
+	public:
+		Probe(const uint64_t hash, const size_t capacity) : m_mask(capacity / GROUP - 1), m_group((hash >> 7) & m_mask)
+		{}
+
+		size_t offset() const { return m_group * GROUP; }
+		void next() { m_group = (m_group + ++m_step) & m_mask; }
+
+	private:
+		size_t m_mask;
+		size_t m_group;
+		size_t m_step = 0;
+	};
+
+	// the first entry free for a key with this hash, there must be one
+	size_t FreeEntry(const int8_t* control, const size_t capacity, const uint64_t hash)
+	{
+		for (Probe probe(hash, capacity); ; probe.next())
+		{
+			if (const uint32_t free = Group(control + probe.offset()).matchFree(); free != 0)
+			{
+				return probe.offset() + std::countr_zero(free);
+			}
+		}
+	}
+}
+
+
+const std::array<LoxMap::Method, 6> LoxMap::methods = { {
+	{ "get", 1, [](LoxMap& map, const std::vector<object_t>& arguments) -> object_t
+	{
+		const object_t* value = map.find(arguments[0]);
+		return value != nullptr ? *value : object_t();
+	} },
+	{ "set", 2, [](LoxMap& map, const std::vector<object_t>& arguments) -> object_t
+	{
+		map.insert(arguments[0], arguments[1]);
+		return arguments[1];
+	} },
+	{ "has", 1, [](LoxMap& map, const std::vector<object_t>& arguments) -> object_t
+	{
+		return map.find(arguments[0]) != nullptr;
+	} },
+	{ "delete", 1, [](LoxMap& map, const std::vector<object_t>& arguments) -> object_t
+	{
+		return map.erase(arguments[0]);
+	} },
+	{ "size", 0, [](LoxMap& map, const std::vector<object_t>&) -> object_t
+	{
+		return static_cast<double>(map.size());
+	} },
+	{ "keys", 0, [](LoxMap& map, const std::vector<object_t>&) -> object_t
+	{
+		auto keys = newShared<LoxArray>();
+		keys->elements.reserve(map.size());
+		map.forEach([&keys](const object_t& key, const object_t&) { keys->elements.push_back(key); });
+		return std::static_pointer_cast<LoxInstance>(keys);
+	} }
+} };
+
+std::string LoxMap::toString() const
+{
+	return printOnce("{...}", [this]
+	{
+		std::string text = "{";
+		forEach([&text](const object_t& key, const object_t& value)
+		{
+			if (text.size() > 1) { text += ", "; }
+			text += ::toString(key) + ": " + ::toString(value);
+		});
+		return text + "}";
+	});
+}
+
+const object_t* LoxMap::find(const object_t& key) const
+{
+	const size_t i = index(key, Hash(key));
+	return i != m_capacity ? &m_entries[i].value : nullptr;
+}
+
+void LoxMap::insert(const object_t& key, object_t value)
+{
+	const uint64_t hash = Hash(key);
+	if (const size_t i = index(key, hash); i != m_capacity)
+	{
+		m_entries[i].value = std::move(value);
+		return;
+	}
+
+	// at most 7/8 full, counting deleted entries, so every probe ends at an empty one. A table grown or cleaned up is
+	// at most 7/16 full
+	if ((m_size + m_deleted + 1) * 8 > m_capacity * 7)
+	{
+		size_t capacity = std::max(m_capacity, GROUP);
+		while ((m_size + 1) * 16 > capacity * 7) { capacity *= 2; }
+		rehash(capacity);
+	}
+
+	const size_t i = FreeEntry(m_control.get(), m_capacity, hash);
+	if (m_control[i] == DELETED) { m_deleted--; }
+	m_control[i] = H2(hash);
+	m_entries[i] = { key, std::move(value) };
+	m_size++;
+}
+
+bool LoxMap::erase(const object_t& key)
+{
+	const size_t i = index(key, Hash(key));
+	if (i == m_capacity) { return false; }
+
+	m_entries[i] = {};
+	m_size--;
+
+	// lookups stop at the first group with an empty entry, so no key was placed past a group that has one and the
+	// entry can be emptied, in a full group it has to stay in the way
+	if (Group(&m_control[i / GROUP * GROUP]).matchEmpty() != 0)
+	{
+		m_control[i] = EMPTY;
+	}
+	else
+	{
+		m_control[i] = DELETED;
+		m_deleted++;
+	}
+	return true;
+}
+
+size_t LoxMap::index(const object_t& key, const uint64_t hash) const
+{
+	if (m_capacity == 0) { return m_capacity; }
+
+	const int8_t h2 = H2(hash);
+	for (Probe probe(hash, m_capacity); ; probe.next())
+	{
+		const Group group(&m_control[probe.offset()]);
+		for (uint32_t matches = group.match(h2); matches != 0; matches &= matches - 1)
+		{
+			const size_t i = probe.offset() + std::countr_zero(matches);
+			if (IsEqual(m_entries[i].key, key)) { return i; }
+		}
+		if (group.matchEmpty() != 0) { return m_capacity; }
+	}
+}
+
+void LoxMap::rehash(const size_t capacity)
+{
+	std::unique_ptr<int8_t[]> control = std::move(m_control);
+	std::unique_ptr<Entry[]> entries = std::move(m_entries);
+	const size_t previous = m_capacity;
+
+	m_control = std::make_unique<int8_t[]>(capacity);
+	std::fill_n(m_control.get(), capacity, EMPTY);
+	m_entries = std::make_unique<Entry[]>(capacity);
+	m_capacity = capacity;
+	m_deleted = 0;
+
+	for (size_t i = 0; i < previous; i++)
+	{
+		if (control[i] < 0) { continue; }
+
+		const uint64_t hash = Hash(entries[i].key);
+		const size_t to = FreeEntry(m_control.get(), m_capacity, hash);
+		m_control[to] = H2(hash);
+		m_entries[to] = std::move(entries[i]);
+	}
+}
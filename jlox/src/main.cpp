@@ -1,34 +1,99 @@
+#include <charconv>
+#include <cstring>
 #include <iostream>
 
 #include "lox.h"
 
 
+int Usage()
+{
+	std::cout << "Usage: jlox [--engine=interpreter|closure|flat] [-O0|-O1] [--fusion-stats] [--dump-specializations] [--jit] [--jit-threshold=calls] [--jit-stats] [--emit-cpp=file] [--stream] [--cache-dir=directory] [--snapshot-out=file] [--snapshot-in=file] [--flush=line|full] [script]";
+	return 64;
+}
+
+// a whole number of at least one, without a sign or spaces, that fits
+bool ParseCount(const char* text, size_t& count)
+{
+	const char* end = text + strlen(text);
+	size_t value = 0;
+	const auto [last, error] = std::from_chars(text, end, value);
+	if (error != std::errc() || last != end || value == 0) { return false; }
+
+	count = value;
+	return true;
+}
+
 int main(const int argc, char** argv)
 {
+	Lox::Options options;
+	const char* script = nullptr;
 
-	if (argc > 2)
+	for (int i = 1; i < argc; i++)
 	{
-		std::cout << "Usage: jlox [script]";
-		return 64;
+		const char* arg = argv[i];
+
+		if (strcmp(arg, "--engine=interpreter") == 0) { options.engine = Lox::Engine::INTERPRETER; }
+		else if (strcmp(arg, "--engine=closure") == 0) { options.engine = Lox::Engine::CLOSURE; }
+		else if (strcmp(arg, "--engine=flat") == 0) { options.engine = Lox::Engine::FLAT; }
+		else if (strcmp(arg, "-O0") == 0) { options.optimizationLevel = 0; }
+		else if (strcmp(arg, "-O1") == 0) { options.optimizationLevel = 1; }
+		else if (strcmp(arg, "--fusion-stats") == 0) { options.fusionStatistics = true; }
+		else if (strcmp(arg, "--dump-specializations") == 0) { options.dumpSpecializations = true; }
+		else if (strcmp(arg, "--jit") == 0) { options.jit = true; }
+		else if (strncmp(arg, "--jit-threshold=", 16) == 0)
+		{
+			if (!ParseCount(arg + 16, options.jitThreshold)) { return Usage(); }
+		}
+		else if (strcmp(arg, "--jit-stats") == 0) { options.jitStatistics = true; }
+		else if (strncmp(arg, "--emit-cpp=", 11) == 0) { options.emitCpp = arg + 11; }
+		else if (strcmp(arg, "--stream") == 0) { options.stream = true; }
+		else if (strncmp(arg, "--cache-dir=", 12) == 0) { options.cacheDirectory = arg + 12; }
+		else if (strncmp(arg, "--snapshot-out=", 15) == 0) { options.snapshotOut = arg + 15; }
+		else if (strncmp(arg, "--snapshot-in=", 14) == 0) { options.snapshotIn = arg + 14; }
+		else if (strcmp(arg, "--flush=line") == 0) { options.flush = OutputSink::Flush::EACH_LINE; }
+		else if (strcmp(arg, "--flush=full") == 0) { options.flush = OutputSink::Flush::WHEN_FULL; }
+		else if (arg[0] == '-' || script != nullptr) { return Usage(); }
+		else { script = arg; }
 	}
 
-	if (argc == 2)
+	// the prompt has no whole program to translate
+	if (!options.emitCpp.empty() && script == nullptr) { return Usage(); }
+
+	// snapshots hold the interpreter's heap after a whole script, and only one script's functions
+	const bool snapshots = !options.snapshotOut.empty() || !options.snapshotIn.empty();
+	if (snapshots && (options.engine != Lox::Engine::INTERPRETER || options.stream || !options.emitCpp.empty())) { return Usage(); }
+	if (!options.snapshotOut.empty() && (script == nullptr || strcmp(script, "test") == 0 || !options.snapshotIn.empty())) { return Usage(); }
+
+	if (options.jit && !Jit::supported) { std::cerr << "warning: the JIT only supports x86-64 Linux, running without it\n"; }
+
+	Lox lox(options);
+
+	if (!options.snapshotIn.empty())
+	{
+		if (const int code = lox.loadSnapshot(options.snapshotIn.c_str()); code != 0) { return code; }
+	}
+
+	int code;
+	if (script != nullptr)
 	{
 		// nts: not elegant
-		if (strcmp(argv[1], "test") == 0)
+		if (strcmp(script, "test") == 0)
 		{
-			Lox::RunPrompt(false);
+			code = lox.runPrompt(false);
 		}
 		else
 		{
-			Lox::RunFile(argv[1]);
+			code = lox.runFile(script);
 		}
 	}
 	else
 	{
-		Lox::RunPrompt();
+		code = lox.runPrompt();
 	}
 
-	return 0;
-}
+	// also printed when the script exits with an error
+	if (options.fusionStatistics) { lox.printFusionStatistics(std::cerr); }
+	if (options.jitStatistics) { lox.printJitStatistics(std::cerr); }
 
+	return code;
+}
@@ -0,0 +1,291 @@
+#include "modules.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <system_error>
+#include <unordered_set>
+
+#include "astRewriter.h"
+#include "natives.h"
+#include "parser.h"
+#include "programCache.h"
+#include "resolver.h"
+#include "scanner.h"
+#include "threadPool.h"
+
+
+namespace
+{
+	bool IsNative(const std::string_view name)
+	{
+		static const std::unordered_set<std::string_view> natives = []
+		{
+			std::unordered_set<std::string_view> names;
+			for (const auto& [name, native] : CreateNatives()) { names.insert(name); }
+			return names;
+		}();
+		return natives.contains(name);
+	}
+
+	// the value of the path token, without its quotes
+	std::string_view ImportPath(const Stmt::Import& import)
+	{
+		return import.path.lexeme.substr(1, import.path.lexeme.size() - 2);
+	}
+
+	// the names a module defines at its top level
+	std::vector<std::string_view> Declarations(const std::vector<std::shared_ptr<Stmt>>& statements)
+	{
+		std::vector<std::string_view> names;
+		std::unordered_set<std::string_view> seen;
+		for (const auto& statement : statements)
+		{
+			std::string_view name;
+			if (const auto* var = dynamic_cast<const Stmt::Var*>(statement.get())) { name = var->name.lexeme; }
+			else if (const auto* function = dynamic_cast<const Stmt::Function*>(statement.get())) { name = function->name.lexeme; }
+			else if (const auto* declaration = dynamic_cast<const Stmt::Class*>(statement.get())) { name = declaration->name.lexeme; }
+			else { continue; }
+
+			if (seen.insert(name).second) { names.push_back(name); }
+		}
+		return names;
+	}
+
+	// prefixes every global name of a resolved module, the declarations at its top level and every variable the
+	// resolver left to the globals, including the built-in functions, which the module then defines for itself
+	class Namespace final : public AstRewriter
+	{
+	public:
+		Namespace(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, std::function<std::string_view(std::string_view)> global) :
+			m_locals(locals),
+			m_global(std::move(global))
+		{}
+
+		std::unordered_set<std::string_view> natives; // the built-in functions referred to, without their prefix
+
+		void declarations(const std::vector<std::shared_ptr<Stmt>>& statements)
+		{
+			for (const auto& statement : statements)
+			{
+				if (auto* var = dynamic_cast<Stmt::Var*>(statement.get())) { prefix(var->name); }
+				else if (auto* function = dynamic_cast<Stmt::Function*>(statement.get())) { prefix(function->name); }
+				else if (auto* declaration = dynamic_cast<Stmt::Class*>(statement.get())) { prefix(declaration->name); }
+			}
+		}
+
+		void visitClassStmt(Stmt::Class& stmt) override
+		{
+			if (stmt.superclass != nullptr) { stmt.superclass->accept(this); }
+			AstRewriter::visitClassStmt(stmt);
+		}
+
+		object_t visitAssignExpr(Expr::Assign& expr) override
+		{
+			global(expr, expr.name);
+			return AstRewriter::visitAssignExpr(expr);
+		}
+
+		object_t visitVariableExpr(Expr::Variable& expr) override
+		{
+			global(expr, expr.name);
+			return {};
+		}
+
+	private:
+		const std::unordered_map<std::shared_ptr<Expr>, size_t>& m_locals;
+		std::function<std::string_view(std::string_view)> m_global;
+
+		void prefix(Token& name)
+		{
+			name.lexeme = m_global(name.lexeme);
+		}
+
+		void global(Expr& expr, Token& name)
+		{
+			if (m_locals.contains(expr.getShared())) { return; }
+
+			if (IsNative(name.lexeme)) { natives.insert(name.lexeme); }
+			prefix(name);
+		}
+	};
+}
+
+std::string_view Modules::Module::global(const std::string_view name)
+{
+	auto [it, inserted] = globals.try_emplace(name);
+	if (inserted) { it->second = names.emplace_back(prefix + std::string(name)); }
+	return it->second;
+}
+
+Modules::Modules(ErrorReporter& errors, std::string cacheDirectory) :
+	m_errors(errors),
+	m_cacheDirectory(std::move(cacheDirectory))
+{}
+
+void Modules::setRoot(const std::filesystem::path& directory)
+{
+	std::error_code error;
+	m_root = std::filesystem::weakly_canonical(std::filesystem::absolute(directory, error), error);
+}
+
+bool Modules::link(std::vector<std::shared_ptr<Stmt>>& statements, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals)
+{
+	const bool imports = std::any_of(statements.begin(), statements.end(), [](const auto& statement) { return dynamic_cast<Stmt::Import*>(statement.get()) != nullptr; });
+	if (!imports) { return true; }
+
+	if (m_root.empty()) { setRoot(std::filesystem::current_path()); }
+
+	// the whole front end of every new module runs here, the pool waits for its threads when it goes out of scope
+	{
+		ThreadPool pool;
+		load(statements, m_root, m_errors, pool);
+		pool.wait();
+	}
+
+	// a module with errors is loaded again the next time it is imported, so a prompt can fix it
+	if (m_errors.hadError())
+	{
+		std::erase_if(m_modules, [](const auto& entry) { return !entry.second->loaded; });
+		return false;
+	}
+
+	std::vector<std::shared_ptr<Stmt>> linked;
+	expand(statements, nullptr, linked, locals);
+	if (m_errors.hadError()) { return false; }
+
+	statements = std::move(linked);
+	return true;
+}
+
+std::pair<Modules::Module*, bool> Modules::find(const std::filesystem::path& directory, const Stmt::Import& import)
+{
+	std::error_code error;
+	const std::filesystem::path path = std::filesystem::weakly_canonical(directory / ImportPath(import), error);
+
+	std::lock_guard lock(m_mutex);
+	auto [it, inserted] = m_modules.try_emplace(path.generic_string());
+	if (inserted)
+	{
+		auto module = std::make_unique<Module>();
+		module->path = path;
+
+		// outside of the root the full path names it
+		const std::filesystem::path relative = path.lexically_relative(m_root);
+		module->name = (relative.empty() || *relative.begin() == "..") ? path.generic_string() : relative.generic_string();
+
+		std::filesystem::path stem = module->name;
+		module->prefix = stem.replace_extension().generic_string() + ".";
+		module->errors = std::make_unique<ErrorReporter>(m_errors, module->name);
+		it->second = std::move(module);
+	}
+	return { it->second.get(), inserted };
+}
+
+void Modules::load(const std::vector<std::shared_ptr<Stmt>>& statements, const std::filesystem::path& directory, ErrorReporter& importer, ThreadPool& pool)
+{
+	for (const auto& statement : statements)
+	{
+		const auto* import = dynamic_cast<const Stmt::Import*>(statement.get());
+		if (import == nullptr) { continue; }
+
+		if (auto [module, inserted] = find(directory, *import); inserted)
+		{
+			pool.submit([this, module, path = import->path, &importer, &pool] { load(*module, path, importer, pool); });
+		}
+	}
+}
+
+void Modules::load(Module& module, const Token& path, ErrorReporter& importer, ThreadPool& pool)
+{
+	module.source = Source::Load(module.path.string().c_str());
+	if (module.source == nullptr)
+	{
+		importer.error(path, "Could not read module.");
+		return;
+	}
+
+	// like a script, a module that was run before skips its front end
+	std::optional<ProgramCache> cache;
+	if (!m_cacheDirectory.empty())
+	{
+		cache.emplace(m_cacheDirectory, module.source->text());
+
+		module.cached = Source::Load(cache->path().c_str());
+		if (module.cached == nullptr || !cache->read(module.cached->text(), module.statements, module.locals))
+		{
+			module.cached = nullptr;
+		}
+	}
+
+	if (module.cached == nullptr)
+	{
+		Scanner scanner(module.source->text(), *module.errors);
+		Parser parser(scanner, *module.errors);
+		module.statements = parser.parse();
+		if (module.errors->hadError()) { return; }
+
+		Resolver resolver(module.locals, *module.errors);
+		resolver.resolve(module.statements);
+		if (module.errors->hadError()) { return; }
+
+		if (cache.has_value()) { cache->write(module.statements, module.locals); }
+	}
+
+	// the declarations as written are the names an import defines
+	module.declarations = Declarations(module.statements);
+
+	Namespace names(module.locals, [&module](const std::string_view name) { return module.global(name); });
+	names.declarations(module.statements);
+	names.rewrite(module.statements);
+	module.natives.assign(names.natives.begin(), names.natives.end());
+
+	module.loaded = true;
+
+	load(module.statements, module.path.parent_path(), *module.errors, pool);
+}
+
+void Modules::expand(const std::vector<std::shared_ptr<Stmt>>& statements, Module* importer, std::vector<std::shared_ptr<Stmt>>& linked, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals)
+{
+	for (const auto& statement : statements)
+	{
+		const auto* import = dynamic_cast<const Stmt::Import*>(statement.get());
+		if (import == nullptr)
+		{
+			linked.push_back(statement);
+			continue;
+		}
+
+		Module& module = *find(importer != nullptr ? importer->path.parent_path() : m_root, *import).first;
+		if (module.linking)
+		{
+			(importer != nullptr ? *importer->errors : m_errors).error(import->path, "Circular import.");
+			continue;
+		}
+
+		const uint32_t line = import->keyword.line;
+		auto define = [&linked, line](const std::string_view name, const std::string_view value)
+		{
+			linked.push_back(newShared<Stmt::Var>(Token(IDENTIFIER, name, line), newShared<Expr::Variable>(Token(IDENTIFIER, value, line))));
+		};
+
+		// the first import runs the module, after the built-in functions it uses are defined in its namespace
+		if (!module.linked)
+		{
+			module.linking = true;
+
+			for (const std::string_view native : module.natives) { define(module.global(native), native); }
+			expand(module.statements, &module, linked, locals);
+			locals.merge(module.locals);
+
+			module.statements.clear();
+			module.linking = false;
+			module.linked = true;
+		}
+
+		for (const std::string_view name : module.declarations)
+		{
+			define(importer != nullptr ? importer->global(name) : name, module.global(name));
+		}
+	}
+}
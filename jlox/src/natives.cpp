@@ -0,0 +1,64 @@
+#include "natives.h"
+
+#include <chrono>
+
+#include "eventLoop.h"
+#include "files.h"
+#include "loxArray.h"
+#include "loxMap.h"
+#include "threads.h"
+
+
+class ClockFunction final : public LoxCallable
+{
+public:
+	object_t call(Interpreter*, const std::vector<object_t>&) const override
+	{
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+	}
+	size_t arity() const override { return 0; }
+};
+
+class ArrayFunction final : public LoxCallable
+{
+public:
+	object_t call(Interpreter*, const std::vector<object_t>&) const override
+	{
+		return std::static_pointer_cast<LoxInstance>(newShared<LoxArray>());
+	}
+	size_t arity() const override { return 0; }
+};
+
+class MapFunction final : public LoxCallable
+{
+public:
+	object_t call(Interpreter*, const std::vector<object_t>&) const override
+	{
+		return std::static_pointer_cast<LoxInstance>(newShared<LoxMap>());
+	}
+	size_t arity() const override { return 0; }
+};
+
+
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateNatives()
+{
+	std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> natives = {
+		{ "clock", newShared<ClockFunction>() },
+		{ "Array", newShared<ArrayFunction>() },
+		{ "Map", newShared<MapFunction>() }
+	};
+
+	for (auto& native : CreateThreadNatives())
+	{
+		natives.push_back(std::move(native));
+	}
+	for (auto& native : CreateAsyncNatives())
+	{
+		natives.push_back(std::move(native));
+	}
+	for (auto& native : CreateFileNatives())
+	{
+		natives.push_back(std::move(native));
+	}
+	return natives;
+}
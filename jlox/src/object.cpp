@@ -1,8 +1,16 @@
 #include "object.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+#include "files.h"
+#include "loxArray.h"
 #include "loxClass.h"
 #include "loxFunction.h"
 #include "loxInstance.h"
+#include "loxMap.h"
+#include "threads.h"
 
 std::string toString(const object_t& o)
 {
@@ -10,17 +18,8 @@ std::string toString(const object_t& o)
 	if (is<std::string>(o)) return as<std::string>(o);
 	if (is<double>(o))
 	{
-		std::string str = std::to_string(as<double>(o));
-
-		// trim lagging zeroes
-		size_t lastNonZero = str.find_last_not_of('0');
-		if (lastNonZero != std::string::npos)
-		{
-			if (str[lastNonZero] == '.') lastNonZero--; // trim trailing '.'
-			str.erase(lastNonZero + 1, str.size() - lastNonZero - 1);
-		}
-
-		return str;
+		char buffer[NUMBER_LENGTH];
+		return std::string(buffer, FormatNumber(as<double>(o), buffer));
 	}
 	if (is<bool>(o)) return as<bool>(o) ? "true" : "false";
 	if (is<std::shared_ptr<LoxCallable>>(o))
@@ -29,17 +28,47 @@ std::string toString(const object_t& o)
 		p = as<std::shared_ptr<LoxCallable>>(o).get();
 		if (const auto* pp = dynamic_cast<LoxFunction*>(p); pp != nullptr)
 		{
-			return "<fn " + pp->getDeclaration()->name.lexeme + ">";
+			return "<fn " + std::string(pp->getDeclaration()->name.lexeme) + ">";
 		}
 		return "<native fn>";
 	}
 	if (is<std::shared_ptr<LoxClass>>(o)) return as<std::shared_ptr<LoxClass>>(o)->name;
-	if (is<std::shared_ptr<LoxInstance>>(o)) return as<std::shared_ptr<LoxInstance>>(o)->getClass().name + " instance";
+	if (is<std::shared_ptr<LoxInstance>>(o))
+	{
+		if (const auto* array = dynamic_cast<const LoxArray*>(as<std::shared_ptr<LoxInstance>>(o).get())) return array->toString();
+		if (const auto* map = dynamic_cast<const LoxMap*>(as<std::shared_ptr<LoxInstance>>(o).get())) return map->toString();
+		if (dynamic_cast<const Channel*>(as<std::shared_ptr<LoxInstance>>(o).get()) != nullptr) return "<channel>";
+		if (dynamic_cast<const InputFile*>(as<std::shared_ptr<LoxInstance>>(o).get()) != nullptr) return "<file>";
+		return as<std::shared_ptr<LoxInstance>>(o)->getClass().name + " instance";
+	}
 	if (is<std::shared_ptr<LoxFunction>>(o)) return "<LoxFunction>";
 
 	return R"(<???>)";
 }
 
+char* FormatNumber(const double number, char* first)
+{
+	char* const end = first + NUMBER_LENGTH;
+
+	// the fewest digits that read back as the same number, written out in full from 1e-7 to 1e21 like JavaScript does,
+	// so whole numbers have no fraction and 0.1 + 0.2 is not mistaken for 0.3
+	const double magnitude = std::abs(number);
+	if (magnitude == 0 || (magnitude >= 1e-7 && magnitude < 1e21) || !std::isfinite(number))
+	{
+		return std::to_chars(first, end, number, std::chars_format::fixed).ptr;
+	}
+
+	// 1e+21 and 1.5e-8, without the zero the exponent is padded to two digits with
+	char* last = std::to_chars(first, end, number, std::chars_format::scientific).ptr;
+	char* exponent = std::find(first, last, 'e') + 2;
+	if (*exponent == '0')
+	{
+		std::copy(exponent + 1, last, exponent);
+		last--;
+	}
+	return last;
+}
+
 bool IsNull(const object_t& o)
 {
 #if defined(OBJECT_IS_ANY)
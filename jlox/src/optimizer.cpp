@@ -0,0 +1,145 @@
+#include "optimizer.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	template <typename T>
+	T* As(const std::shared_ptr<Expr>& expr)
+	{
+		return dynamic_cast<T*>(expr.get());
+	}
+
+	template <typename T>
+	T* As(const std::shared_ptr<Stmt>& stmt)
+	{
+		return dynamic_cast<T*>(stmt.get());
+	}
+
+	const object_t* ConstantOf(const std::shared_ptr<Expr>& expr)
+	{
+		const auto* literal = As<Expr::Literal>(expr);
+		return literal != nullptr ? &literal->value : nullptr;
+	}
+
+	std::shared_ptr<Expr> Fold(object_t value)
+	{
+		return newShared<Expr::Literal>(std::move(value));
+	}
+
+	// a block without statements, removed from the statement list it ends up in
+	std::shared_ptr<Stmt> Nothing()
+	{
+		return newShared<Stmt::Block>(std::vector<std::shared_ptr<Stmt>>{});
+	}
+
+	bool IsNothing(const std::shared_ptr<Stmt>& stmt)
+	{
+		const auto* block = As<Stmt::Block>(stmt);
+		return block != nullptr && block->statements.empty();
+	}
+
+	std::shared_ptr<Expr> FoldBinary(const Expr::Binary& binary)
+	{
+		const object_t* left = ConstantOf(binary.left);
+		const object_t* right = ConstantOf(binary.right);
+		if (left == nullptr || right == nullptr) return nullptr;
+
+		switch (binary.op.type)
+		{
+		case BANG_EQUAL: return Fold(!IsEqual(*left, *right));
+		case EQUAL_EQUAL: return Fold(IsEqual(*left, *right));
+		case PLUS:
+			if (is<std::string>(*left) && is<std::string>(*right)) return Fold(as<std::string>(*left) + as<std::string>(*right));
+			break;
+		default:
+			break;
+		}
+
+		// everything else only works on numbers, anything else has to raise its error at runtime
+		if (!is<double>(*left) || !is<double>(*right)) return nullptr;
+		const double a = as<double>(*left);
+		const double b = as<double>(*right);
+
+		switch (binary.op.type)
+		{
+		case GREATER: return Fold(a > b);
+		case GREATER_EQUAL: return Fold(a >= b);
+		case LESS: return Fold(a < b);
+		case LESS_EQUAL: return Fold(a <= b);
+		case MINUS: return Fold(a - b);
+		case PLUS: return Fold(a + b);
+		case SLASH: return Fold(a / b);
+		case STAR: return Fold(a * b);
+		default: return nullptr;
+		}
+	}
+
+	std::shared_ptr<Expr> FoldUnary(const Expr::Unary& unary)
+	{
+		const object_t* right = ConstantOf(unary.right);
+		if (right == nullptr) return nullptr;
+
+		switch (unary.op.type)
+		{
+		case BANG: return Fold(!IsTruthy(*right));
+		case MINUS: return is<double>(*right) ? Fold(-as<double>(*right)) : nullptr;
+		default: return nullptr;
+		}
+	}
+
+	// and/or with a constant left operand evaluate to either operand
+	std::shared_ptr<Expr> FoldLogical(const Expr::Logical& logical)
+	{
+		const object_t* left = ConstantOf(logical.left);
+		if (left == nullptr) return nullptr;
+
+		const bool shortCircuits = logical.op.type == OR ? IsTruthy(*left) : !IsTruthy(*left);
+		return shortCircuits ? logical.left : logical.right;
+	}
+}
+
+
+void Optimizer::rewrite(std::vector<std::shared_ptr<Stmt>>& stmts)
+{
+	AstRewriter::rewrite(stmts);
+
+	// statements after a return are unreachable
+	const auto returns = std::ranges::find_if(stmts, [](const auto& stmt) { return As<Stmt::Return>(stmt) != nullptr; });
+	if (returns != stmts.end()) { stmts.erase(returns + 1, stmts.end()); }
+
+	std::erase_if(stmts, IsNothing);
+}
+
+std::shared_ptr<Stmt> Optimizer::transform(const std::shared_ptr<Stmt>& stmt)
+{
+	if (const auto* expression = As<Stmt::Expression>(stmt))
+	{
+		// evaluating a constant has no effect
+		if (ConstantOf(expression->expression) != nullptr) return Nothing();
+	}
+	else if (const auto* branch = As<Stmt::If>(stmt))
+	{
+		if (const object_t* condition = ConstantOf(branch->condition))
+		{
+			const std::shared_ptr<Stmt>& taken = IsTruthy(*condition) ? branch->thenBranch : branch->elseBranch;
+			return taken != nullptr ? taken : Nothing();
+		}
+	}
+	else if (const auto* loop = As<Stmt::While>(stmt))
+	{
+		const object_t* condition = ConstantOf(loop->condition);
+		if (condition != nullptr && !IsTruthy(*condition)) return Nothing();
+	}
+	return nullptr;
+}
+
+std::shared_ptr<Expr> Optimizer::transform(const std::shared_ptr<Expr>& expr)
+{
+	if (const auto* binary = As<Expr::Binary>(expr)) return FoldBinary(*binary);
+	if (const auto* grouping = As<Expr::Grouping>(expr)) return grouping->expression;
+	if (const auto* logical = As<Expr::Logical>(expr)) return FoldLogical(*logical);
+	if (const auto* unary = As<Expr::Unary>(expr)) return FoldUnary(*unary);
+	return nullptr;
+}
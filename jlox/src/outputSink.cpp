@@ -0,0 +1,156 @@
+#include "outputSink.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <cerrno>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	constexpr int STANDARD_OUTPUT = 1;
+
+	bool IsTerminal(const int descriptor)
+	{
+#if defined(_WIN32)
+		return _isatty(descriptor) != 0;
+#else
+		return isatty(descriptor) != 0;
+#endif
+	}
+
+	// both parts in order, the output is dropped once standard output was closed like the stream would drop it
+	void WriteAll(const int descriptor, std::string_view first, std::string_view second)
+	{
+#if defined(_WIN32)
+		for (std::string_view part : { first, second })
+		{
+			while (!part.empty())
+			{
+				const int written = _write(descriptor, part.data(), static_cast<unsigned>(std::min<size_t>(part.size(), INT_MAX)));
+				if (written <= 0) { return; }
+				part.remove_prefix(static_cast<size_t>(written));
+			}
+		}
+#else
+		iovec parts[2] = {
+			{ const_cast<char*>(first.data()), first.size() },
+			{ const_cast<char*>(second.data()), second.size() }
+		};
+		iovec* part = parts;
+		int count = 2;
+		size_t written = 0;
+
+		while (true)
+		{
+			// past the parts written, a short write continues where it stopped
+			while (count > 0 && written >= part->iov_len)
+			{
+				written -= part->iov_len;
+				part++;
+				count--;
+			}
+			if (count == 0) { return; }
+
+			part->iov_base = static_cast<char*>(part->iov_base) + written;
+			part->iov_len -= written;
+
+			const ssize_t result = writev(descriptor, part, count);
+			if (result < 0 && errno != EINTR) { return; }
+			written = result < 0 ? 0 : static_cast<size_t>(result);
+		}
+#endif
+	}
+}
+
+
+OutputSink::OutputSink(std::ostream& stream) :
+	policy(Flush::WHEN_FULL),
+	m_stream(stream),
+	m_buffer(std::make_unique_for_overwrite<char[]>(CAPACITY))
+{
+	// only std::cout is known to write to a file descriptor
+	if (&stream == &std::cout)
+	{
+		m_descriptor = STANDARD_OUTPUT;
+		if (IsTerminal(m_descriptor)) { policy = Flush::EACH_LINE; }
+	}
+}
+
+OutputSink::~OutputSink()
+{
+	flush();
+}
+
+void OutputSink::print(const object_t& value)
+{
+	if (is<std::string>(value)) { write(std::get<std::string>(value)); }
+	else if (is<double>(value))
+	{
+		char* first = reserve(NUMBER_LENGTH);
+		m_size += static_cast<size_t>(FormatNumber(as<double>(value), first) - first);
+	}
+	else if (is<bool>(value)) { write(as<bool>(value) ? "true" : "false"); }
+	else if (IsNull(value)) { write("nil"); }
+	else { write(toString(value)); }
+
+	endLine();
+}
+
+void OutputSink::write(const std::string_view text)
+{
+	if (text.size() > CAPACITY - m_size)
+	{
+		// the buffer is full, a long text is written along with it instead of being copied in pieces
+		flush(text);
+		return;
+	}
+
+	std::memcpy(&m_buffer[m_size], text.data(), text.size());
+	m_size += text.size();
+}
+
+void OutputSink::flush()
+{
+	flush({});
+}
+
+char* OutputSink::reserve(const size_t length)
+{
+	if (length > CAPACITY - m_size) { flush(); }
+	return &m_buffer[m_size];
+}
+
+void OutputSink::flush(const std::string_view text)
+{
+	const std::string_view buffered(m_buffer.get(), m_size);
+	m_size = 0;
+
+	if (m_descriptor == -1)
+	{
+		m_stream.write(buffered.data(), static_cast<std::streamsize>(buffered.size()));
+		m_stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+		m_stream.flush();
+		return;
+	}
+
+	// whatever was written to the stream itself comes first
+	m_stream.flush();
+	WriteAll(m_descriptor, buffered, text);
+}
+
+void OutputSink::endLine()
+{
+	*reserve(1) = '\n';
+	m_size++;
+
+	if (policy == Flush::EACH_LINE) { flush(); }
+}
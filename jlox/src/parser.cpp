@@ -1,21 +1,35 @@
 #include "parser.h"
 
-#include "lox.h"
+#include <array>
 
 
-Parser::Parser(const std::vector<Token>& tokens) : m_tokens(tokens)
-{}
+Parser::Parser(Scanner& scanner, ErrorReporter& errors) : m_scanner(scanner), m_errors(errors)
+{
+	m_tokens.push_back(m_scanner.next());
+}
 
 std::vector<std::shared_ptr<Stmt>> Parser::parse()
 {
 	std::vector<std::shared_ptr<Stmt>> statements;
 	while (!isAtEnd())
 	{
-		statements.push_back(declaration());
+		statements.push_back(parseDeclaration());
 	}
 	return statements;
 }
 
+std::shared_ptr<Stmt> Parser::parseDeclaration()
+{
+	// the syntax tree holds copies of the tokens it needs, keep only the previous token for error recovery
+	if (m_current > 1)
+	{
+		m_tokens.erase(m_tokens.begin(), m_tokens.begin() + static_cast<ptrdiff_t>(m_current - 1));
+		m_current = 1;
+	}
+
+	return declaration();
+}
+
 
 // statements ------------------------------------------------------
 
@@ -26,6 +40,7 @@ std::shared_ptr<Stmt> Parser::declaration()
 		if (match(CLASS)) return classDeclaration();
 		if (match(FUN)) return function("function");
 		if (match(VAR)) return varDeclaration();
+		if (match(IMPORT)) return importDeclaration();
 		return statement();
 	}
 	catch (ParseError&)
@@ -97,6 +112,15 @@ std::vector<std::shared_ptr<Stmt>> Parser::block()
 	return statements;
 }
 
+std::shared_ptr<Stmt> Parser::importDeclaration()
+{
+	const Token keyword = previous();
+	const Token path = consume(STRING, "Expect module path after 'import'.");
+	consume(SEMICOLON, "Expect ';' after module path.");
+
+	return newShared<Stmt::Import>(keyword, path);
+}
+
 std::shared_ptr<Stmt> Parser::varDeclaration()
 {
 	const Token name = consume(IDENTIFIER, "Expect variable name.");
@@ -258,178 +282,165 @@ std::shared_ptr<Stmt> Parser::expressionStatement()
 
 // expressions -----------------------------------------------------
 
-std::shared_ptr<Expr> Parser::expression()
+namespace
 {
-	return assignment();
+	constexpr std::array<Precedence, END_OF_FILE + 1> CreatePrecedences()
+	{
+		std::array<Precedence, END_OF_FILE + 1> precedences{};
+		precedences[EQUAL] = Precedence::ASSIGNMENT;
+		precedences[OR] = Precedence::OR;
+		precedences[AND] = Precedence::AND;
+		precedences[BANG_EQUAL] = precedences[EQUAL_EQUAL] = Precedence::EQUALITY;
+		precedences[GREATER] = precedences[GREATER_EQUAL] = precedences[LESS] = precedences[LESS_EQUAL] = Precedence::COMPARISON;
+		precedences[MINUS] = precedences[PLUS] = Precedence::TERM;
+		precedences[SLASH] = precedences[STAR] = Precedence::FACTOR;
+		return precedences;
+	}
+
+	constexpr std::array<Precedence, END_OF_FILE + 1> INFIX_PRECEDENCE = CreatePrecedences();
 }
 
-std::shared_ptr<Expr> Parser::assignment()
+// Precedence climbing with explicit stacks instead of a function per precedence level. Operands and operators wait on
+// m_operands and m_operators until an operator that binds less tightly, or the end of the expression, applies them.
+// Every parenthesized expression or argument list opens a frame on m_frames, so nesting costs no native recursion.
+std::shared_ptr<Expr> Parser::expression()
 {
-	std::shared_ptr<Expr> expr = logicOr();
+	m_frames.clear();
+	m_operands.clear();
+	m_operators.clear();
+	m_frames.push_back({ Frame::Kind::EXPRESSION, 0, nullptr, {} });
 
-	if (match(EQUAL))
+	while (true)
 	{
-		const Token equals = previous();
-
-		std::shared_ptr<Expr> value = assignment();
-
-		// variable
-		if (const auto* var = dynamic_cast<Expr::Variable*>(expr.get()); var != nullptr)
+		// prefix operators and an operand
+		while (match(BANG, MINUS))
 		{
-			return newShared<Expr::Assign>(var->name, std::move(value));
+			m_operators.push_back({ &previous(), Precedence::UNARY });
 		}
 
-		// field
-		if (const auto* field = dynamic_cast<Expr::Get*>(expr.get()); field != nullptr)
+		if (match(LEFT_PAREN))
 		{
-			return newShared<Expr::Set>(field->object, field->name, std::move(value));
+			m_frames.push_back({ Frame::Kind::GROUPING, m_operators.size(), nullptr, {} });
+			continue;
 		}
 
-		(void)error(equals, "Invalid assignment target.");
-	}
-
-	return expr;
-}
+		std::shared_ptr<Expr> operand = primary();
 
-std::shared_ptr<Expr> Parser::logicOr()
-{
-	std::shared_ptr<Expr> expr = logicAnd();
-
-	while (match(OR))
-	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = logicAnd();
-		expr = newShared<Expr::Logical>(std::move(expr), op, std::move(right));
-	}
-
-	return expr;
-}
+		// what follows the operand, until an operator or argument needs the next one
+		while (true)
+		{
+			// properties and calls bind tighter than anything else
+			if (match(DOT))
+			{
+				const Token& name = consume(IDENTIFIER, "Expect property name after '.'.");
+				operand = newShared<Expr::Get>(std::move(operand), name);
+				continue;
+			}
 
-std::shared_ptr<Expr> Parser::logicAnd()
-{
-	std::shared_ptr<Expr> expr = equality();
+			if (match(LEFT_PAREN))
+			{
+				if (match(RIGHT_PAREN))
+				{
+					operand = newShared<Expr::Call>(std::move(operand), previous(), std::vector<std::shared_ptr<Expr>>());
+					continue;
+				}
+
+				m_frames.push_back({ Frame::Kind::ARGUMENTS, m_operators.size(), std::move(operand), {} });
+				break;
+			}
 
-	while (match(AND))
-	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = equality();
-		expr = newShared<Expr::Logical>(std::move(expr), op, std::move(right));
-	}
+			m_operands.push_back(std::move(operand));
 
-	return expr;
-}
+			// infix operator, assignment is right associative
+			const Precedence precedence = INFIX_PRECEDENCE[peek().type];
+			if (precedence != Precedence::NONE)
+			{
+				while (m_operators.size() > m_frames.back().operatorBase &&
+					(m_operators.back().precedence > precedence || (m_operators.back().precedence == precedence && precedence != Precedence::ASSIGNMENT)))
+				{
+					reduce();
+				}
+
+				m_operators.push_back({ &advance(), precedence });
+				break;
+			}
 
-std::shared_ptr<Expr> Parser::equality()
-{
-	std::shared_ptr<Expr> expr = comparison();
+			// the end of the innermost frame
+			while (m_operators.size() > m_frames.back().operatorBase) { reduce(); }
 
-	while (match(BANG_EQUAL, EQUAL_EQUAL))
-	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = comparison();
-		expr = newShared<Expr::Binary>(std::move(expr), op, std::move(right));
-	}
+			std::shared_ptr<Expr> result = std::move(m_operands.back());
+			m_operands.pop_back();
 
-	return expr;
-}
-
-std::shared_ptr<Expr> Parser::comparison()
-{
-	std::shared_ptr<Expr> expr = term();
+			Frame& frame = m_frames.back();
+			if (frame.kind == Frame::Kind::EXPRESSION)
+			{
+				return result;
+			}
 
-	while (match(GREATER, GREATER_EQUAL, LESS, LESS_EQUAL))
-	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = term();
-		expr = newShared<Expr::Binary>(std::move(expr), op, std::move(right));
-	}
-	return expr;
-}
+			if (frame.kind == Frame::Kind::GROUPING)
+			{
+				consume(RIGHT_PAREN, "Expect ')' after expression.");
+				operand = newShared<Expr::Grouping>(std::move(result));
+				m_frames.pop_back();
+				continue;
+			}
 
-std::shared_ptr<Expr> Parser::term()
-{
-	std::shared_ptr<Expr> expr = factor();
+			frame.arguments.push_back(std::move(result));
+			if (match(COMMA))
+			{
+				if (frame.arguments.size() >= 8) { (void)error(peek(), "Cannot have more than 8 arguments."); }
+				break;
+			}
 
-	while (match(MINUS, PLUS))
-	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = factor();
-		expr = newShared<Expr::Binary>(std::move(expr), op, std::move(right));
+			const Token& paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
+			operand = newShared<Expr::Call>(std::move(frame.callee), paren, std::move(frame.arguments));
+			m_frames.pop_back();
+		}
 	}
-
-	return expr;
 }
 
-std::shared_ptr<Expr> Parser::factor()
+void Parser::reduce()
 {
-	std::shared_ptr<Expr> expr = unary();
-
-	while (match(SLASH, STAR))
-	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = unary();
-		expr = newShared<Expr::Binary>(std::move(expr), op, std::move(right));
-	}
+	const Operator op = m_operators.back();
+	m_operators.pop_back();
 
-	return expr;
-}
+	std::shared_ptr<Expr> right = std::move(m_operands.back());
+	m_operands.pop_back();
 
-std::shared_ptr<Expr> Parser::unary()
-{
-	if (match(BANG, MINUS))
+	if (op.precedence == Precedence::UNARY)
 	{
-		const Token op = previous();
-		std::shared_ptr<Expr> right = unary();
-		return newShared<Expr::Unary>(op, std::move(right));
+		m_operands.push_back(newShared<Expr::Unary>(*op.token, std::move(right)));
+		return;
 	}
 
-	return call();
-}
-
-std::shared_ptr<Expr> Parser::call()
-{
-	// function( args...)
-
-	std::shared_ptr<Expr> expr = primary();
-
-	while (true)
+	std::shared_ptr<Expr>& left = m_operands.back();
+	switch (op.token->type)
 	{
-		if (match(LEFT_PAREN))
+	case EQUAL:
+		// variable
+		if (const auto* var = dynamic_cast<Expr::Variable*>(left.get()); var != nullptr)
 		{
-			expr = finishCall(std::move(expr));
+			left = newShared<Expr::Assign>(var->name, std::move(right));
 		}
-		else if (match(DOT))
+		// field
+		else if (const auto* field = dynamic_cast<Expr::Get*>(left.get()); field != nullptr)
 		{
-			const Token name = consume(IDENTIFIER, "Expect property name after '.'.");
-			expr = newShared<Expr::Get>(std::move(expr), name);
+			left = newShared<Expr::Set>(field->object, field->name, std::move(right));
 		}
+		// the target is kept as the value of the expression
 		else
 		{
-			break;
+			(void)error(*op.token, "Invalid assignment target.");
 		}
+		break;
+	case OR:
+	case AND:
+		left = newShared<Expr::Logical>(std::move(left), *op.token, std::move(right));
+		break;
+	default:
+		left = newShared<Expr::Binary>(std::move(left), *op.token, std::move(right));
+		break;
 	}
-
-	return expr;
-}
-
-std::shared_ptr<Expr> Parser::finishCall(std::shared_ptr<Expr> callee)
-{
-	// "functionName(" has already been consumed and is in callee,
-	// this function will take care of the arguments and the closing ')'
-
-	std::vector<std::shared_ptr<Expr>> arguments;
-
-	if (!check(RIGHT_PAREN))
-	{
-		do
-		{
-			if (arguments.size() >= 8) { (void)error(peek(), "Cannot have more than 8 arguments."); }
-			arguments.push_back(expression());
-		} while (match(COMMA));
-	}
-	const Token paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
-
-	return newShared<Expr::Call>(std::move(callee), paren, std::move(arguments));
 }
 
 std::shared_ptr<Expr> Parser::primary()
@@ -440,15 +451,15 @@ std::shared_ptr<Expr> Parser::primary()
 
 	if (match(NUMBER, STRING))
 	{
-		return newShared<Expr::Literal>(previous().literal);
+		return newShared<Expr::Literal>(previous().literal());
 	}
 
 	if (match(SUPER))
 	{
-		const Token keyword = previous();
+		const Token& keyword = previous();
 		consume(DOT, "Expect '.' after 'super'.");
 
-		const Token method = consume(IDENTIFIER, "Expect superclass method name.");
+		const Token& method = consume(IDENTIFIER, "Expect superclass method name.");
 
 		return newShared<Expr::Super>(keyword, method);
 	}
@@ -463,21 +474,13 @@ std::shared_ptr<Expr> Parser::primary()
 		return newShared<Expr::Variable>(previous());
 	}
 
-	if (match(LEFT_PAREN))
-	{
-		std::shared_ptr<Expr> expr = expression();
-		consume(RIGHT_PAREN, "Expect ')' after expression.");
-
-		return newShared<Expr::Grouping>(std::move(expr));
-	}
-
 	throw error(peek(), "Expect expression.");
 }
 
 
 // helper functions ------------------------------------------------
 
-Token Parser::consume(const TokenType type, const std::string& message)
+const Token& Parser::consume(const TokenType type, const std::string& message)
 {
 	if (check(type)) return advance();
 
@@ -490,9 +493,13 @@ bool Parser::check(const TokenType type) const
 	return peek().type == type;
 }
 
-Token Parser::advance()
+const Token& Parser::advance()
 {
-	if (!isAtEnd()) m_current++;
+	if (!isAtEnd())
+	{
+		m_current++;
+		if (m_current == m_tokens.size()) { m_tokens.push_back(m_scanner.next()); }
+	}
 	return previous();
 }
 
@@ -501,14 +508,14 @@ bool Parser::isAtEnd() const
 	return peek().type == END_OF_FILE;
 }
 
-Token Parser::peek() const
+const Token& Parser::peek() const
 {
-	return m_tokens.at(m_current);
+	return m_tokens[m_current];
 }
 
-Token Parser::previous() const
+const Token& Parser::previous() const
 {
-	return m_tokens.at(m_current - 1);
+	return m_tokens[m_current - 1];
 }
 
 
@@ -516,7 +523,7 @@ Token Parser::previous() const
 
 ParseError Parser::error(const Token& token, const std::string& message) const
 {
-	Lox::Error(token, message);
+	m_errors.error(token, message);
 	return {};
 }
 
@@ -533,6 +540,7 @@ void Parser::synchronize()
 		case CLASS:
 		case FUN:
 		case VAR:
+		case IMPORT:
 		case FOR:
 		case IF:
 		case WHILE:
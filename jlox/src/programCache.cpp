@@ -0,0 +1,99 @@
+#include "programCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "treeImage.h"
+
+
+namespace
+{
+	// the layout of an entry, all numbers in the byte order of the machine that wrote it:
+	//   header  magic, version, byte order mark, source hash, source size, payload size, payload hash
+	//   payload the program as a syntax tree, see treeImage.h
+	constexpr char MAGIC[8] = { 'J', 'L', 'O', 'X', 'A', 'S', 'T', '\0' };
+	constexpr uint32_t VERSION = 2; // bump with every change to the layout or to the syntax tree
+	constexpr uint32_t ORDER_MARK = 0x01020304;
+	constexpr size_t HEADER_SIZE = 48;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint64_t sourceHash;
+		uint64_t sourceSize;
+		uint64_t payloadSize;
+		uint64_t payloadHash;
+	};
+	static_assert(sizeof(Header) == HEADER_SIZE);
+}
+
+ProgramCache::ProgramCache(const std::string& directory, const std::string_view source) :
+	m_directory(directory),
+	m_sourceHash(ImageHash(source)),
+	m_sourceSize(source.size())
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.jloxc", static_cast<unsigned long long>(m_sourceHash));
+	m_path = (std::filesystem::path(directory) / name).string();
+}
+
+bool ProgramCache::read(const std::string_view image, std::vector<std::shared_ptr<Stmt>>& statements, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) const
+{
+	if (image.size() < HEADER_SIZE) { return false; }
+
+	Header header;
+	memcpy(&header, image.data(), HEADER_SIZE);
+
+	const std::string_view payload = image.substr(HEADER_SIZE);
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.byteOrder != ORDER_MARK) { return false; }
+	if (header.sourceHash != m_sourceHash || header.sourceSize != m_sourceSize) { return false; }
+	if (header.payloadSize != payload.size() || header.payloadHash != ImageHash(payload)) { return false; }
+
+	// the depths are only merged into the interpreter's once the whole entry has been read
+	std::unordered_map<std::shared_ptr<Expr>, size_t> resolved;
+	TreeReader reader(payload, resolved);
+	std::vector<std::shared_ptr<Stmt>> program;
+	if (!reader.statements(program) || !reader.atEnd()) { return false; }
+
+	statements = std::move(program);
+	locals.merge(resolved);
+	return true;
+}
+
+void ProgramCache::write(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) const
+{
+	TreeWriter writer(locals);
+	writer.statements(statements);
+	if (writer.failed) { return; }
+
+	Header header{};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byteOrder = ORDER_MARK;
+	header.sourceHash = m_sourceHash;
+	header.sourceSize = m_sourceSize;
+	header.payloadSize = writer.payload.size();
+	header.payloadHash = ImageHash(writer.payload);
+
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+
+	// written next to the entry and renamed over it, so a run that reads it never sees half a file
+	const std::string temporary = m_path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) { return; }
+
+		out.write(reinterpret_cast<const char*>(&header), HEADER_SIZE);
+		out.write(writer.payload.data(), static_cast<std::streamsize>(writer.payload.size()));
+		if (!out) { out.close(); std::filesystem::remove(temporary, error); return; }
+	}
+
+	std::filesystem::rename(temporary, m_path, error);
+	if (error) { std::filesystem::remove(temporary, error); }
+}
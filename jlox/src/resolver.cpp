@@ -1,8 +1,11 @@
 #include "resolver.h"
 
-#include "lox.h"
+#include "interpreter.h"
 
-Resolver::Resolver(Interpreter& interpreter) : m_interpreter(interpreter)
+Resolver::Resolver(Interpreter& interpreter, ErrorReporter& errors) : m_errors(errors), m_interpreter(&interpreter)
+{}
+
+Resolver::Resolver(std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, ErrorReporter& errors) : m_errors(errors), m_locals(&locals)
 {}
 
 
@@ -38,18 +41,35 @@ object_t Resolver::visitCallExpr(Expr::Call& expr)
 	return {};
 }
 
+object_t Resolver::visitCompareConstantExpr(Expr::CompareConstant&)
+{
+	// fused nodes are created after resolution and already know their depth
+	return {};
+}
+
 object_t Resolver::visitGetExpr(Expr::Get& expr)
 {
 	resolve(expr.object);
 	return {};
 }
 
+object_t Resolver::visitGetChainExpr(Expr::GetChain& expr)
+{
+	resolve(expr.object);
+	return {};
+}
+
 object_t Resolver::visitGroupingExpr(Expr::Grouping& expr)
 {
 	resolve(expr.expression);
 	return {};
 }
 
+object_t Resolver::visitIncrementExpr(Expr::Increment&)
+{
+	return {};
+}
+
 object_t Resolver::visitLiteralExpr(Expr::Literal&)
 {
 	return {};
@@ -62,6 +82,12 @@ object_t Resolver::visitLogicalExpr(Expr::Logical& expr)
 	return {};
 }
 
+object_t Resolver::visitNilCheckExpr(Expr::NilCheck& expr)
+{
+	resolve(expr.operand);
+	return {};
+}
+
 object_t Resolver::visitSetExpr(Expr::Set& expr)
 {
 	resolve(expr.value);
@@ -69,15 +95,21 @@ object_t Resolver::visitSetExpr(Expr::Set& expr)
 	return {};
 }
 
+object_t Resolver::visitSetThisExpr(Expr::SetThis& expr)
+{
+	resolve(expr.value);
+	return {};
+}
+
 object_t Resolver::visitSuperExpr(Expr::Super& expr)
 {
 	if (m_currentClass == ClassType::NONE)
 	{
-		Lox::Error(expr.keyword, "Cannot use 'super' outside of a class.");
+		m_errors.error(expr.keyword, "Cannot use 'super' outside of a class.");
 	}
 	else if (m_currentClass != ClassType::SUBCLASS)
 	{
-		Lox::Error(expr.keyword, "Cannot use 'super' in a class with no superclass.");
+		m_errors.error(expr.keyword, "Cannot use 'super' in a class with no superclass.");
 	}
 
 	// tell the interpreter where to find the baseclass method
@@ -89,7 +121,7 @@ object_t Resolver::visitThisExpr(Expr::This& expr)
 {
 	if (m_currentClass == ClassType::NONE)
 	{
-		Lox::Error(expr.keyword, "Cannot use 'this' outside of a class.");
+		m_errors.error(expr.keyword, "Cannot use 'this' outside of a class.");
 	}
 
 	// tell the interpreter where to find the this pointer
@@ -106,10 +138,10 @@ object_t Resolver::visitUnaryExpr(Expr::Unary& expr)
 object_t Resolver::visitVariableExpr(Expr::Variable& expr)
 {
 	if (!m_scopes.empty() &&
-		m_scopes.top().contains(expr.name.lexeme) &&
-		m_scopes.top().at(expr.name.lexeme) == false)
+		m_scopes.back().contains(expr.name.lexeme) &&
+		m_scopes.back().at(expr.name.lexeme) == false)
 	{
-		Lox::Error(expr.name, "Cannot read local variable in its own initializer.");
+		m_errors.error(expr.name, "Cannot read local variable in its own initializer.");
 	}
 
 	// tell the interpreter where to find the variable
@@ -141,7 +173,7 @@ void Resolver::visitClassStmt(Stmt::Class& stmt)
 		// TODO: check for own name down the whole inheritance chain
 		if (stmt.name.lexeme == stmt.superclass->name.lexeme)
 		{
-			Lox::Error(stmt.superclass->name, "A class can't inherit from itself.");
+			m_errors.error(stmt.superclass->name, "A class can't inherit from itself.");
 			beginScope();
 		}
 		else
@@ -149,12 +181,12 @@ void Resolver::visitClassStmt(Stmt::Class& stmt)
 			resolve(stmt.superclass);
 
 			beginScope();
-			m_scopes.top().insert_or_assign("super", true);
+			m_scopes.back().insert_or_assign("super", true);
 		}
 	}
 
 	beginScope();
-	m_scopes.top().insert_or_assign("this", true);
+	m_scopes.back().insert_or_assign("this", true);
 
 	for (const auto& method : stmt.methods)
 	{
@@ -170,6 +202,19 @@ void Resolver::visitClassStmt(Stmt::Class& stmt)
 	m_currentClass = enclosingClass;
 }
 
+void Resolver::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+{
+	// the scopes of the loop it was specialized from
+	beginScope();
+	resolve(stmt.variable);
+	resolve(stmt.condition);
+	beginScope();
+	resolve(stmt.body);
+	resolve(stmt.increment);
+	endScope();
+	endScope();
+}
+
 void Resolver::visitExpressionStmt(Stmt::Expression& stmt)
 {
 	resolve(stmt.expression);
@@ -193,6 +238,15 @@ void Resolver::visitIfStmt(Stmt::If& stmt)
 	}
 }
 
+void Resolver::visitImportStmt(Stmt::Import& stmt)
+{
+	// a module defines its declarations as globals of the importing script, which are not tracked here
+	if (!m_scopes.empty())
+	{
+		m_errors.error(stmt.keyword, "Cannot import outside of top-level code.");
+	}
+}
+
 void Resolver::visitPrintStmt(Stmt::Print& stmt)
 {
 	resolve(stmt.expression);
@@ -202,14 +256,14 @@ void Resolver::visitReturnStmt(Stmt::Return& stmt)
 {
 	if (m_currentFunction == FunctionType::NONE)
 	{
-		Lox::Error(stmt.keyword, "Cannot return from top-level code.");
+		m_errors.error(stmt.keyword, "Cannot return from top-level code.");
 	}
 
 	if (stmt.value != nullptr)
 	{
 		if (m_currentFunction == FunctionType::INITIALIZER)
 		{
-			Lox::Error(stmt.keyword, "Cannot return a value from an initializer.");
+			m_errors.error(stmt.keyword, "Cannot return a value from an initializer.");
 		}
 
 		resolve(stmt.value);
@@ -256,22 +310,22 @@ void Resolver::resolveFunction(const Stmt::Function& function, const FunctionTyp
 
 void Resolver::beginScope()
 {
-	m_scopes.emplace();
+	m_scopes.emplace_back();
 }
 
 void Resolver::endScope()
 {
-	m_scopes.pop();
+	m_scopes.pop_back();
 }
 
 void Resolver::declare(const Token& name)
 {
 	if (m_scopes.empty()) return;
 
-	auto& scope = m_scopes.top();
+	auto& scope = m_scopes.back();
 	if (scope.contains(name.lexeme))
 	{
-		Lox::Error(name, "Variable with this name already declared in this scope.");
+		m_errors.error(name, "Variable with this name already declared in this scope.");
 	}
 
 	scope.insert_or_assign(name.lexeme, false);
@@ -281,7 +335,7 @@ void Resolver::define(const Token& name)
 {
 	if (m_scopes.empty()) return;
 
-	m_scopes.top().insert_or_assign(name.lexeme, true);
+	m_scopes.back().insert_or_assign(name.lexeme, true);
 }
 
 void Resolver::resolveLocal(std::shared_ptr<Expr> expr, const Token& name) const
@@ -289,10 +343,11 @@ void Resolver::resolveLocal(std::shared_ptr<Expr> expr, const Token& name) const
 	for (size_t i = m_scopes.size(); i --> 0; ) // loops from m_scopes.size() - 1 to 0
 	{
 		// reverse loop over the scope stack and find the identifier
-		if (m_scopes._Get_container()[i].contains(name.lexeme))
+		if (m_scopes[i].contains(name.lexeme))
 		{
 			// store the number of steps in the interpreter
-			m_interpreter.resolve(std::move(expr), m_scopes.size() - 1 - i);
+			if (m_interpreter != nullptr) { m_interpreter->resolve(std::move(expr), m_scopes.size() - 1 - i); }
+			else { m_locals->emplace(std::move(expr), m_scopes.size() - 1 - i); }
 			return;
 		}
 	}
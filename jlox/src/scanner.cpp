@@ -1,38 +1,93 @@
 #include "scanner.h"
 
-#include "lox.h"
-
-Scanner::Scanner(const std::string& source) : m_source(source)
-{
-	m_keywords.emplace("and", AND);
-	m_keywords.emplace("class", CLASS);
-	m_keywords.emplace("else", ELSE);
-	m_keywords.emplace("false", FALSE);
-	m_keywords.emplace("for", FOR);
-	m_keywords.emplace("fun", FUN);
-	m_keywords.emplace("if", IF);
-	m_keywords.emplace("nil", NIL);
-	m_keywords.emplace("or", OR);
-	m_keywords.emplace("print", PRINT);
-	m_keywords.emplace("return", RETURN);
-	m_keywords.emplace("super", SUPER);
-	m_keywords.emplace("this", THIS);
-	m_keywords.emplace("true", TRUE);
-	m_keywords.emplace("var", VAR);
-	m_keywords.emplace("while", WHILE);
-}
-
-std::vector<Token> Scanner::scan()
-{
-	while (!isAtEnd())
+#include <charconv>
+
+
+namespace
+{
+	// the keyword type if the rest of the word after the first `start` characters is `rest`
+	constexpr TokenType CheckKeyword(const std::string_view text, const size_t start, const std::string_view rest, const TokenType type)
+	{
+		return text.size() == start + rest.size() && text.substr(start) == rest ? type : IDENTIFIER;
+	}
+
+	// a trie over the first one or two characters, every keyword is then a single comparison
+	constexpr TokenType KeywordType(const std::string_view text)
+	{
+		switch (text[0])
+		{
+		case 'a': return CheckKeyword(text, 1, "nd", AND);
+		case 'c': return CheckKeyword(text, 1, "lass", CLASS);
+		case 'e': return CheckKeyword(text, 1, "lse", ELSE);
+		case 'f':
+			if (text.size() > 1)
+			{
+				switch (text[1])
+				{
+				case 'a': return CheckKeyword(text, 2, "lse", FALSE);
+				case 'o': return CheckKeyword(text, 2, "r", FOR);
+				case 'u': return CheckKeyword(text, 2, "n", FUN);
+				default: break;
+				}
+			}
+			return IDENTIFIER;
+		case 'i':
+			if (text.size() > 1)
+			{
+				switch (text[1])
+				{
+				case 'f': return CheckKeyword(text, 2, "", IF);
+				case 'm': return CheckKeyword(text, 2, "port", IMPORT);
+				default: break;
+				}
+			}
+			return IDENTIFIER;
+		case 'n': return CheckKeyword(text, 1, "il", NIL);
+		case 'o': return CheckKeyword(text, 1, "r", OR);
+		case 'p': return CheckKeyword(text, 1, "rint", PRINT);
+		case 'r': return CheckKeyword(text, 1, "eturn", RETURN);
+		case 's': return CheckKeyword(text, 1, "uper", SUPER);
+		case 't':
+			if (text.size() > 1)
+			{
+				switch (text[1])
+				{
+				case 'h': return CheckKeyword(text, 2, "is", THIS);
+				case 'r': return CheckKeyword(text, 2, "ue", TRUE);
+				default: break;
+				}
+			}
+			return IDENTIFIER;
+		case 'v': return CheckKeyword(text, 1, "ar", VAR);
+		case 'w': return CheckKeyword(text, 1, "hile", WHILE);
+		default: return IDENTIFIER;
+		}
+	}
+
+	static_assert(KeywordType("while") == WHILE && KeywordType("this") == THIS && KeywordType("fun") == FUN && KeywordType("if") == IF);
+	static_assert(KeywordType("th") == IDENTIFIER && KeywordType("f") == IDENTIFIER && KeywordType("classes") == IDENTIFIER && KeywordType("i") == IDENTIFIER);
+}
+
+Scanner::Scanner(const std::string_view source, ErrorReporter& errors) : m_source(source), m_runs(GetCharRuns()), m_errors(errors)
+{}
+
+Token Scanner::next()
+{
+	// whitespace, comments and errors produce no token
+	while (!m_token.has_value())
 	{
 		m_start = m_current;
+		if (isAtEnd())
+		{
+			addToken(END_OF_FILE);
+			break;
+		}
 		scanToken();
 	}
 
-	addToken(END_OF_FILE);
-
-	return std::move(m_tokens);
+	const Token token = *m_token;
+	m_token.reset();
+	return token;
 }
 
 
@@ -41,10 +96,9 @@ bool Scanner::isAtEnd() const
 	return m_current >= m_source.size();
 }
 
-void Scanner::addToken(TokenType type, object_t literal)
+void Scanner::addToken(const TokenType type, const double number)
 {
-	std::string lexeme = m_source.substr(m_start, m_current - m_start);
-	m_tokens.emplace_back(type, std::move(lexeme), std::move(literal), m_line);
+	m_token.emplace(type, m_source.substr(m_start, m_current - m_start), m_line, number);
 }
 
 void Scanner::consume()
@@ -52,52 +106,63 @@ void Scanner::consume()
 	m_current++;
 }
 
+void Scanner::consumeUntil(const char* p)
+{
+	m_current = static_cast<size_t>(p - m_source.data());
+}
+
+const char* Scanner::current() const
+{
+	return m_source.data() + m_current;
+}
+
+const char* Scanner::end() const
+{
+	return m_source.data() + m_source.size();
+}
+
 char Scanner::advance()
 {
-	return m_source.at(m_current++);
+	return m_source[m_current++];
 }
 
 char Scanner::peek() const
 {
-	return isAtEnd() ? '\0' : m_source.at(m_current);
+	return isAtEnd() ? '\0' : m_source[m_current];
 }
 
 char Scanner::peekNext() const
 {
-	return m_current + 1 >= m_source.size() ? '\0' : m_source.at(m_current + 1);
+	return m_current + 1 >= m_source.size() ? '\0' : m_source[m_current + 1];
 }
 
 bool Scanner::match(const char c)
 {
-	if (isAtEnd() || m_source.at(m_current) != c) return false;
+	if (isAtEnd() || m_source[m_current] != c) return false;
 	m_current++;
 	return true;
 }
 
 void Scanner::string()
 {
-	while (peek() != '"' && !isAtEnd())
-	{
-		if (peek() == '\n') m_line++;
-		consume();
-	}
+	consumeUntil(m_runs.findQuote(current(), end(), m_line));
 
 	if (isAtEnd())
 	{
-		Lox::Error(m_line, "Unterminated string.");
+		m_errors.error(m_line, "Unterminated string.");
 		return;
 	}
 
 	// consume the closing '"'
 	consume();
 
-	// trim the double quotes
-	addToken(STRING, m_source.substr(m_start + 1, m_current - m_start - 2));
+	// the value is the lexeme without the double quotes, see Token::literal
+	addToken(STRING);
 }
 
 void Scanner::number()
 {
-	while (isdigit(peek())) consume();
+	consumeUntil(m_runs.skipDigits(current(), end()));
 
 	if (peek() == '.' && isdigit(peekNext()))
 	{
@@ -105,19 +170,19 @@ void Scanner::number()
 		consume();
 
 		// consume decimals
-		while (isdigit(peek())) consume();
+		consumeUntil(m_runs.skipDigits(current(), end()));
 	}
 
-	addToken(NUMBER, strtod(m_source.substr(m_start, m_current - m_start).c_str(), nullptr));
+	double value = 0.0;
+	std::from_chars(m_source.data() + m_start, m_source.data() + m_current, value);
+	addToken(NUMBER, value);
 }
 
 void Scanner::identifier()
 {
-	while (isalpha(peek()) || isdigit(peek()) || peek() == '_') consume();
+	consumeUntil(m_runs.skipIdentifier(current(), end()));
 
-	const auto it = m_keywords.find(m_source.substr(m_start, m_current - m_start));
-	const TokenType t = it == m_keywords.end() ? IDENTIFIER : it->second;
-	addToken(t);
+	addToken(KeywordType(m_source.substr(m_start, m_current - m_start)));
 }
 
 void Scanner::scanToken()
@@ -148,10 +213,7 @@ void Scanner::scanToken()
 	case '/':
 		if (match('/'))
 		{
-			while (peek() != '\n' && !isAtEnd())
-			{
-				consume();
-			}
+			consumeUntil(m_runs.findNewline(current(), end()));
 		}
 		else
 		{
@@ -160,13 +222,15 @@ void Scanner::scanToken()
 		break;
 		}
 
-		// whitespace
+		// whitespace, the rest of the run is skipped at once
 	case ' ':
 	case '\r':
 	case '\t':
+		consumeUntil(m_runs.skipWhitespace(current(), end(), m_line));
 		break;
 	case '\n':
 		m_line++;
+		consumeUntil(m_runs.skipWhitespace(current(), end(), m_line));
 		break;
 
 		// string literal
@@ -178,7 +242,7 @@ void Scanner::scanToken()
 		else if (isalpha(c) || c == '_')
 			identifier();
 		else
-			Lox::Error(m_line, "Unexpected character.");
+			m_errors.error(m_line, "Unexpected character.");
 		break;
 	}
 }
@@ -0,0 +1,671 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <variant>
+
+#include "environment.h"
+#include "files.h"
+#include "loxArray.h"
+#include "loxFunction.h"
+#include "loxInstance.h"
+#include "loxMap.h"
+#include "natives.h"
+#include "threads.h"
+#include "treeImage.h"
+
+
+namespace
+{
+	// the layout of an image, all numbers in the byte order of the machine that wrote it:
+	//   header   magic, version, byte order mark, tree size, payload size, payload hash
+	//   payload  the script as a syntax tree, see treeImage.h, then the heap:
+	//            object count, every object as a tag followed by the indices of the objects it is built from, those
+	//            come before it, then the variables of every environment and the fields of every instance in the
+	//            order of the objects, as a count followed by names and values, the elements of every array as a
+	//            count followed by values and the entries of every map as a count followed by keys and values
+	// the globals are the first object
+	constexpr char MAGIC[8] = { 'J', 'L', 'O', 'X', 'H', 'E', 'A', 'P' };
+	constexpr uint32_t VERSION = 3; // bump with every change to the layout, to the syntax tree or to the objects
+	constexpr uint32_t ORDER_MARK = 0x01020304;
+	constexpr size_t HEADER_SIZE = 40;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint64_t treeSize;
+		uint64_t payloadSize;
+		uint64_t payloadHash;
+	};
+	static_assert(sizeof(Header) == HEADER_SIZE);
+
+	enum class ObjectTag : uint8_t { ENVIRONMENT, FUNCTION, CLASS, INSTANCE, NATIVE, ARRAY, MAP };
+
+	// values are tagged with their index in object_t
+	enum class ValueTag : uint8_t { NIL, BOOL, NUMBER, STRING, CALLABLE, CLASS, INSTANCE, FUNCTION };
+	static_assert(std::variant_size_v<object_t> == 8);
+
+
+	// writing -----------------------------------------------------
+
+	class HeapWriter
+	{
+	public:
+		explicit HeapWriter(const std::unordered_map<const Stmt::Function*, uint32_t>& functions) : m_functions(functions)
+		{
+			// built-in functions have no state, their type names them
+			for (const auto& [name, native] : CreateNatives()) { m_natives.emplace_back(&typeid(*native), name); }
+		}
+
+		std::string objects;
+		std::string contents;
+		uint32_t count = 0;
+		std::string error; // the first value an image cannot hold, and the global it was reached from
+
+		void heap(const Environment& globals)
+		{
+			environment(globals);
+
+			// the variables and fields may refer to objects that are only written now, which add their own
+			for (size_t i = 0; i < m_pending.size(); i++)
+			{
+				const Pending pending = m_pending[i];
+				m_global = pending.global;
+				if (const auto* variables = std::get_if<const StringMap<object_t>*>(&pending.contents)) { this->variables(**variables, i == 0); }
+				else if (const auto* array = std::get_if<const std::vector<object_t>*>(&pending.contents)) { elements(**array); }
+				else { entries(*std::get<const LoxMap*>(pending.contents)); }
+			}
+		}
+
+	private:
+		const std::unordered_map<const Stmt::Function*, uint32_t>& m_functions;
+		std::vector<std::pair<const std::type_info*, std::string_view>> m_natives;
+
+		std::unordered_map<const void*, uint32_t> m_indices;
+		// the variables, fields, elements and entries to write, by object
+		struct Pending
+		{
+			std::variant<const StringMap<object_t>*, const std::vector<object_t>*, const LoxMap*> contents;
+			std::string_view global; // the one the object was reached from
+		};
+		std::vector<Pending> m_pending;
+		std::string_view m_global;
+
+		void fail(const std::string_view value)
+		{
+			if (!error.empty()) { return; }
+			error = "Cannot snapshot " + std::string(value) + " held by global '" + std::string(m_global) + "'.";
+		}
+
+		template <typename T>
+		static void put(std::string& out, const T value)
+		{
+			out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		static void bytes(std::string& out, const std::string_view text)
+		{
+			put(out, static_cast<uint32_t>(text.size()));
+			out.append(text);
+		}
+
+		// the index of an object that was written already, or of the next one
+		std::pair<uint32_t, bool> find(const void* object) const
+		{
+			const auto it = m_indices.find(object);
+			return it != m_indices.end() ? std::pair(it->second, true) : std::pair(count, false);
+		}
+
+		// call only after the objects this one is built from are written, so they come first
+		uint32_t begin(const ObjectTag tag, const void* object)
+		{
+			m_indices.emplace(object, count);
+			put(objects, tag);
+			return count++;
+		}
+
+		uint32_t environment(const Environment& environment)
+		{
+			if (auto [index, found] = find(&environment); found) { return index; }
+
+			const uint32_t enclosing = environment.getEnclosing() != nullptr ? this->environment(*environment.getEnclosing()) + 1 : 0;
+
+			const uint32_t index = begin(ObjectTag::ENVIRONMENT, &environment);
+			put(objects, enclosing);
+			m_pending.push_back({ &environment.getValues(), m_global });
+			return index;
+		}
+
+		uint32_t function(const LoxFunction& function)
+		{
+			if (auto [index, found] = find(&function); found) { return index; }
+
+			// the other engines derive their functions from LoxFunction
+			const auto declaration = m_functions.find(function.getDeclaration().get());
+			if (typeid(function) != typeid(LoxFunction) || declaration == m_functions.end() || function.getClosure() == nullptr)
+			{
+				fail("a function from outside the script");
+				return 0;
+			}
+
+			const uint32_t closure = environment(*function.getClosure());
+
+			const uint32_t index = begin(ObjectTag::FUNCTION, &function);
+			put(objects, declaration->second);
+			put(objects, closure);
+			put(objects, static_cast<uint8_t>(function.isInitializer()));
+			return index;
+		}
+
+		uint32_t klass(const LoxClass& klass)
+		{
+			if (auto [index, found] = find(&klass); found) { return index; }
+
+			const uint32_t superclass = klass.superclass != nullptr ? this->klass(*klass.superclass) + 1 : 0;
+
+			std::vector<std::pair<std::string_view, uint32_t>> methods;
+			for (const auto& [name, method] : klass.getMethods()) { methods.emplace_back(name, function(*method)); }
+
+			const uint32_t index = begin(ObjectTag::CLASS, &klass);
+			bytes(objects, klass.name);
+			put(objects, superclass);
+			put(objects, static_cast<uint32_t>(methods.size()));
+			for (const auto& [name, method] : methods)
+			{
+				bytes(objects, name);
+				put(objects, method);
+			}
+			return index;
+		}
+
+		uint32_t instance(const LoxInstance& instance)
+		{
+			if (auto [index, found] = find(&instance); found) { return index; }
+
+			// channels and open files belong to the run that made them
+			if (dynamic_cast<const Channel*>(&instance) != nullptr || dynamic_cast<const InputFile*>(&instance) != nullptr)
+			{
+				fail("a channel or open file");
+				return 0;
+			}
+
+			// the classes of arrays and maps are built in
+			if (const auto* array = dynamic_cast<const LoxArray*>(&instance))
+			{
+				const uint32_t index = begin(ObjectTag::ARRAY, &instance);
+				m_pending.push_back({ &array->elements, m_global });
+				return index;
+			}
+			if (const auto* map = dynamic_cast<const LoxMap*>(&instance))
+			{
+				const uint32_t index = begin(ObjectTag::MAP, &instance);
+				m_pending.push_back({ map, m_global });
+				return index;
+			}
+
+			const uint32_t klass = this->klass(instance.getClass());
+
+			const uint32_t index = begin(ObjectTag::INSTANCE, &instance);
+			put(objects, klass);
+			m_pending.push_back({ &instance.getFields(), m_global });
+			return index;
+		}
+
+		uint32_t callable(const LoxCallable& callable)
+		{
+			if (const auto* function = dynamic_cast<const LoxFunction*>(&callable)) { return this->function(*function); }
+			if (const auto* klass = dynamic_cast<const LoxClass*>(&callable)) { return this->klass(*klass); }
+
+			if (auto [index, found] = find(&callable); found) { return index; }
+
+			for (const auto& [type, name] : m_natives)
+			{
+				if (*type != typeid(callable)) { continue; }
+
+				const uint32_t index = begin(ObjectTag::NATIVE, &callable);
+				bytes(objects, name);
+				return index;
+			}
+
+			fail("a method of a built-in object");
+			return 0;
+		}
+
+		// the globals name what they hold
+		void variables(const StringMap<object_t>& variables, const bool globals)
+		{
+			put(contents, static_cast<uint32_t>(variables.size()));
+			for (const auto& [name, value] : variables)
+			{
+				if (globals) { m_global = name; }
+				bytes(contents, name);
+				this->value(value);
+			}
+		}
+
+		void elements(const std::vector<object_t>& elements)
+		{
+			put(contents, static_cast<uint32_t>(elements.size()));
+			for (const object_t& element : elements) { value(element); }
+		}
+
+		void entries(const LoxMap& map)
+		{
+			put(contents, static_cast<uint32_t>(map.size()));
+			map.forEach([this](const object_t& key, const object_t& entry)
+			{
+				value(key);
+				value(entry);
+			});
+		}
+
+		void value(const object_t& value)
+		{
+			put(contents, static_cast<uint8_t>(value.index()));
+			switch (static_cast<ValueTag>(value.index()))
+			{
+			case ValueTag::NIL: break;
+			case ValueTag::BOOL: put(contents, static_cast<uint8_t>(as<bool>(value))); break;
+			case ValueTag::NUMBER: put(contents, as<double>(value)); break;
+			case ValueTag::STRING: bytes(contents, std::get<std::string>(value)); break;
+			case ValueTag::CALLABLE: put(contents, callable(*as<std::shared_ptr<LoxCallable>>(value))); break;
+			case ValueTag::CLASS: put(contents, klass(*as<std::shared_ptr<LoxClass>>(value))); break;
+			case ValueTag::INSTANCE: put(contents, instance(*as<std::shared_ptr<LoxInstance>>(value))); break;
+			case ValueTag::FUNCTION: put(contents, function(*as<std::shared_ptr<LoxFunction>>(value))); break;
+			default: fail("a value"); break;
+			}
+		}
+	};
+
+
+	// reading -----------------------------------------------------
+
+	// besides the bounds, every reference is checked to name an earlier object of the right kind, and the closure of
+	// every function to define the names its declaration was resolved against, which the interpreter looks up unchecked
+	class HeapReader
+	{
+	public:
+		HeapReader(const std::string_view image, const std::vector<TreeReader::Function>& functions, const std::shared_ptr<Environment>& globals) :
+			m_position(image.data()),
+			m_end(image.data() + image.size()),
+			m_declarations(functions),
+			m_globals(globals)
+		{
+			for (auto& [name, native] : CreateNatives()) { m_natives.emplace(name, std::move(native)); }
+		}
+
+		bool heap()
+		{
+			uint32_t count = get<uint32_t>();
+
+			// every object takes at least one byte
+			if (count == 0 || count > static_cast<size_t>(m_end - m_position)) { return fail(); }
+
+			m_objects.reserve(count);
+			while (count-- > 0 && !m_failed) { object(); }
+			if (!m_failed && m_objects.front().environment != m_globals) { return fail(); }
+
+			for (const Object& object : m_objects)
+			{
+				if (m_failed) { break; }
+
+				if (object.environment != nullptr) { variables([&object](const std::string_view name, object_t value) { object.environment->define(name, std::move(value)); }); }
+				else if (object.tag == ObjectTag::ARRAY) { elements(static_cast<LoxArray&>(*object.instance).elements); }
+				else if (object.tag == ObjectTag::MAP) { entries(static_cast<LoxMap&>(*object.instance)); }
+				else if (object.instance != nullptr) { variables([&object](const std::string_view name, object_t value) { object.instance->set(Token(IDENTIFIER, name, 0), value); }); }
+			}
+
+			return !m_failed && m_position == m_end && checkFunctions();
+		}
+
+	private:
+		struct Object
+		{
+			ObjectTag tag;
+			std::shared_ptr<Environment> environment = nullptr;
+			std::shared_ptr<LoxFunction> function = nullptr;
+			std::shared_ptr<LoxClass> klass = nullptr;
+			std::shared_ptr<LoxInstance> instance = nullptr;
+			std::shared_ptr<LoxCallable> native = nullptr;
+
+			// functions only, a method as the class holds it, without 'this'
+			const TreeReader::Function* declaration = nullptr;
+			bool unbound = false;
+			bool bound = false; // a value refers to it
+			bool method = false; // a class refers to it
+		};
+
+		const char* m_position;
+		const char* m_end;
+		const std::vector<TreeReader::Function>& m_declarations;
+		const std::shared_ptr<Environment>& m_globals;
+		StringMap<std::shared_ptr<LoxCallable>> m_natives;
+
+		std::vector<Object> m_objects;
+		bool m_failed = false;
+
+		bool fail()
+		{
+			m_failed = true;
+			m_position = m_end;
+			return false;
+		}
+
+		template <typename T>
+		T get()
+		{
+			T value{};
+			if (static_cast<size_t>(m_end - m_position) < sizeof(T)) { fail(); return value; }
+
+			memcpy(&value, m_position, sizeof(T));
+			m_position += sizeof(T);
+			return value;
+		}
+
+		std::string_view bytes()
+		{
+			const uint32_t size = get<uint32_t>();
+			if (static_cast<size_t>(m_end - m_position) < size) { fail(); return {}; }
+
+			const std::string_view text(m_position, size);
+			m_position += size;
+			return text;
+		}
+
+		// an object that was read already, nullptr if it is not one of this kind
+		Object* reference(const uint32_t index, const ObjectTag tag)
+		{
+			if (index >= m_objects.size() || m_objects[index].tag != tag) { fail(); return nullptr; }
+			return &m_objects[index];
+		}
+
+		void object()
+		{
+			Object object{ static_cast<ObjectTag>(get<uint8_t>()) };
+			if (m_failed) { return; }
+
+			switch (object.tag)
+			{
+			case ObjectTag::ENVIRONMENT:
+			{
+				// the globals come first and enclose every other environment
+				const uint32_t enclosing = get<uint32_t>();
+				if (m_objects.empty())
+				{
+					if (enclosing != 0) { fail(); }
+					object.environment = m_globals;
+				}
+				else if (const Object* outer = enclosing != 0 ? reference(enclosing - 1, ObjectTag::ENVIRONMENT) : nullptr)
+				{
+					object.environment = newShared<Environment>(outer->environment);
+				}
+				else
+				{
+					fail();
+				}
+				break;
+			}
+			case ObjectTag::FUNCTION:
+			{
+				const uint32_t declaration = get<uint32_t>();
+				const Object* closure = reference(get<uint32_t>(), ObjectTag::ENVIRONMENT);
+				const bool initializer = get<uint8_t>() != 0;
+				if (m_failed || declaration >= m_declarations.size()) { fail(); break; }
+
+				object.declaration = &m_declarations[declaration];
+				if (initializer && !object.declaration->method) { fail(); break; }
+
+				object.function = newShared<LoxFunction>(object.declaration->declaration, closure->environment, initializer);
+				break;
+			}
+			case ObjectTag::CLASS:
+			{
+				const std::string_view name = bytes();
+				const uint32_t superclass = get<uint32_t>();
+				const Object* super = superclass != 0 ? reference(superclass - 1, ObjectTag::CLASS) : nullptr;
+
+				uint32_t count = get<uint32_t>();
+				if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+				StringMap<std::shared_ptr<LoxFunction>> methods;
+				while (!m_failed && count-- > 0)
+				{
+					const std::string_view method = bytes();
+					if (Object* function = reference(get<uint32_t>(), ObjectTag::FUNCTION))
+					{
+						function->method = true;
+						methods.insert_or_assign(std::string(method), function->function);
+					}
+				}
+				if (m_failed) { break; }
+
+				object.klass = newShared<LoxClass>(std::string(name), super != nullptr ? super->klass : nullptr, std::move(methods));
+				break;
+			}
+			case ObjectTag::INSTANCE:
+				if (const Object* klass = reference(get<uint32_t>(), ObjectTag::CLASS))
+				{
+					object.instance = newShared<LoxInstance>(klass->klass);
+				}
+				break;
+			case ObjectTag::ARRAY:
+				object.instance = newShared<LoxArray>();
+				break;
+			case ObjectTag::MAP:
+				object.instance = newShared<LoxMap>();
+				break;
+			case ObjectTag::NATIVE:
+				if (const auto native = m_natives.find(bytes()); native != m_natives.end())
+				{
+					object.native = native->second;
+				}
+				else
+				{
+					fail();
+				}
+				break;
+			default:
+				fail();
+				break;
+			}
+
+			if (!m_failed) { m_objects.push_back(std::move(object)); }
+		}
+
+		template <typename Define>
+		void variables(const Define& define)
+		{
+			uint32_t count = get<uint32_t>();
+			if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+			while (!m_failed && count-- > 0)
+			{
+				const std::string_view name = bytes();
+				object_t value = this->value();
+				if (!m_failed) { define(name, std::move(value)); }
+			}
+		}
+
+		void elements(std::vector<object_t>& elements)
+		{
+			uint32_t count = get<uint32_t>();
+			if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+			elements.reserve(m_failed ? 0 : count);
+			while (!m_failed && count-- > 0)
+			{
+				object_t value = this->value();
+				if (!m_failed) { elements.push_back(std::move(value)); }
+			}
+		}
+
+		void entries(LoxMap& map)
+		{
+			uint32_t count = get<uint32_t>();
+			if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+			while (!m_failed && count-- > 0)
+			{
+				object_t key = this->value();
+				object_t value = this->value();
+				if (!m_failed) { map.insert(key, std::move(value)); }
+			}
+		}
+
+		object_t value()
+		{
+			switch (static_cast<ValueTag>(get<uint8_t>()))
+			{
+			case ValueTag::NIL: return {};
+			case ValueTag::BOOL: return get<uint8_t>() != 0;
+			case ValueTag::NUMBER: return get<double>();
+			case ValueTag::STRING: return std::string(bytes());
+			case ValueTag::CALLABLE:
+			{
+				const uint32_t index = get<uint32_t>();
+				if (index >= m_objects.size()) { fail(); return {}; }
+
+				Object& object = m_objects[index];
+				if (object.function != nullptr) { object.bound = true; return std::shared_ptr<LoxCallable>(object.function); }
+				if (object.klass != nullptr) { return std::shared_ptr<LoxCallable>(object.klass); }
+				if (object.native != nullptr) { return object.native; }
+				fail();
+				return {};
+			}
+			case ValueTag::CLASS:
+				if (const Object* object = reference(get<uint32_t>(), ObjectTag::CLASS)) { return object->klass; }
+				return {};
+			case ValueTag::INSTANCE:
+			{
+				const uint32_t index = get<uint32_t>();
+				if (index < m_objects.size() && (m_objects[index].tag == ObjectTag::ARRAY || m_objects[index].tag == ObjectTag::MAP)) { return m_objects[index].instance; }
+				if (const Object* object = reference(index, ObjectTag::INSTANCE)) { return object->instance; }
+				return {};
+			}
+			case ValueTag::FUNCTION:
+				if (Object* object = reference(get<uint32_t>(), ObjectTag::FUNCTION))
+				{
+					object->bound = true;
+					return object->function;
+				}
+				return {};
+			default:
+				fail();
+				return {};
+			}
+		}
+
+		// the closure of a function has to define the names of the scopes it was declared in, innermost first. A class
+		// holds its methods without the scope of 'this', which binding them to an instance adds, every other function
+		// has all of them
+		bool checkFunctions()
+		{
+			for (Object& object : m_objects)
+			{
+				if (object.function == nullptr) { continue; }
+
+				const Environment* environment = object.function->getClosure().get();
+				const auto& scopes = object.declaration->scopes;
+				const bool unbound = object.declaration->method && !environment->getValues().contains("this");
+
+				if (object.method && !unbound) { return false; }
+				if (object.bound && unbound) { return false; }
+
+				for (size_t i = scopes.size() - (unbound ? 1 : 0); i-- > 0; environment = environment->getEnclosing().get())
+				{
+					if (environment == nullptr || environment == m_globals.get()) { return false; }
+
+					for (const std::string_view name : scopes[i])
+					{
+						if (!environment->getValues().contains(name)) { return false; }
+					}
+				}
+			}
+			return true;
+		}
+	};
+}
+
+void Snapshot::record(const std::vector<std::shared_ptr<Stmt>>& statements, const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals)
+{
+	// only a single script is kept, its functions are the only ones an image can point to
+	if (m_recorded) { m_failed = true; return; }
+	m_recorded = true;
+
+	TreeWriter writer(locals);
+	writer.statements(statements);
+
+	m_failed = writer.failed;
+	m_tree = std::move(writer.payload);
+	m_functions = std::move(writer.functions);
+}
+
+bool Snapshot::write(const std::string& path, const std::shared_ptr<Environment>& globals, std::string& error) const
+{
+	if (m_failed)
+	{
+		error = "Cannot snapshot the script.";
+		return false;
+	}
+
+	// without a script the tree is empty
+	std::string payload = m_recorded ? m_tree : std::string(sizeof(uint32_t), '\0');
+	const size_t treeSize = payload.size();
+
+	HeapWriter writer(m_functions);
+	writer.heap(*globals);
+	if (!writer.error.empty())
+	{
+		error = std::move(writer.error);
+		return false;
+	}
+
+	payload.append(reinterpret_cast<const char*>(&writer.count), sizeof(writer.count));
+	payload += writer.objects;
+	payload += writer.contents;
+
+	Header header{};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byteOrder = ORDER_MARK;
+	header.treeSize = treeSize;
+	header.payloadSize = payload.size();
+	header.payloadHash = ImageHash(payload);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) { return false; }
+
+	out.write(reinterpret_cast<const char*>(&header), HEADER_SIZE);
+	out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+	return static_cast<bool>(out);
+}
+
+bool Snapshot::Read(const std::string_view image, const std::shared_ptr<Environment>& globals, std::unordered_map<std::shared_ptr<Expr>, size_t>& locals, std::vector<std::shared_ptr<Stmt>>& statements)
+{
+	if (image.size() < HEADER_SIZE) { return false; }
+
+	Header header;
+	memcpy(&header, image.data(), HEADER_SIZE);
+
+	const std::string_view payload = image.substr(HEADER_SIZE);
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.byteOrder != ORDER_MARK) { return false; }
+	if (header.payloadSize != payload.size() || header.treeSize > payload.size() || header.payloadHash != ImageHash(payload)) { return false; }
+
+	// the depths are only merged into the interpreter's once the whole image has been read
+	std::unordered_map<std::shared_ptr<Expr>, size_t> resolved;
+	TreeReader tree(payload.substr(0, header.treeSize), resolved);
+	std::vector<std::shared_ptr<Stmt>> program;
+	if (!tree.statements(program) || !tree.atEnd()) { return false; }
+
+	HeapReader heap(payload.substr(header.treeSize), tree.functions, globals);
+	if (!heap.heap()) { return false; }
+
+	statements = std::move(program);
+	locals.merge(resolved);
+	return true;
+}
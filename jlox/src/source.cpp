@@ -0,0 +1,112 @@
+#include "source.h"
+
+#include <fstream>
+
+#if defined(_WIN32)
+#define SOURCE_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define SOURCE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+Source::Source(std::string text) : m_contents(std::move(text))
+{
+	m_text = m_contents;
+}
+
+Source::~Source()
+{
+	if (m_mapping == nullptr) return;
+
+#if defined(SOURCE_WINDOWS)
+	UnmapViewOfFile(m_mapping);
+#elif defined(SOURCE_POSIX)
+	munmap(m_mapping, m_mappingSize);
+#endif
+}
+
+std::unique_ptr<Source> Source::Load(const char* path)
+{
+	if (auto mapped = Map(path)) { return mapped; }
+
+	// read in large blocks, a pipe has no size to reserve up front
+	std::ifstream inputStream(path, std::ios::binary);
+	if (!inputStream.is_open()) { return nullptr; }
+
+	std::string text;
+	char block[1 << 16];
+	while (inputStream.read(block, sizeof(block)) || inputStream.gcount() > 0)
+	{
+		text.append(block, static_cast<size_t>(inputStream.gcount()));
+	}
+
+	return std::make_unique<Source>(std::move(text));
+}
+
+// only regular files that are not empty are mapped, a mapping of zero bytes fails
+std::unique_ptr<Source> Source::Map(const char* path)
+{
+	void* view = nullptr;
+	size_t size = 0;
+
+#if defined(SOURCE_WINDOWS)
+	const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) { return nullptr; }
+
+	LARGE_INTEGER fileSize{};
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping != nullptr)
+	{
+		view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+		// the view keeps the file mapped after both handles are closed
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if (view == nullptr) { return nullptr; }
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+#elif defined(SOURCE_POSIX)
+	const int file = open(path, O_RDONLY);
+	if (file < 0) { return nullptr; }
+
+	struct stat status{};
+	if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0)
+	{
+		close(file);
+		return nullptr;
+	}
+
+	size = static_cast<size_t>(status.st_size);
+	view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	// the mapping keeps the file open
+	close(file);
+	if (view == MAP_FAILED) { return nullptr; }
+
+	// the scanner reads the file once from start to end
+	madvise(view, size, MADV_SEQUENTIAL);
+#else
+	(void)path;
+	return nullptr;
+#endif
+
+	std::unique_ptr<Source> source(new Source());
+	source->m_mapping = view;
+	source->m_mappingSize = size;
+	source->m_text = std::string_view(static_cast<const char*>(view), size);
+	return source;
+}
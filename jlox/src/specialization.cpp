@@ -0,0 +1,83 @@
+#include "specialization.h"
+
+#include <iomanip>
+
+
+Specialization Specialize(const Token& op, const object_t& left, const object_t& right)
+{
+	if (is<double>(left) && is<double>(right))
+	{
+		switch (op.type)
+		{
+		case PLUS: return Specialization::ADD_NUMBERS;
+		case MINUS: return Specialization::SUBTRACT_NUMBERS;
+		case STAR: return Specialization::MULTIPLY_NUMBERS;
+		case SLASH: return Specialization::DIVIDE_NUMBERS;
+		case GREATER: return Specialization::GREATER_NUMBERS;
+		case GREATER_EQUAL: return Specialization::GREATER_EQUAL_NUMBERS;
+		case LESS: return Specialization::LESS_NUMBERS;
+		case LESS_EQUAL: return Specialization::LESS_EQUAL_NUMBERS;
+		case EQUAL_EQUAL: return Specialization::EQUAL_NUMBERS;
+		case BANG_EQUAL: return Specialization::NOT_EQUAL_NUMBERS;
+		default: break;
+		}
+	}
+	else if (op.type == PLUS && is<std::string>(left) && is<std::string>(right))
+	{
+		return Specialization::CONCATENATE_STRINGS;
+	}
+	return Specialization::GENERIC;
+}
+
+Specialization Specialize(const Token& op, const object_t& right)
+{
+	if (op.type == MINUS && is<double>(right)) { return Specialization::NEGATE_NUMBER; }
+	return Specialization::GENERIC;
+}
+
+void Deoptimize(Expr& expr)
+{
+	expr.deoptimizations++;
+	expr.specialization = expr.deoptimizations < MAX_DEOPTIMIZATIONS ? Specialization::UNINITIALIZED : Specialization::GENERIC;
+}
+
+const char* ToString(const Specialization specialization)
+{
+	switch (specialization)
+	{
+	case Specialization::UNINITIALIZED: return "uninitialized";
+	case Specialization::GENERIC: return "generic";
+	case Specialization::ADD_NUMBERS: return "add numbers";
+	case Specialization::SUBTRACT_NUMBERS: return "subtract numbers";
+	case Specialization::MULTIPLY_NUMBERS: return "multiply numbers";
+	case Specialization::DIVIDE_NUMBERS: return "divide numbers";
+	case Specialization::GREATER_NUMBERS: return "greater numbers";
+	case Specialization::GREATER_EQUAL_NUMBERS: return "greater equal numbers";
+	case Specialization::LESS_NUMBERS: return "less numbers";
+	case Specialization::LESS_EQUAL_NUMBERS: return "less equal numbers";
+	case Specialization::EQUAL_NUMBERS: return "equal numbers";
+	case Specialization::NOT_EQUAL_NUMBERS: return "not equal numbers";
+	case Specialization::CONCATENATE_STRINGS: return "concatenate strings";
+	case Specialization::NEGATE_NUMBER: return "negate number";
+	}
+	return "unknown";
+}
+
+
+SpecializationDump::SpecializationDump(std::ostream& out) : m_out(out)
+{}
+
+std::shared_ptr<Expr> SpecializationDump::transform(const std::shared_ptr<Expr>& expr)
+{
+	const Token* op = nullptr;
+	if (const auto* binary = dynamic_cast<Expr::Binary*>(expr.get())) { op = &binary->op; }
+	else if (const auto* unary = dynamic_cast<Expr::Unary*>(expr.get())) { op = &unary->op; }
+
+	if (op != nullptr)
+	{
+		m_out << "[line " << op->line << "] " << std::left << std::setw(4) << op->lexeme << ToString(expr->specialization);
+		if (expr->deoptimizations > 0) { m_out << " (deoptimized " << expr->deoptimizations << "x)"; }
+		m_out << "\n";
+	}
+	return nullptr;
+}
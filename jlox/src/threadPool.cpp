@@ -0,0 +1,159 @@
+#include "threadPool.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	// the pool the current thread works for and the queue it owns
+	thread_local const ThreadPool* t_pool = nullptr;
+	thread_local size_t t_queue = 0;
+}
+
+ThreadPool::ThreadPool(const size_t threads) :
+	// hardware_concurrency() is 0 when it is not known
+	m_size(std::max<size_t>(threads, 1))
+{
+	for (size_t i = 0; i <= m_size; i++)
+	{
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+
+	m_threads.reserve(m_size);
+	for (size_t i = 0; i < m_size; i++)
+	{
+		m_threads.emplace_back([this, i] { work(i); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+		threads = std::move(m_threads);
+	}
+	m_submitted.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	// counted first, so the task cannot finish before it is pending
+	{
+		std::lock_guard lock(m_mutex);
+		m_pending++;
+		m_queued++;
+	}
+
+	const size_t queue = t_pool == this ? t_queue : m_size;
+	{
+		std::lock_guard lock(m_queues[queue]->mutex);
+		m_queues[queue]->tasks.push_back(std::move(task));
+	}
+	m_submitted.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_finished.wait(lock, [this] { return m_pending == 0; });
+}
+
+void ThreadPool::block(const std::function<void()>& wait)
+{
+	if (t_pool != this)
+	{
+		wait();
+		return;
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_blocked++;
+
+		// the spare takes the place of this thread for good, threads only ever exit with the pool
+		if (!m_stopping && m_threads.size() - m_blocked < m_size)
+		{
+			m_threads.emplace_back([this] { work(m_size); });
+		}
+	}
+
+	wait();
+
+	std::lock_guard lock(m_mutex);
+	m_blocked--;
+}
+
+void ThreadPool::work(const size_t queue)
+{
+	t_pool = this;
+	t_queue = queue;
+
+	std::function<void()> task;
+	while (true)
+	{
+		if (!take(queue, task))
+		{
+			std::unique_lock lock(m_mutex);
+			m_submitted.wait(lock, [this] { return m_stopping || m_queued > 0; });
+			if (m_queued == 0) { return; }
+			continue;
+		}
+
+		task();
+		task = nullptr;
+
+		// a task submits its follow-ups before it returns, so nothing is pending once the count reaches zero
+		bool finished;
+		{
+			std::lock_guard lock(m_mutex);
+			finished = --m_pending == 0;
+		}
+		if (finished) { m_finished.notify_all(); }
+	}
+}
+
+bool ThreadPool::take(const size_t queue, std::function<void()>& task)
+{
+	// newest first from the thread's own queue, the shared one is first come first served
+	{
+		Queue& own = *m_queues[queue];
+		std::lock_guard lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			if (queue < m_size)
+			{
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(own.tasks.front());
+				own.tasks.pop_front();
+			}
+			m_queued--;
+			return true;
+		}
+	}
+
+	// the oldest task of the next queue that has one
+	for (size_t i = 1; i < m_queues.size(); i++)
+	{
+		Queue& other = *m_queues[(queue + i) % m_queues.size()];
+		std::lock_guard lock(other.mutex);
+		if (!other.tasks.empty())
+		{
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			m_queued--;
+			return true;
+		}
+	}
+	return false;
+}
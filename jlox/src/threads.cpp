@@ -0,0 +1,412 @@
+#include "threads.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "environment.h"
+#include "heapCopy.h"
+#include "interpreter.h"
+#include "loxClass.h"
+#include "loxFunction.h"
+#include "RuntimeError.h"
+
+
+namespace
+{
+	constexpr std::string_view DEADLOCK = "Deadlock: every thread is waiting for a message.";
+}
+
+
+// channels
+
+const std::array<Channel::Method, 0> Channel::methods = {};
+
+class Channel::Operation
+{
+public:
+	explicit Operation(Channel& channel) : m_channel(channel)
+	{
+		m_channel.m_operations++;
+	}
+
+	~Operation()
+	{
+		if (m_channel.m_retired.load() != nullptr) { m_channel.freeRetired(); }
+		m_channel.m_operations--;
+	}
+
+private:
+	Channel& m_channel;
+};
+
+Channel::Channel() : m_sendSegment(new Segment(0)), m_receiveSegment(m_sendSegment.load())
+{}
+
+Channel::~Channel()
+{
+	while (tryReceive() != nullptr) {}
+
+	for (Segment* segment = m_receiveSegment.load(); segment != nullptr;)
+	{
+		delete std::exchange(segment, segment->next.load());
+	}
+	for (Segment* segment = m_retired.load(); segment != nullptr;)
+	{
+		delete std::exchange(segment, segment->retired);
+	}
+}
+
+void Channel::send(std::unique_ptr<Message> message)
+{
+	Operation operation(*this);
+	while (true)
+	{
+		// a segment newer than the position means the position is stale, and the compare and swap fails
+		size_t position = m_sendPosition.load();
+		Segment* segment = m_sendSegment.load();
+
+		// whoever claimed the last slot is linking the next segment
+		if (position >= segment->first + SEGMENT) { std::this_thread::yield(); continue; }
+		if (!m_sendPosition.compare_exchange_weak(position, position + 1)) { continue; }
+
+		// linked before the message is stored, so the receiver of the last slot finds it
+		if (position + 1 == segment->first + SEGMENT)
+		{
+			auto* next = new Segment(position + 1);
+			segment->next.store(next);
+			m_sendSegment.store(next);
+		}
+
+		segment->slots[position - segment->first].store(message.release());
+		changed();
+		return;
+	}
+}
+
+std::unique_ptr<Message> Channel::tryReceive()
+{
+	Operation operation(*this);
+	while (true)
+	{
+		size_t position = m_receivePosition.load();
+		Segment* segment = m_receiveSegment.load();
+
+		// whoever received from the last slot is moving on to the next segment
+		if (position >= segment->first + SEGMENT) { std::this_thread::yield(); continue; }
+		if (position >= m_sendPosition.load()) { return nullptr; }
+		if (!m_receivePosition.compare_exchange_weak(position, position + 1)) { continue; }
+
+		// the slot is claimed by a send that has not stored its message yet
+		std::atomic<Message*>& slot = segment->slots[position - segment->first];
+		Message* message;
+		while ((message = slot.load()) == nullptr) { std::this_thread::yield(); }
+
+		if (position + 1 == segment->first + SEGMENT)
+		{
+			m_receiveSegment.store(segment->next.load());
+			retire(segment);
+		}
+		return std::unique_ptr<Message>(message);
+	}
+}
+
+bool Channel::empty() const
+{
+	return m_receivePosition.load() >= m_sendPosition.load();
+}
+
+void Channel::wait(const uint32_t version)
+{
+	// counted before the version is looked at again, so a change after that either is seen or notifies
+	m_waiting++;
+	m_version.wait(version);
+	m_waiting--;
+}
+
+void Channel::changed()
+{
+	m_version++;
+	if (m_waiting > 0) { m_version.notify_all(); }
+}
+
+void Channel::retire(Segment* segment)
+{
+	segment->retired = m_retired.load();
+	while (!m_retired.compare_exchange_weak(segment->retired, segment)) {}
+}
+
+void Channel::freeRetired()
+{
+	// an operation that could still look at a segment began before it was retired, and counts until it ends. When
+	// this one is the only one under way after taking the segments, none of them can be looked at any more
+	Segment* segments = m_retired.exchange(nullptr);
+	const bool unseen = m_operations.load() == 1;
+
+	while (segments != nullptr)
+	{
+		Segment* segment = std::exchange(segments, segments->retired);
+		if (unseen) { delete segment; }
+		else { retire(segment); }
+	}
+}
+
+
+// threads
+
+Threads::Threads(OutputSink& out, std::ostream& err) : m_out(out), m_err(err)
+{}
+
+Threads::~Threads()
+{
+	wait();
+}
+
+ThreadPool& Threads::pool()
+{
+	std::call_once(m_started, [this] { m_pool = std::make_unique<ThreadPool>(); });
+	return *m_pool;
+}
+
+void Threads::wait()
+{
+	if (m_pool == nullptr) { return; }
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_mainWaiting = true;
+		detectDeadlock();
+	}
+	m_pool->wait();
+
+	std::lock_guard lock(m_mutex);
+	m_mainWaiting = false;
+}
+
+std::unique_ptr<Message> Threads::receive(Channel& channel)
+{
+	if (auto message = channel.tryReceive()) { return message; }
+
+	std::unique_ptr<Message> message;
+	bool deadlocked = false;
+	const auto waitForMessage = [&]
+	{
+		// received from under the lock while waiting, so a thread counted as waiting never holds a message
+		std::unique_lock lock(m_mutex);
+		const bool main = std::this_thread::get_id() == m_mainThread;
+		m_receiving.push_back(&channel);
+		m_mainReceiving = m_mainReceiving || main;
+
+		// looked at first, so the threads told to stop take nothing the others send while they stop
+		while (!(deadlocked = m_deadlocked))
+		{
+			// read before trying, so a send after the try changes it
+			const uint32_t version = channel.version();
+			if ((message = channel.tryReceive()) != nullptr) { break; }
+
+			detectDeadlock();
+			if (m_deadlocked) { continue; }
+
+			lock.unlock();
+			channel.wait(version);
+			lock.lock();
+		}
+
+		m_receiving.erase(std::find(m_receiving.begin(), m_receiving.end(), &channel));
+		m_mainReceiving = m_mainReceiving && !main;
+		if (m_receiving.empty()) { m_deadlocked = false; }
+	};
+	m_pool != nullptr ? m_pool->block(waitForMessage) : waitForMessage();
+
+	if (deadlocked) { throw NativeError(std::string(DEADLOCK)); }
+	return message;
+}
+
+void Threads::spawned()
+{
+	std::lock_guard lock(m_mutex);
+	m_alive++;
+}
+
+void Threads::returned()
+{
+	std::lock_guard lock(m_mutex);
+	m_alive--;
+	detectDeadlock();
+}
+
+void Threads::detectDeadlock()
+{
+	if (m_deadlocked || m_receiving.empty() || m_receiving.size() + (m_mainWaiting ? 1 : 0) < m_alive) { return; }
+	for (const Channel* channel : m_receiving)
+	{
+		if (!channel->empty()) { return; }
+	}
+
+	m_deadlocked = true;
+	if (m_mainReceiving) { m_deadlockReported = true; }
+	for (Channel* channel : m_receiving) { channel->changed(); }
+}
+
+void Threads::runtimeError(const RuntimeError& error)
+{
+	m_hadRuntimeError = true;
+
+	// every thread that was waiting stops with it, and it is reported once: by the main thread when that was waiting
+	// too, else by the first worker
+	if (error.what() == DEADLOCK && std::this_thread::get_id() != m_mainThread && m_deadlockReported.exchange(true)) { return; }
+
+	std::lock_guard lock(output);
+	m_out.flush();
+	m_err << error.what() << "\n[line " << error.token.line << "]\n";
+}
+
+
+// built-in functions
+
+namespace
+{
+	Threads& Available(const Interpreter* interpreter)
+	{
+		if (interpreter == nullptr || interpreter->threads == nullptr)
+		{
+			throw NativeError("Threads need the tree-walking interpreter.");
+		}
+		return *interpreter->threads;
+	}
+
+	Channel& ChannelArgument(const object_t& value)
+	{
+		if (is<std::shared_ptr<LoxInstance>>(value))
+		{
+			if (auto* channel = dynamic_cast<Channel*>(as<std::shared_ptr<LoxInstance>>(value).get())) { return *channel; }
+		}
+		throw NativeError("Expected a channel.");
+	}
+
+	// a function or class of the interpreter's own, which a worker can run in its copy of the heap
+	LoxCallable* Spawnable(const object_t& value)
+	{
+		LoxCallable* callable = nullptr;
+		if (is<std::shared_ptr<LoxFunction>>(value)) { callable = as<std::shared_ptr<LoxFunction>>(value).get(); }
+		else if (is<std::shared_ptr<LoxClass>>(value)) { callable = as<std::shared_ptr<LoxClass>>(value).get(); }
+		else if (is<std::shared_ptr<LoxCallable>>(value))
+		{
+			callable = as<std::shared_ptr<LoxCallable>>(value).get();
+			if (dynamic_cast<LoxFunction*>(callable) == nullptr && dynamic_cast<LoxClass*>(callable) == nullptr) { callable = nullptr; }
+		}
+
+		if (callable == nullptr || callable->arity() != 1)
+		{
+			throw NativeError("Can only spawn functions and classes that take one argument.");
+		}
+		return callable;
+	}
+
+	// the value to whoever receives it, the globals of the copy are left empty as the receiver looks globals up in its own
+	std::unique_ptr<Message> Copy(const Interpreter& from, const object_t& value)
+	{
+		HeapCopy copy(from, newShared<Environment>(nullptr));
+		object_t copied = copy.value(value);
+		return std::make_unique<Message>(Message{ std::move(copied), std::move(copy.locals) });
+	}
+
+
+	class SpawnFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override
+		{
+			Threads& threads = Available(interpreter);
+			Spawnable(arguments[0]);
+
+			// the copy is made here, while only this thread uses the heap
+			std::shared_ptr<Environment> globals = newShared<Environment>(nullptr);
+			HeapCopy copy(*interpreter, globals);
+			copy.globals();
+			object_t function = copy.value(arguments[0]);
+			object_t argument = copy.value(arguments[1]);
+
+			auto result = newShared<Channel>();
+			threads.spawned();
+			threads.pool().submit([&threads, &out = interpreter->out, globals, function, argument, locals = std::move(copy.locals), result]() mutable
+			{
+				object_t value = {};
+				{
+					Interpreter worker(out, globals);
+					worker.threads = &threads;
+					worker.locals = std::move(locals);
+
+					try
+					{
+						value = Spawnable(function)->call(&worker, { argument });
+					}
+					catch (const RuntimeError& error)
+					{
+						threads.runtimeError(error);
+					}
+					result->send(Copy(worker, value));
+				}
+
+				// functions defined at the top level and the globals they are kept in refer to each other
+				value = {};
+				function = {};
+				argument = {};
+				globals->clear();
+				threads.returned();
+			});
+			return std::shared_ptr<LoxInstance>(result);
+		}
+		size_t arity() const override { return 2; }
+	};
+
+	class ChannelFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>&) const override
+		{
+			Available(interpreter);
+			return std::shared_ptr<LoxInstance>(newShared<Channel>());
+		}
+		size_t arity() const override { return 0; }
+	};
+
+	class SendFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override
+		{
+			Available(interpreter);
+			ChannelArgument(arguments[0]).send(Copy(*interpreter, arguments[1]));
+			return {};
+		}
+		size_t arity() const override { return 2; }
+	};
+
+	class ReceiveFunction final : public LoxCallable
+	{
+	public:
+		object_t call(Interpreter* interpreter, const std::vector<object_t>& arguments) const override
+		{
+			Threads& threads = Available(interpreter);
+			std::unique_ptr<Message> message = threads.receive(ChannelArgument(arguments[0]));
+
+			interpreter->locals.merge(message->locals);
+			return std::move(message->value);
+		}
+		size_t arity() const override { return 1; }
+	};
+}
+
+
+std::vector<std::pair<std::string_view, std::shared_ptr<LoxCallable>>> CreateThreadNatives()
+{
+	return {
+		{ "spawn", newShared<SpawnFunction>() },
+		{ "channel", newShared<ChannelFunction>() },
+		{ "send", newShared<SendFunction>() },
+		{ "receive", newShared<ReceiveFunction>() }
+	};
+}
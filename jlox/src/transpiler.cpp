@@ -0,0 +1,451 @@
+#include "transpiler.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+
+namespace
+{
+	// a C++ string literal, everything but plain printable characters is escaped
+	std::string Quote(const std::string_view text)
+	{
+		std::string quoted = "\"";
+		for (const char c : text)
+		{
+			switch (c)
+			{
+			case '"': quoted += "\\\""; break;
+			case '\\': quoted += "\\\\"; break;
+			case '\n': quoted += "\\n"; break;
+			case '\t': quoted += "\\t"; break;
+			default:
+				if (c >= ' ' && c <= '~')
+				{
+					quoted += c;
+				}
+				else
+				{
+					char escape[8];
+					std::snprintf(escape, sizeof(escape), "\\%03o", static_cast<unsigned char>(c));
+					quoted += escape;
+				}
+			}
+		}
+		return quoted + "\"";
+	}
+
+	// hexadecimal floating point literals round trip exactly, folded constants can also be infinite or not a number
+	std::string Number(const double value)
+	{
+		std::ostringstream out;
+		if (std::isfinite(value))
+		{
+			out << std::hexfloat << value;
+		}
+		else
+		{
+			out << "std::bit_cast<double>(0x" << std::hex << std::bit_cast<uint64_t>(value) << "ull)";
+		}
+		return out.str();
+	}
+
+	std::string Lambda(const std::string& expression)
+	{
+		return "[&]() -> object_t { return " + expression + "; }";
+	}
+}
+
+
+Transpiler::Transpiler(const std::unordered_map<std::shared_ptr<Expr>, size_t>& locals) :
+	m_locals(locals)
+{}
+
+void Transpiler::emit(const std::vector<std::shared_ptr<Stmt>>& statements, std::ostream& out)
+{
+	m_functions.push_back(std::make_unique<Function>());
+	m_functions.back()->indent = 2;
+	for (const auto& statement : statements)
+	{
+		statement->accept(this);
+	}
+	const std::string program = m_functions.back()->code.str();
+	m_functions.pop_back();
+
+	out << "// generated by jlox --emit-cpp\n";
+	out << "#include \"aot.h\"\n\n";
+	out << "namespace\n{\n";
+	out << m_constants.str() << "\n";
+	out << "\tstd::shared_ptr<Environment> globals;\n";
+	out << m_declarations.str() << "\n";
+	out << m_prototypes.str() << "\n";
+	out << m_definitions.str();
+	out << "\tvoid Program()\n\t{\n";
+	out << "\t\tconst std::shared_ptr<Environment>& env0 = globals;\n";
+	out << program;
+	out << "\t}\n}\n\n";
+	out << "int main()\n{\n";
+	out << "\tglobals = aot::CreateGlobals();\n";
+	for (size_t i = 0; i < m_declarationInitializers.size(); i++)
+	{
+		out << "\tD" << i << " = " << m_declarationInitializers[i] << ";\n";
+	}
+	out << "\treturn aot::Run(&Program);\n}\n";
+}
+
+
+// statements
+void Transpiler::visitBlockStmt(Stmt::Block& stmt)
+{
+	Function& function = *m_functions.back();
+	line() << "{\n";
+	function.indent++;
+	line() << "auto env" << function.depth + 1 << " = newShared<Environment>(" << environment() << ");\n";
+	function.depth++;
+	for (const auto& statement : stmt.statements)
+	{
+		statement->accept(this);
+	}
+	function.depth--;
+	function.indent--;
+	line() << "}\n";
+}
+
+void Transpiler::visitClassStmt(Stmt::Class& stmt)
+{
+	std::string superclass = "nullptr";
+	if (stmt.superclass != nullptr)
+	{
+		superclass = "aot::Superclass(" + token(stmt.superclass->name) + ", " + expression(stmt.superclass) + ")";
+	}
+
+	std::string methods;
+	for (const auto& method : stmt.methods)
+	{
+		const std::string index = function(*method);
+		methods += (methods.empty() ? "" : ", ") + std::string("aot::Method{ D") + index + ", &F" + index + " }";
+	}
+
+	line() << "aot::DefineClass(" << environment() << ", " << token(stmt.name) << ", " << superclass << ", {" << (methods.empty() ? "" : " " + methods + " ") << "});\n";
+}
+
+void Transpiler::visitCountedLoopStmt(Stmt::CountedLoop& stmt)
+{
+	// written as the loop it was specialized from
+	Function& function = *m_functions.back();
+	line() << "{\n";
+	function.indent++;
+	line() << "auto env" << function.depth + 1 << " = newShared<Environment>(" << environment() << ");\n";
+	function.depth++;
+	stmt.variable->accept(this);
+	line() << "while (aot::Truthy(" << expression(stmt.condition) << "))\n";
+	line() << "{\n";
+	function.indent++;
+	line() << "auto env" << function.depth + 1 << " = newShared<Environment>(" << environment() << ");\n";
+	function.depth++;
+	stmt.body->accept(this);
+	line() << expression(stmt.increment) << ";\n";
+	function.depth -= 2;
+	function.indent--;
+	line() << "}\n";
+	function.indent--;
+	line() << "}\n";
+}
+
+void Transpiler::visitExpressionStmt(Stmt::Expression& stmt)
+{
+	line() << expression(stmt.expression) << ";\n";
+}
+
+void Transpiler::visitFunctionStmt(Stmt::Function& stmt)
+{
+	const std::string index = function(stmt);
+	line() << "aot::DefineFunction(" << environment() << ", D" << index << ", &F" << index << ");\n";
+}
+
+void Transpiler::visitIfStmt(Stmt::If& stmt)
+{
+	line() << "if (aot::Truthy(" << expression(stmt.condition) << "))\n";
+	block(stmt.thenBranch);
+	if (stmt.elseBranch != nullptr)
+	{
+		line() << "else\n";
+		block(stmt.elseBranch);
+	}
+}
+
+void Transpiler::visitImportStmt(Stmt::Import&)
+{
+	// imports are replaced by the statements of their modules before the program is written, see modules.h
+}
+
+void Transpiler::visitPrintStmt(Stmt::Print& stmt)
+{
+	line() << "aot::Print(" << expression(stmt.expression) << ");\n";
+}
+
+void Transpiler::visitReturnStmt(Stmt::Return& stmt)
+{
+	line() << "return " << (stmt.value != nullptr ? expression(stmt.value) : "object_t()") << ";\n";
+}
+
+void Transpiler::visitVarStmt(Stmt::Var& stmt)
+{
+	const std::string value = stmt.initializer != nullptr ? expression(stmt.initializer) : "object_t()";
+	line() << environment() << "->define(" << Quote(stmt.name.lexeme) << ", " << value << ");\n";
+}
+
+void Transpiler::visitWhileStmt(Stmt::While& stmt)
+{
+	line() << "while (aot::Truthy(" << expression(stmt.condition) << "))\n";
+	block(stmt.body);
+}
+
+
+// expressions
+object_t Transpiler::visitAssignExpr(Expr::Assign& expr)
+{
+	m_expr = assign(expr.name, depthOf(expr), expression(expr.value));
+	return {};
+}
+
+object_t Transpiler::visitBinaryExpr(Expr::Binary& expr)
+{
+	const std::string left = expression(expr.left);
+	const std::string right = expression(expr.right);
+	m_expr = "aot::Binary(" + token(expr.op) + ", { " + left + ", " + right + " })";
+	return {};
+}
+
+object_t Transpiler::visitCallExpr(Expr::Call& expr)
+{
+	std::string calleeAndArguments = expression(expr.callee);
+	for (const auto& argument : expr.arguments)
+	{
+		calleeAndArguments += ", " + expression(argument);
+	}
+	m_expr = "aot::Call(" + token(expr.paren) + ", { " + calleeAndArguments + " })";
+	return {};
+}
+
+object_t Transpiler::visitCompareConstantExpr(Expr::CompareConstant& expr)
+{
+	m_expr = "aot::Binary(" + token(expr.op) + ", { " + variable(expr.name, expr.depth) + ", " + literal(expr.constant) + " })";
+	return {};
+}
+
+object_t Transpiler::visitGetExpr(Expr::Get& expr)
+{
+	m_expr = "aot::Get(" + token(expr.name) + ", " + expression(expr.object) + ")";
+	return {};
+}
+
+object_t Transpiler::visitGetChainExpr(Expr::GetChain& expr)
+{
+	std::string object = expression(expr.object);
+	for (const Token& name : expr.names)
+	{
+		object = "aot::Get(" + token(name) + ", " + object + ")";
+	}
+	m_expr = object;
+	return {};
+}
+
+object_t Transpiler::visitGroupingExpr(Expr::Grouping& expr)
+{
+	m_expr = expression(expr.expression);
+	return {};
+}
+
+object_t Transpiler::visitIncrementExpr(Expr::Increment& expr)
+{
+	const std::string value = "aot::Binary(" + token(expr.op) + ", { " + variable(expr.name, expr.depth) + ", " + literal(expr.amount) + " })";
+	m_expr = assign(expr.name, expr.depth, value);
+	return {};
+}
+
+object_t Transpiler::visitLiteralExpr(Expr::Literal& expr)
+{
+	m_expr = literal(expr.value);
+	return {};
+}
+
+object_t Transpiler::visitLogicalExpr(Expr::Logical& expr)
+{
+	const std::string left = expression(expr.left);
+	const std::string right = expression(expr.right);
+	m_expr = std::string(expr.op.type == OR ? "aot::Or(" : "aot::And(") + left + ", " + Lambda(right) + ")";
+	return {};
+}
+
+object_t Transpiler::visitNilCheckExpr(Expr::NilCheck& expr)
+{
+	m_expr = "aot::Binary(" + token(expr.op) + ", { " + expression(expr.operand) + ", object_t() })";
+	return {};
+}
+
+object_t Transpiler::visitSetExpr(Expr::Set& expr)
+{
+	const std::string object = expression(expr.object);
+	m_expr = "aot::Set(" + token(expr.name) + ", " + object + ", " + Lambda(expression(expr.value)) + ")";
+	return {};
+}
+
+object_t Transpiler::visitSetThisExpr(Expr::SetThis& expr)
+{
+	const std::string instance = variable(Token(THIS, "this", expr.name.line), expr.depth);
+	m_expr = "aot::Set(" + token(expr.name) + ", " + instance + ", " + Lambda(expression(expr.value)) + ")";
+	return {};
+}
+
+object_t Transpiler::visitSuperExpr(Expr::Super& expr)
+{
+	m_expr = "aot::Super(" + environment() + ", " + std::to_string(*depthOf(expr)) + ", " + token(expr.method) + ")";
+	return {};
+}
+
+object_t Transpiler::visitThisExpr(Expr::This& expr)
+{
+	m_expr = variable(expr.keyword, depthOf(expr));
+	return {};
+}
+
+object_t Transpiler::visitUnaryExpr(Expr::Unary& expr)
+{
+	m_expr = "aot::Unary(" + token(expr.op) + ", " + expression(expr.right) + ")";
+	return {};
+}
+
+object_t Transpiler::visitVariableExpr(Expr::Variable& expr)
+{
+	m_expr = variable(expr.name, depthOf(expr));
+	return {};
+}
+
+
+void Transpiler::block(const std::shared_ptr<Stmt>& stmt)
+{
+	// blocks write their own braces, anything else needs them to stay a single statement
+	if (dynamic_cast<Stmt::Block*>(stmt.get()) != nullptr)
+	{
+		stmt->accept(this);
+		return;
+	}
+
+	Function& function = *m_functions.back();
+	line() << "{\n";
+	function.indent++;
+	stmt->accept(this);
+	function.indent--;
+	line() << "}\n";
+}
+
+std::string Transpiler::expression(const std::shared_ptr<Expr>& expr)
+{
+	expr->accept(this);
+	return std::move(m_expr);
+}
+
+// writes the function's body as a C++ function, returns the index of its declaration D<index> and body F<index>
+std::string Transpiler::function(const Stmt::Function& declaration)
+{
+	const std::string index = std::to_string(m_declarationInitializers.size());
+
+	std::string params;
+	for (const Token& param : declaration.params)
+	{
+		params += (params.empty() ? "" : ", ") + token(param);
+	}
+	m_declarationInitializers.push_back("aot::Declare(" + token(declaration.name) + ", {" + (params.empty() ? "" : " " + params + " ") + "})");
+
+	m_declarations << "\tstd::shared_ptr<Stmt::Function> D" << index << "; // " << declaration.name.lexeme << "\n";
+	m_prototypes << "\tobject_t F" << index << "(const std::shared_ptr<Environment>& env0);\n";
+
+	m_functions.push_back(std::make_unique<Function>());
+	line() << "object_t F" << index << "(const std::shared_ptr<Environment>& env0)\n";
+	line() << "{\n";
+	m_functions.back()->indent++;
+	for (const auto& statement : declaration.body)
+	{
+		statement->accept(this);
+	}
+	line() << "return object_t();\n";
+	m_functions.back()->indent--;
+	line() << "}\n\n";
+
+	m_definitions << m_functions.back()->code.str();
+	m_functions.pop_back();
+
+	return index;
+}
+
+std::ostream& Transpiler::line()
+{
+	Function& function = *m_functions.back();
+	for (size_t i = 0; i < function.indent; i++)
+	{
+		function.code << '\t';
+	}
+	return function.code;
+}
+
+// variables of the function's own scopes are read from the environment that holds them, anything further out is
+// looked up from env0 like the interpreter does
+std::string Transpiler::variable(const Token& name, const std::optional<size_t> depth)
+{
+	if (!depth) { return "globals->get(" + token(name) + ")"; }
+
+	const size_t current = m_functions.back()->depth;
+	if (*depth <= current) { return "env" + std::to_string(current - *depth) + "->getAt(0, " + Quote(name.lexeme) + ")"; }
+	return "env0->getAt(" + std::to_string(*depth - current) + ", " + Quote(name.lexeme) + ")";
+}
+
+std::string Transpiler::assign(const Token& name, const std::optional<size_t> depth, const std::string& value)
+{
+	const std::string constant = token(name);
+	if (!depth) { return "aot::Assign(globals, " + constant + ", " + value + ")"; }
+
+	const size_t current = m_functions.back()->depth;
+	if (*depth <= current) { return "aot::AssignAt(env" + std::to_string(current - *depth) + ", 0, " + constant + ", " + value + ")"; }
+	return "aot::AssignAt(env0, " + std::to_string(*depth - current) + ", " + constant + ", " + value + ")";
+}
+
+std::optional<size_t> Transpiler::depthOf(const Expr& expr) const
+{
+	if (const auto it = m_locals.find(expr.getShared()); it != m_locals.end()) { return it->second; }
+	return std::nullopt;
+}
+
+std::string Transpiler::environment() const
+{
+	return "env" + std::to_string(m_functions.back()->depth);
+}
+
+// tokens are only needed for their line and lexeme in error messages, and the operator type, so each is written once
+std::string Transpiler::token(const Token& token)
+{
+	auto [it, inserted] = m_tokens.try_emplace({ token.type, token.lexeme, token.line }, "T" + std::to_string(m_tokens.size()));
+	if (inserted)
+	{
+		m_constants << "\tconst Token " << it->second << "(static_cast<TokenType>(" << token.type << "), " << Quote(token.lexeme) << ", " << token.line << ");\n";
+	}
+	return it->second;
+}
+
+std::string Transpiler::literal(const object_t& value)
+{
+	if (is<bool>(value)) { return as<bool>(value) ? "object_t(true)" : "object_t(false)"; }
+	if (is<double>(value)) { return "object_t(" + Number(as<double>(value)) + ")"; }
+	if (is<std::string>(value))
+	{
+		const std::string& text = as<std::string>(value);
+		auto [it, inserted] = m_strings.try_emplace(text, "S" + std::to_string(m_strings.size()));
+		if (inserted)
+		{
+			m_constants << "\tconst object_t " << it->second << " = std::string(" << Quote(text) << ");\n";
+		}
+		return it->second;
+	}
+	return "object_t()";
+}
@@ -0,0 +1,590 @@
+#include "treeImage.h"
+
+#include <bit>
+#include <cstring>
+
+
+namespace
+{
+	constexpr uint8_t NONE = 0xFF; // a missing statement or expression
+
+	enum class StmtTag : uint8_t { BLOCK, CLASS, EXPRESSION, FUNCTION, IF, IMPORT, PRINT, RETURN, VAR, WHILE };
+	enum class ExprTag : uint8_t { ASSIGN, BINARY, CALL, GET, GROUPING, LITERAL, LOGICAL, SET, SUPER, THIS, UNARY, VARIABLE };
+	enum class LiteralTag : uint8_t { NIL, FALSE, TRUE, NUMBER, STRING };
+}
+
+uint64_t ImageHash(const std::string_view bytes)
+{
+	constexpr uint64_t PRIME = 0x100000001B3;
+	uint64_t hash = 0xCBF29CE484222325 ^ bytes.size();
+
+	size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes.data() + i, 8);
+		hash = std::rotl((hash ^ word) * PRIME, 29);
+	}
+	for (; i < bytes.size(); i++)
+	{
+		hash = (hash ^ static_cast<uint8_t>(bytes[i])) * PRIME;
+	}
+
+	return hash ^ (hash >> 32);
+}
+
+
+// writing ---------------------------------------------------------
+
+void TreeWriter::statements(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+	put(static_cast<uint32_t>(statements.size()));
+	for (const auto& statement : statements) { stmt(statement.get()); }
+}
+
+void TreeWriter::stmt(Stmt* statement)
+{
+	if (statement == nullptr) { put(NONE); return; }
+	statement->accept(this);
+}
+
+void TreeWriter::expr(Expr* expression)
+{
+	if (expression == nullptr) { put(NONE); return; }
+	expression->accept(this);
+}
+
+void TreeWriter::visitBlockStmt(Stmt::Block& stmt)
+{
+	put(StmtTag::BLOCK);
+	statements(stmt.statements);
+}
+
+void TreeWriter::visitClassStmt(Stmt::Class& stmt)
+{
+	put(StmtTag::CLASS);
+	token(stmt.name);
+	expr(stmt.superclass.get());
+	put(static_cast<uint32_t>(stmt.methods.size()));
+	for (const auto& method : stmt.methods) { this->stmt(method.get()); }
+}
+
+void TreeWriter::visitCountedLoopStmt(Stmt::CountedLoop&) { failed = true; }
+
+void TreeWriter::visitExpressionStmt(Stmt::Expression& stmt)
+{
+	put(StmtTag::EXPRESSION);
+	expr(stmt.expression.get());
+}
+
+void TreeWriter::visitFunctionStmt(Stmt::Function& stmt)
+{
+	functions.emplace(&stmt, static_cast<uint32_t>(functions.size()));
+
+	put(StmtTag::FUNCTION);
+	token(stmt.name);
+	put(static_cast<uint32_t>(stmt.params.size()));
+	for (const auto& param : stmt.params) { token(param); }
+	statements(stmt.body);
+}
+
+void TreeWriter::visitIfStmt(Stmt::If& stmt)
+{
+	put(StmtTag::IF);
+	expr(stmt.condition.get());
+	this->stmt(stmt.thenBranch.get());
+	this->stmt(stmt.elseBranch.get());
+}
+
+void TreeWriter::visitImportStmt(Stmt::Import& stmt)
+{
+	put(StmtTag::IMPORT);
+	token(stmt.keyword);
+	token(stmt.path);
+}
+
+void TreeWriter::visitPrintStmt(Stmt::Print& stmt)
+{
+	put(StmtTag::PRINT);
+	expr(stmt.expression.get());
+}
+
+void TreeWriter::visitReturnStmt(Stmt::Return& stmt)
+{
+	put(StmtTag::RETURN);
+	token(stmt.keyword);
+	expr(stmt.value.get());
+}
+
+void TreeWriter::visitVarStmt(Stmt::Var& stmt)
+{
+	put(StmtTag::VAR);
+	token(stmt.name);
+	expr(stmt.initializer.get());
+}
+
+void TreeWriter::visitWhileStmt(Stmt::While& stmt)
+{
+	put(StmtTag::WHILE);
+	expr(stmt.condition.get());
+	this->stmt(stmt.body.get());
+}
+
+object_t TreeWriter::visitAssignExpr(Expr::Assign& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::ASSIGN), expr);
+	token(expr.name);
+	this->expr(expr.value.get());
+	return {};
+}
+
+object_t TreeWriter::visitBinaryExpr(Expr::Binary& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::BINARY), expr);
+	this->expr(expr.left.get());
+	token(expr.op);
+	this->expr(expr.right.get());
+	return {};
+}
+
+object_t TreeWriter::visitCallExpr(Expr::Call& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::CALL), expr);
+	this->expr(expr.callee.get());
+	token(expr.paren);
+	put(static_cast<uint32_t>(expr.arguments.size()));
+	for (const auto& argument : expr.arguments) { this->expr(argument.get()); }
+	return {};
+}
+
+object_t TreeWriter::visitCompareConstantExpr(Expr::CompareConstant&) { failed = true; return {}; }
+
+object_t TreeWriter::visitGetExpr(Expr::Get& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::GET), expr);
+	this->expr(expr.object.get());
+	token(expr.name);
+	return {};
+}
+
+object_t TreeWriter::visitGetChainExpr(Expr::GetChain&) { failed = true; return {}; }
+
+object_t TreeWriter::visitGroupingExpr(Expr::Grouping& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::GROUPING), expr);
+	this->expr(expr.expression.get());
+	return {};
+}
+
+object_t TreeWriter::visitIncrementExpr(Expr::Increment&) { failed = true; return {}; }
+
+object_t TreeWriter::visitLiteralExpr(Expr::Literal& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::LITERAL), expr);
+	if (is<bool>(expr.value))
+	{
+		put(as<bool>(expr.value) ? LiteralTag::TRUE : LiteralTag::FALSE);
+	}
+	else if (is<double>(expr.value))
+	{
+		put(LiteralTag::NUMBER);
+		put(as<double>(expr.value));
+	}
+	else if (is<std::string>(expr.value))
+	{
+		put(LiteralTag::STRING);
+		bytes(std::get<std::string>(expr.value));
+	}
+	else if (IsNull(expr.value))
+	{
+		put(LiteralTag::NIL);
+	}
+	else
+	{
+		failed = true;
+	}
+	return {};
+}
+
+object_t TreeWriter::visitLogicalExpr(Expr::Logical& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::LOGICAL), expr);
+	this->expr(expr.left.get());
+	token(expr.op);
+	this->expr(expr.right.get());
+	return {};
+}
+
+object_t TreeWriter::visitNilCheckExpr(Expr::NilCheck&) { failed = true; return {}; }
+
+object_t TreeWriter::visitSetExpr(Expr::Set& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::SET), expr);
+	this->expr(expr.object.get());
+	token(expr.name);
+	this->expr(expr.value.get());
+	return {};
+}
+
+object_t TreeWriter::visitSetThisExpr(Expr::SetThis&) { failed = true; return {}; }
+
+object_t TreeWriter::visitSuperExpr(Expr::Super& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::SUPER), expr);
+	token(expr.keyword);
+	token(expr.method);
+	return {};
+}
+
+object_t TreeWriter::visitThisExpr(Expr::This& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::THIS), expr);
+	token(expr.keyword);
+	return {};
+}
+
+object_t TreeWriter::visitUnaryExpr(Expr::Unary& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::UNARY), expr);
+	token(expr.op);
+	this->expr(expr.right.get());
+	return {};
+}
+
+object_t TreeWriter::visitVariableExpr(Expr::Variable& expr)
+{
+	header(static_cast<uint8_t>(ExprTag::VARIABLE), expr);
+	token(expr.name);
+	return {};
+}
+
+void TreeWriter::bytes(const std::string_view text)
+{
+	put(static_cast<uint32_t>(text.size()));
+	payload.append(text);
+}
+
+void TreeWriter::token(const Token& token)
+{
+	put(static_cast<uint8_t>(token.type));
+	put(token.line);
+	bytes(token.lexeme);
+	if (token.type == NUMBER) { put(token.number); }
+}
+
+void TreeWriter::header(const uint8_t tag, Expr& expr)
+{
+	put(tag);
+	const auto local = m_locals.find(expr.getShared());
+	put(local == m_locals.end() ? uint32_t(0) : static_cast<uint32_t>(local->second + 1));
+}
+
+
+// reading ---------------------------------------------------------
+
+bool TreeReader::fail()
+{
+	failed = true;
+	m_position = m_end;
+	return false;
+}
+
+// globals are not tracked, they are looked up by name at runtime. Only classes declare 'this' and 'super', which the
+// interpreter expects to hold an instance and a class
+void TreeReader::declare(const std::string_view name)
+{
+	if (name == "this" || name == "super") { fail(); }
+	if (!m_scopes.empty()) { m_scopes.back().insert(name); }
+}
+
+template <typename T>
+T TreeReader::get()
+{
+	T value{};
+	if (static_cast<size_t>(m_end - m_position) < sizeof(T)) { fail(); return value; }
+
+	memcpy(&value, m_position, sizeof(T));
+	m_position += sizeof(T);
+	return value;
+}
+
+// a view into the image, which outlives the syntax tree like any other source
+std::string_view TreeReader::bytes()
+{
+	const uint32_t size = get<uint32_t>();
+	if (static_cast<size_t>(m_end - m_position) < size) { fail(); return {}; }
+
+	const std::string_view text(m_position, size);
+	m_position += size;
+	return text;
+}
+
+Token TreeReader::token()
+{
+	const uint8_t type = get<uint8_t>();
+	const uint32_t line = get<uint32_t>();
+	const std::string_view lexeme = bytes();
+	if (type == INVALID || type > END_OF_FILE) { fail(); }
+
+	const double number = type == NUMBER ? get<double>() : 0.0;
+	return Token(static_cast<TokenType>(type), lexeme, line, number);
+}
+
+// the engines expect these children, a damaged image must not hand them a null
+template <typename T>
+std::shared_ptr<T> TreeReader::required(std::shared_ptr<T> node)
+{
+	if (node == nullptr) { fail(); }
+	return node;
+}
+
+bool TreeReader::statements(std::vector<std::shared_ptr<Stmt>>& statements)
+{
+	uint32_t count = get<uint32_t>();
+
+	// every statement takes at least one byte, so a damaged count cannot reserve much
+	if (failed || count > static_cast<size_t>(m_end - m_position)) { return fail(); }
+
+	statements.reserve(count);
+	while (count-- > 0 && !failed) { statements.push_back(stmt()); }
+	return !failed;
+}
+
+std::shared_ptr<Stmt> TreeReader::stmt()
+{
+	const uint8_t tag = get<uint8_t>();
+	if (failed || tag == NONE) { return nullptr; }
+
+	switch (static_cast<StmtTag>(tag))
+	{
+	case StmtTag::BLOCK:
+	{
+		std::vector<std::shared_ptr<Stmt>> body;
+		m_scopes.emplace_back();
+		statements(body);
+		m_scopes.pop_back();
+		return newShared<Stmt::Block>(std::move(body));
+	}
+	case StmtTag::CLASS:
+	{
+		Token name = token();
+		declare(name.lexeme);
+
+		std::shared_ptr<Expr> superclass = expr();
+		auto variable = std::dynamic_pointer_cast<Expr::Variable>(superclass);
+		if (superclass != nullptr && variable == nullptr) { fail(); }
+
+		uint32_t count = get<uint32_t>();
+		if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+		if (variable != nullptr) { m_scopes.push_back({ "super" }); }
+		m_scopes.push_back({ "this" });
+
+		std::vector<std::shared_ptr<Stmt::Function>> methods;
+		while (!failed && count-- > 0)
+		{
+			if (get<uint8_t>() != static_cast<uint8_t>(StmtTag::FUNCTION)) { fail(); }
+			methods.push_back(function(true));
+		}
+
+		m_scopes.pop_back();
+		if (variable != nullptr) { m_scopes.pop_back(); }
+		return newShared<Stmt::Class>(name, std::move(variable), std::move(methods));
+	}
+	case StmtTag::EXPRESSION:
+		return newShared<Stmt::Expression>(required(expr()));
+	case StmtTag::FUNCTION:
+		return function(false);
+	case StmtTag::IF:
+	{
+		std::shared_ptr<Expr> condition = required(expr());
+		std::shared_ptr<Stmt> thenBranch = required(stmt());
+		return newShared<Stmt::If>(std::move(condition), std::move(thenBranch), stmt());
+	}
+	case StmtTag::IMPORT:
+	{
+		// only top-level code imports
+		if (!m_scopes.empty()) { fail(); }
+
+		Token keyword = token();
+		Token path = token();
+		if (path.type != STRING || path.lexeme.size() < 2) { fail(); }
+		return newShared<Stmt::Import>(keyword, path);
+	}
+	case StmtTag::PRINT:
+		return newShared<Stmt::Print>(required(expr()));
+	case StmtTag::RETURN:
+	{
+		// a return outside of a function would unwind past the interpreter
+		if (m_functions == 0) { fail(); }
+
+		Token keyword = token();
+		return newShared<Stmt::Return>(keyword, expr());
+	}
+	case StmtTag::VAR:
+	{
+		Token name = token();
+		std::shared_ptr<Expr> initializer = expr();
+		declare(name.lexeme);
+		return newShared<Stmt::Var>(name, std::move(initializer));
+	}
+	case StmtTag::WHILE:
+	{
+		std::shared_ptr<Expr> condition = required(expr());
+		return newShared<Stmt::While>(std::move(condition), required(stmt()));
+	}
+	default:
+		fail();
+		return nullptr;
+	}
+}
+
+std::shared_ptr<Expr> TreeReader::expr()
+{
+	const uint8_t tag = get<uint8_t>();
+	if (failed || tag == NONE) { return nullptr; }
+
+	const uint32_t depth = get<uint32_t>();
+
+	// only variables, assignments, 'this' and 'super' are resolved, the last two always are
+	std::string_view name;
+	std::shared_ptr<Expr> result = node(tag, name);
+	if (failed) { return result; }
+
+	if (depth == 0)
+	{
+		if (name == "this" || name == "super") { fail(); }
+	}
+	else if (name.empty() || depth > m_scopes.size() || !m_scopes[m_scopes.size() - depth].contains(name))
+	{
+		fail();
+	}
+	else
+	{
+		m_locals.emplace(result, depth - 1);
+	}
+	return result;
+}
+
+// the fields after the tag, a function is declared before its body so it can call itself, a method never is
+std::shared_ptr<Stmt::Function> TreeReader::function(const bool method)
+{
+	// numbered before the functions inside of it, like the writer does
+	const size_t index = functions.size();
+	functions.push_back({ nullptr, m_scopes, method });
+
+	Token name = token();
+	if (!method) { declare(name.lexeme); }
+
+	uint32_t count = get<uint32_t>();
+	if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+	m_scopes.emplace_back();
+	m_functions++;
+
+	std::vector<Token> params;
+	while (!failed && count-- > 0)
+	{
+		params.push_back(token());
+		declare(params.back().lexeme);
+	}
+
+	std::vector<std::shared_ptr<Stmt>> body;
+	statements(body);
+
+	m_functions--;
+	m_scopes.pop_back();
+
+	auto declaration = newShared<Stmt::Function>(name, std::move(params), std::move(body));
+	functions[index].declaration = declaration;
+	return declaration;
+}
+
+// name is set to the name the node looks up, if it is one that can be resolved
+std::shared_ptr<Expr> TreeReader::node(const uint8_t tag, std::string_view& name)
+{
+	switch (static_cast<ExprTag>(tag))
+	{
+	case ExprTag::ASSIGN:
+	{
+		Token target = token();
+		name = target.lexeme;
+		return newShared<Expr::Assign>(target, required(expr()));
+	}
+	case ExprTag::BINARY:
+	{
+		std::shared_ptr<Expr> left = required(expr());
+		Token op = token();
+		return newShared<Expr::Binary>(std::move(left), op, required(expr()));
+	}
+	case ExprTag::CALL:
+	{
+		std::shared_ptr<Expr> callee = required(expr());
+		Token paren = token();
+		uint32_t count = get<uint32_t>();
+		if (count > static_cast<size_t>(m_end - m_position)) { fail(); }
+
+		std::vector<std::shared_ptr<Expr>> arguments;
+		while (!failed && count-- > 0) { arguments.push_back(required(expr())); }
+		return newShared<Expr::Call>(std::move(callee), paren, std::move(arguments));
+	}
+	case ExprTag::GET:
+	{
+		std::shared_ptr<Expr> object = required(expr());
+		return newShared<Expr::Get>(std::move(object), token());
+	}
+	case ExprTag::GROUPING:
+		return newShared<Expr::Grouping>(required(expr()));
+	case ExprTag::LITERAL:
+		switch (static_cast<LiteralTag>(get<uint8_t>()))
+		{
+		case LiteralTag::NIL: return newShared<Expr::Literal>(object_t());
+		case LiteralTag::FALSE: return newShared<Expr::Literal>(false);
+		case LiteralTag::TRUE: return newShared<Expr::Literal>(true);
+		case LiteralTag::NUMBER: return newShared<Expr::Literal>(get<double>());
+		case LiteralTag::STRING: return newShared<Expr::Literal>(std::string(bytes()));
+		default: fail(); return nullptr;
+		}
+	case ExprTag::LOGICAL:
+	{
+		std::shared_ptr<Expr> left = required(expr());
+		Token op = token();
+		return newShared<Expr::Logical>(std::move(left), op, required(expr()));
+	}
+	case ExprTag::SET:
+	{
+		std::shared_ptr<Expr> object = required(expr());
+		Token field = token();
+		return newShared<Expr::Set>(std::move(object), field, required(expr()));
+	}
+	case ExprTag::SUPER:
+	{
+		name = "super";
+		Token keyword = token();
+		if (keyword.lexeme != name) { fail(); }
+		return newShared<Expr::Super>(keyword, token());
+	}
+	case ExprTag::THIS:
+	{
+		// the interpreter looks 'this' up by the keyword's lexeme
+		name = "this";
+		Token keyword = token();
+		if (keyword.lexeme != name) { fail(); }
+		return newShared<Expr::This>(keyword);
+	}
+	case ExprTag::UNARY:
+	{
+		Token op = token();
+		return newShared<Expr::Unary>(op, required(expr()));
+	}
+	case ExprTag::VARIABLE:
+	{
+		Token variable = token();
+		name = variable.lexeme;
+		return newShared<Expr::Variable>(variable);
+	}
+	default:
+		fail();
+		return nullptr;
+	}
+}
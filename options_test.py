@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+
+# Checks the command line options test.py does not run with. Scripts are run as files:
+#
+# - every script in test/fusion prints the same, to stdout and stderr, and exits with the same code with -O0, where
+#   nothing is fused, as with the fused nodes, so runtime errors keep their message and line
+# - every script prints the same and exits with the same code when it is run with --cache-dir, writing its entry, and
+#   again reading it, and after the entry was truncated or modified, which must be ignored and written again
+# - a script in test/snapshot/restore runs on the heap the script of the same name in test/snapshot left, written with
+#   --snapshot-out and read with --snapshot-in, and prints its "// expect: ..." lines, while a truncated or modified
+#   image is rejected with exit code 65
+# - options with a value it cannot take print the usage and exit with 64
+# - a script with a "// flags: ..." comment is run with those flags and must print exactly its "// stderr: ..." lines
+#   to stderr
+
+from os import listdir
+from os.path import basename, dirname, isdir, join, realpath, relpath, splitext
+from subprocess import DEVNULL, PIPE, CompletedProcess, TimeoutExpired, run
+from tempfile import TemporaryDirectory
+import re
+import sys
+
+REPO_DIR = dirname(realpath(__file__))
+TEST_DIR = join(REPO_DIR, 'test')
+JLOX = join(REPO_DIR, 'out', 'bin', 'x64', 'Release', 'jlox')
+
+# seconds a script may run, a damaged cache entry that is read anyway can loop forever
+TIMEOUT = 60
+
+# the benchmarks print timings, the restored scripts need the heap they are restored from
+NOT_REPEATABLE = ['benchmark', join('snapshot', 'restore')]
+
+EXPECT_PATTERN = re.compile(r'// expect: ?(.*)')
+FLAGS_PATTERN = re.compile(r'// flags: (.*)')
+STDERR_PATTERN = re.compile(r'// stderr: ?(.*)')
+
+
+def scripts(path):
+  for name in sorted(listdir(path)):
+    child = join(path, name)
+    if isdir(child):
+      yield from scripts(child)
+    elif splitext(name)[1] == '.lox':
+      yield child
+
+
+def differences(expected, actual, names):
+  for stream in ['returncode', 'stdout', 'stderr']:
+    if getattr(expected, stream) != getattr(actual, stream):
+      return '{} differs:\n  {}: {!r}\n  {}: {!r}'.format(
+          stream, names[0], getattr(expected, stream), names[1], getattr(actual, stream))
+  return None
+
+
+def read(path):
+  with open(path, 'r') as file:
+    return file.read()
+
+
+def read_bytes(path):
+  with open(path, 'rb') as file:
+    return file.read()
+
+
+def write_bytes(path, data):
+  with open(path, 'wb') as file:
+    file.write(data)
+
+
+# an image cut in half, and one with a byte in its middle flipped
+def damaged(image):
+  middle = len(image) // 2
+  return {
+    'truncated': image[:middle],
+    'modified': image[:middle] + bytes([image[middle] ^ 0xff]) + image[middle + 1:],
+  }
+
+
+def run_script(flags, path):
+  try:
+    return run([JLOX] + flags + [path], stdin=DEVNULL, stdout=PIPE, stderr=PIPE, timeout=TIMEOUT)
+  except TimeoutExpired as error:
+    # shows up as a different exit code
+    return CompletedProcess(error.cmd, 'timed out', b'', b'')
+
+
+def is_repeatable(path):
+  return not any(relpath(path, TEST_DIR).startswith(name) for name in NOT_REPEATABLE)
+
+
+def check_cache(path):
+  expected = run_script([], path)
+  with TemporaryDirectory() as directory:
+    flags = ['--cache-dir=' + directory]
+    for run_name in ['writing the cache', 'reading the cache']:
+      error = differences(expected, run_script(flags, path), ['uncached', run_name])
+      if error is not None:
+        return error
+
+    # programs with compile errors are never stored, imported modules have entries of their own
+    entries = sorted(listdir(directory))
+    if not entries:
+      return None if expected.returncode == 65 else 'nothing was cached'
+
+    for name in entries:
+      entry = join(directory, name)
+      image = read_bytes(entry)
+      for damage, data in damaged(image).items():
+        write_bytes(entry, data)
+        error = differences(expected, run_script(flags, path), ['uncached', damage + ' entry'])
+        if error is not None:
+          return error
+        if read_bytes(entry) != image:
+          return 'the {} entry was not written again'.format(damage)
+  return None
+
+
+def is_snapshot_test(path):
+  return relpath(path, TEST_DIR).startswith(join('snapshot', 'restore'))
+
+
+def check_snapshot(path):
+  setup = join(dirname(dirname(path)), basename(path))
+  expected = ''.join(line + '\n' for line in EXPECT_PATTERN.findall(read(path)))
+  with TemporaryDirectory() as directory:
+    image_path = join(directory, 'heap.image')
+    result = run_script(['--snapshot-out=' + image_path], setup)
+    if result.returncode != 0:
+      return 'writing the snapshot exited with {}: {!r}'.format(result.returncode, result.stderr)
+
+    flags = ['--snapshot-in=' + image_path]
+    result = run_script(flags, path)
+    actual = result.stdout.decode().replace('\r\n', '\n')
+    if result.returncode != 0 or actual != expected:
+      return 'restored heap exited with {}:\n  expected: {!r}\n  actual:   {!r}\n  stderr:   {!r}'.format(
+          result.returncode, expected, actual, result.stderr)
+
+    image = read_bytes(image_path)
+    rejected = "Invalid snapshot '{}'.\n".format(image_path)
+    for damage, data in damaged(image).items():
+      write_bytes(image_path, data)
+      result = run_script(flags, path)
+      if result.returncode != 65 or result.stdout or result.stderr.decode().replace('\r\n', '\n') != rejected:
+        return 'the {} image was not rejected, exit code {}: {!r}'.format(damage, result.returncode, result.stderr)
+  return None
+
+
+def is_fusion_test(path):
+  return relpath(path, TEST_DIR).startswith('fusion')
+
+
+def check_fusion(path):
+  unfused = run_script(['-O0'], path)
+  fused = run_script(['-O1'], path)
+  return differences(unfused, fused, ['-O0', '-O1'])
+
+
+def has_flags(path):
+  return FLAGS_PATTERN.search(read(path)) is not None
+
+
+def check_stderr(path):
+  source = read(path)
+  flags = FLAGS_PATTERN.search(source)
+  expected = ''.join(line + '\n' for line in STDERR_PATTERN.findall(source))
+  result = run_script(flags.group(1).split(), path)
+  actual = result.stderr.decode().replace('\r\n', '\n')
+  if actual != expected:
+    return 'stderr differs:\n  expected: {!r}\n  actual:   {!r}'.format(expected, actual)
+  return None
+
+
+# each is rejected on its own
+BAD_OPTIONS = [
+  '--jit-threshold=',
+  '--jit-threshold=0',
+  '--jit-threshold=-1',
+  '--jit-threshold=+5',
+  '--jit-threshold= 5',
+  '--jit-threshold=5x',
+  '--jit-threshold=1.5',
+  '--jit-threshold=99999999999999999999999',
+]
+
+
+def check_usage(option):
+  result = run([JLOX, option], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+  if result.returncode != 64 or not result.stdout.startswith(b'Usage: jlox'):
+    return 'expected the usage and exit code 64, got {} with {!r}'.format(result.returncode, result.stdout)
+  return None
+
+
+# which scripts each check runs on
+CHECKS = [
+  (is_repeatable, check_cache),
+  (is_snapshot_test, check_snapshot),
+  (is_fusion_test, check_fusion),
+  (has_flags, check_stderr),
+]
+
+
+def main(argv):
+  filter_path = argv[1] if len(argv) > 1 else None
+
+  passed = 0
+  failed = 0
+  for option in BAD_OPTIONS if not filter_path else []:
+    error = check_usage(option)
+    if error is None:
+      passed += 1
+    else:
+      failed += 1
+      print('FAIL: {}\n{}'.format(option, error))
+
+  for path in scripts(TEST_DIR):
+    name = relpath(path, REPO_DIR)
+    if filter_path and not name.startswith(filter_path):
+      continue
+    for applies, check in CHECKS:
+      if not applies(path):
+        continue
+      error = check(path)
+      if error is None:
+        passed += 1
+      else:
+        failed += 1
+        print('FAIL: {} ({})\n{}'.format(name, check.__name__, error))
+      sys.stdout.flush()
+
+  print('{} passed, {} failed'.format(passed, failed))
+  sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+  main(sys.argv)
@@ -31,6 +31,10 @@ filter_path = None
 INTERPRETERS = {}
 C_SUITES = []
 JAVA_SUITES = []
+ENGINE_SUITES = []
+
+# Run as files rather than from stdin: imports are relative to the script's directory.
+FILE_TESTS = ['test/import']
 
 
 class Interpreter:
@@ -66,6 +70,20 @@ def java_interpreter(name, tests):
   JAVA_SUITES.append(name)
 
 
+# Runs the jlox suite again with one of the alternative engines, skipping what it does not support and running what it
+# alone does.
+def jlox_engine(name, flags, skipped=(), passed=()):
+  jlox = INTERPRETERS['jlox']
+  tests = dict(jlox.tests)
+  for path in skipped:
+    tests[path] = 'skip'
+  for path in passed:
+    tests[path] = 'pass'
+  INTERPRETERS[name] = Interpreter(name, 'java',
+      jlox.args[:1] + flags + jlox.args[1:], tests)
+  ENGINE_SUITES.append(name)
+
+
 java_interpreter('jlox', {
 # c_interpreter('jlox', {
   'test': 'pass',
@@ -74,6 +92,12 @@ java_interpreter('jlox', {
   'test/scanning': 'skip',
   'test/expressions': 'skip',
 
+  # Only imported by the tests next to them.
+  'test/import/modules': 'skip',
+
+  # Run on the heap of a snapshot by options_test.py.
+  'test/snapshot/restore': 'skip',
+
   # No hardcoded limits in jlox.
   'test/limit/loop_too_large.lox': 'skip',
   'test/limit/no_reuse_constants.lox': 'skip',
@@ -85,6 +109,14 @@ java_interpreter('jlox', {
   'test/limit/stack_overflow.lox': 'skip',
 })
 
+# Threads and the async functions need the tree-walking interpreter, and only the flat engine checks the depth of the
+# stack.
+jlox_engine('jlox_closure', ['--engine=closure'], ['test/async', 'test/threads'])
+jlox_engine('jlox_flat', ['--engine=flat'], ['test/async', 'test/threads'], ['test/limit/stack_overflow.lox'])
+jlox_engine('jlox_O0', ['-O0'])
+jlox_engine('jlox_jit', ['--jit', '--jit-threshold=1'])
+jlox_engine('jlox_stream', ['--stream'])
+
 java_interpreter('chap04_scanning', {
   # No interpreter yet.
   'test': 'skip',
@@ -816,11 +848,15 @@ class Test:
   def run(self):
     # Invoke the interpreter and run the test.
     args = interpreter.args[:]
-    proc = Popen(args, stdin=PIPE, stdout=PIPE, stderr=PIPE)
-
-    with open(self.path, 'rb') as f:
-      lox_input = f.read()
+    lox_input = None
+    if any(self.path.replace('\\', '/').startswith(path) for path in FILE_TESTS):
+      # in place of 'test', which reads the script from stdin
+      args[-1] = self.path
+    else:
+      with open(self.path, 'rb') as f:
+        lox_input = f.read()
 
+    proc = Popen(args, stdin=PIPE, stdout=PIPE, stderr=PIPE)
     out, err = proc.communicate(lox_input)
     self.validate(proc.returncode, out, err)
 
@@ -1099,8 +1135,7 @@ def main(argv):
   if len(argv) == 2:
     filter_path = argv[1]
 
-  if not run_suite('jlox'):
-    sys.exit(1)
+  run_suites(['jlox'] + ENGINE_SUITES)
 
 
 if __name__ == '__main__':